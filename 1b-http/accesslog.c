@@ -0,0 +1,254 @@
+/**
+ * @file accesslog.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Asynchronous access log.
+ *
+ * Every ring has exactly one producer (its worker) and one consumer (the log thread). The producer
+ * only advances head, the consumer only advances tail, both with release stores, so no locks are needed.
+ **/
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "accesslog.h"
+
+#define LOG_BATCH_SIZE 65536                    /*!< formatted bytes collected before a write() */
+#define LOG_IDLE_NS 20000000                    /*!< sleep of the log thread when all rings are empty */
+#define LOG_LINE_MAX (LOG_URL_MAX * 6 + 512)    /*!< upper bound of one formatted record */
+
+/**
+ * @brief Single-producer single-consumer ring of records.
+ */
+struct logRing {
+    uint64_t head __attribute__((aligned(64)));  /*!< next slot the producer writes */
+    uint64_t dropped;                            /*!< records lost because the ring was full, producer only */
+    uint64_t tail __attribute__((aligned(64)));  /*!< next slot the consumer reads */
+    struct logRecord records[LOG_RING_SIZE];     /*!< the slots */
+};
+
+static struct logRing *rings = NULL;            /*!< one ring per worker */
+static int ringCount = 0;                       /*!< number of rings */
+static int logFd = -1;                          /*!< log file */
+static pthread_t logThread;                     /*!< drains the rings */
+static int stopping = 0;                        /*!< set to stop the log thread */
+
+/**
+ * @brief Queues a record without ever blocking.
+ * @details Must only be called by the owner of the ring. If the ring is full the record is dropped.
+ * @param ring the ring of the calling worker, NULL if logging is disabled.
+ * @param rec the record, copied into the ring.
+ * @return void
+ */
+void accessLogWrite(struct logRing *ring, const struct logRecord *rec) {
+    if (ring == NULL)
+        return;
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= LOG_RING_SIZE) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    ring->records[head & (LOG_RING_SIZE - 1)] = *rec;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Writes a whole buffer to the log file.
+ */
+static void writeBatch(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(logFd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return; // nothing sensible left to do with the log
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+/**
+ * @brief Appends a string as JSON string contents, escaping quotes, backslashes and control characters.
+ */
+static size_t jsonEscape(char *out, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = 0;
+    for (; *s != '\0'; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') {
+            out[n++] = '\\';
+            out[n++] = ch;
+        } else if (ch < 0x20 || ch == 0x7f) {
+            out[n++] = '\\';
+            out[n++] = 'u';
+            out[n++] = '0';
+            out[n++] = '0';
+            out[n++] = hex[ch >> 4];
+            out[n++] = hex[ch & 15];
+        } else {
+            out[n++] = ch;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Formats one record as a JSON line.
+ * @return number of bytes written to out, at most LOG_LINE_MAX.
+ */
+static size_t formatRecord(char *out, const struct logRecord *rec) {
+    char client[INET6_ADDRSTRLEN] = "-";
+    if (rec->peer.ss_family == AF_INET)
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)&rec->peer)->sin_addr, client, sizeof(client));
+    else if (rec->peer.ss_family == AF_INET6)
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)&rec->peer)->sin6_addr, client, sizeof(client));
+
+    time_t sec = rec->timeUs / 1000000;
+    struct tm tm_info;
+    gmtime_r(&sec, &tm_info);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm_info);
+
+    char method[LOG_METHOD_MAX * 6 + 1];
+    char url[LOG_URL_MAX * 6 + 1];
+    method[jsonEscape(method, rec->method)] = '\0';
+    url[jsonEscape(url, rec->url)] = '\0';
+
+    int n = snprintf(out, LOG_LINE_MAX,
+            "{\"time\":\"%s.%06uZ\",\"client\":\"%s\",\"method\":\"%s\",\"url\":\"%s\",\"status\":%u,"
+            "\"bytes\":%llu,\"duration_us\":%llu,\"worker\":%u%s}\n",
+            date, (unsigned)(rec->timeUs % 1000000), client, method, url, rec->status,
+            (unsigned long long)rec->bytes, (unsigned long long)rec->latencyUs, rec->worker,
+            rec->aborted ? ",\"aborted\":true" : "");
+    return (n < LOG_LINE_MAX) ? (size_t)n : LOG_LINE_MAX - 1;
+}
+
+/**
+ * @brief Moves all queued records of all rings to the log file.
+ * @param batch buffer of LOG_BATCH_SIZE bytes.
+ * @return number of records written.
+ */
+static size_t drain(char *batch) {
+    size_t len = 0;
+    size_t count = 0;
+
+    for (int i = 0; i < ringCount; i++) {
+        struct logRing *ring = &rings[i];
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        while (tail != head) {
+            if (LOG_BATCH_SIZE - len < LOG_LINE_MAX) {
+                writeBatch(batch, len);
+                len = 0;
+            }
+            len += formatRecord(batch + len, &ring->records[tail & (LOG_RING_SIZE - 1)]);
+            tail++;
+            count++;
+            // hand the slot back early, so a busy worker does not run into a full ring
+            if ((tail & 63) == 0)
+                __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (len > 0)
+        writeBatch(batch, len);
+    return count;
+}
+
+/**
+ * @brief Body of the log thread.
+ */
+static void *logMain(void *arg) {
+    char *batch = arg;
+    struct timespec idle = { 0, LOG_IDLE_NS };
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        if (drain(batch) == 0)
+            nanosleep(&idle, NULL);
+    }
+    drain(batch);
+
+    uint64_t dropped = 0;
+    for (int i = 0; i < ringCount; i++)
+        dropped += __atomic_load_n(&rings[i].dropped, __ATOMIC_RELAXED);
+    if (dropped > 0) {
+        int n = snprintf(batch, LOG_BATCH_SIZE, "{\"dropped\":%llu}\n", (unsigned long long)dropped);
+        writeBatch(batch, n);
+    }
+    free(batch);
+    return NULL;
+}
+
+/**
+ * @brief Opens the log file and starts the log thread.
+ * @param path file to append to, "-" for stdout.
+ * @param count number of rings, one per worker.
+ * @return 0 on success, -1 on error.
+ */
+int accessLogOpen(const char *path, int count) {
+    if (strcmp(path, "-") == 0)
+        logFd = dup(STDOUT_FILENO);
+    else
+        logFd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (logFd < 0)
+        return -1;
+
+    if (posix_memalign((void **)&rings, 64, count * sizeof(struct logRing)) != 0) {
+        rings = NULL;
+        close(logFd);
+        logFd = -1;
+        return -1;
+    }
+    memset(rings, 0, count * sizeof(struct logRing));
+    ringCount = count;
+
+    char *batch = malloc(LOG_BATCH_SIZE);
+    if (batch == NULL || pthread_create(&logThread, NULL, logMain, batch) != 0) {
+        free(batch);
+        free(rings);
+        rings = NULL;
+        ringCount = 0;
+        close(logFd);
+        logFd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the ring of a worker.
+ * @param index index of the worker.
+ * @return the ring or NULL if logging is disabled.
+ */
+struct logRing *accessLogRing(int index) {
+    if (rings == NULL || index >= ringCount)
+        return NULL;
+    return &rings[index];
+}
+
+/**
+ * @brief Writes all queued records, stops the log thread and closes the file.
+ * @details The workers must not log anymore when this is called.
+ * @param void
+ * @return void
+ */
+void accessLogClose(void) {
+    if (rings == NULL)
+        return;
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(logThread, NULL);
+    free(rings);
+    rings = NULL;
+    ringCount = 0;
+    close(logFd);
+    logFd = -1;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file accesslog.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Asynchronous access log.
+ *
+ * Workers put fixed-size binary records into their own single-producer ring. A background thread
+ * drains all rings, formats the records as JSON lines and writes them in batches, so a worker never
+ * waits for the disk. When a ring is full the record is dropped and counted.
+ **/
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define LOG_URL_MAX 200                         /*!< longer request targets are truncated */
+#define LOG_METHOD_MAX 8                        /*!< longer methods are truncated */
+#define LOG_RING_SIZE 4096                      /*!< records per ring, has to be a power of two */
+
+/**
+ * @brief One access log entry.
+ */
+struct logRecord {
+    uint64_t timeUs;                            /*!< wall clock time of the response end */
+    uint64_t latencyUs;                         /*!< time from the complete request header to the end */
+    uint64_t bytes;                             /*!< bytes sent including the header */
+    struct sockaddr_storage peer;               /*!< address of the client */
+    uint16_t status;                            /*!< HTTP status code */
+    uint16_t worker;                            /*!< index of the worker that served the request, up to 1023 */
+    uint8_t aborted;                            /*!< the response was not sent completely */
+    char method[LOG_METHOD_MAX];                /*!< request method, NUL terminated */
+    char url[LOG_URL_MAX];                      /*!< request target, NUL terminated */
+};
+
+struct logRing;
+
+int accessLogOpen(const char *path, int rings);
+struct logRing *accessLogRing(int index);
+void accessLogWrite(struct logRing *ring, const struct logRecord *rec);
+void accessLogClose(void);
+
+#endif
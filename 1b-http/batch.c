@@ -0,0 +1,593 @@
+/**
+ * @file batch.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Batch mode of the client, many urls fetched in one event loop.
+ *
+ * Urls are grouped by host. Each host opens up to a fixed number of non-blocking connections which
+ * take requests from the queue of the host as long as fewer than depth requests are in flight.
+ * Responses arrive in request order, so the oldest request in flight owns the bytes being parsed.
+ * When a connection breaks, its requests go back into the queue of the host.
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "dial.h"
+#include "response.h"
+
+/**
+ * @brief One url to fetch.
+ */
+struct job {
+    const char *url;                            /*!< the url as given */
+    const char *path;                           /*!< request target inside url, NULL for "/" */
+    char *file;                                 /*!< output path */
+    struct host *host;                          /*!< host serving the url */
+    int attempts;                               /*!< connections it was lost with */
+    struct job *next;                           /*!< next job in the queue of the host */
+};
+
+/**
+ * @brief A server and the urls waiting for it.
+ */
+struct host {
+    char *name;                                 /*!< host name from the url */
+    struct addrinfo *addrs;                     /*!< resolved addresses, NULL before the first connect */
+    struct addrinfo *order[DIAL_MAX_ATTEMPTS];  /*!< addresses alternating between IPv6 and IPv4 */
+    int orderCount;                             /*!< entries in order */
+    int orderNext;                              /*!< address the next connection goes to */
+    struct job *head;                           /*!< oldest waiting job */
+    struct job *tail;                           /*!< newest waiting job */
+    int waiting;                                /*!< jobs in the queue */
+    int conns;                                  /*!< open connections */
+    int connecting;                             /*!< connections whose connect has not finished */
+    int connectFailures;                        /*!< failed connects in a row */
+    struct host *next;                          /*!< next host */
+};
+
+/**
+ * @brief A connection and the requests in flight on it.
+ */
+struct conn {
+    int fd;                                     /*!< socket */
+    struct host *host;                          /*!< server of the connection */
+    int connected;                              /*!< the non-blocking connect finished */
+    long long deadline;                         /*!< ms at which the connection times out, 0 for none */
+    int wantOut;                                /*!< EPOLLOUT is requested */
+    struct job **sent;                          /*!< ring of requests in flight, oldest at sentHead */
+    int sentHead;                               /*!< index of the oldest request in flight */
+    int sentCount;                              /*!< requests in flight */
+    char *out;                                  /*!< request bytes not yet written */
+    size_t outLen;                              /*!< bytes in out */
+    size_t outOff;                              /*!< bytes of out already written */
+    size_t outCap;                              /*!< capacity of out */
+    char *in;                                   /*!< received bytes */
+    struct response resp;                       /*!< parser of the oldest request in flight */
+    int headerSeen;                             /*!< the header of resp was handled */
+    int file;                                   /*!< output of the current response, -1 to discard */
+    struct conn *prev;                          /*!< previous open connection */
+    struct conn *next;                          /*!< next open connection */
+};
+
+static const struct batchOptions *opt;          /*!< settings of the run */
+static struct host *hosts = NULL;               /*!< all hosts */
+static int epfd = -1;                           /*!< the event loop */
+static struct conn *conns = NULL;               /*!< open connections */
+static int openConns = 0;                       /*!< connections open */
+static int totalConns = 0;                      /*!< connections opened during the run */
+static int done = 0;                            /*!< files written */
+static int failed = 0;                          /*!< urls given up */
+static int notFound = 0;                        /*!< urls answered with a status other than 200 */
+static long long bytes = 0;                     /*!< body bytes received */
+static long long now = 0;                       /*!< ms of the monotonic clock, updated every loop */
+
+/**
+ * @brief Returns a monotonic clock in ms.
+ */
+static long long nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Reads a list of urls, one per line.
+ * @details Empty lines and lines starting with '#' are skipped.
+ * @param path file to read, "-" for stdin.
+ * @param urls array the urls are appended to, grown with realloc.
+ * @param count number of entries in urls, updated.
+ * @return 0 on success, -1 on error.
+ */
+int batchLoadList(const char *path, char ***urls, int *count) {
+    FILE *in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if (in == NULL)
+        return -1;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int ret = 0;
+    while ((len = getline(&line, &cap, in)) >= 0) {
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' '))
+            line[--len] = '\0';
+        if (len == 0 || line[0] == '#')
+            continue;
+        char **grown = realloc(*urls, (*count + 1) * sizeof(char *));
+        char *copy = strdup(line);
+        if (grown == NULL || copy == NULL) {
+            if (grown != NULL)
+                *urls = grown;
+            free(copy);
+            ret = -1;
+            break;
+        }
+        *urls = grown;
+        (*urls)[(*count)++] = copy;
+    }
+    free(line);
+    if (in != stdin)
+        fclose(in);
+    return ret;
+}
+
+/**
+ * @brief Writes a whole buffer, used as bodyFunc of the parser.
+ */
+static int writeFile(void *arg, const char *data, size_t len) {
+    struct conn *c = arg;
+    bytes += len;
+    if (c->file < 0)
+        return 0;
+    while (len > 0) {
+        ssize_t n = write(c->file, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives up on a job.
+ */
+static void giveUp(struct job *job, const char *reason) {
+    fprintf(stderr, "%s: %s: %s\n", opt->name, job->url, reason);
+    failed++;
+}
+
+/**
+ * @brief Appends a job to the queue of its host.
+ */
+static void enqueue(struct job *job) {
+    struct host *h = job->host;
+    job->next = NULL;
+    if (h->tail != NULL)
+        h->tail->next = job;
+    else
+        h->head = job;
+    h->tail = job;
+    h->waiting++;
+}
+
+/**
+ * @brief Gives up on all jobs waiting for a host.
+ */
+static void giveUpHost(struct host *h, const char *reason) {
+    while (h->head != NULL) {
+        giveUp(h->head, reason);
+        h->head = h->head->next;
+    }
+    h->tail = NULL;
+    h->waiting = 0;
+}
+
+/**
+ * @brief Splits a url into host and request target and adds it to the queue of its host.
+ * @return 0 on success, -1 if the url is malformed or memory ran out.
+ */
+static int addJob(struct job *job, const char *url) {
+    const char *start = strstr(url, "//");
+    if (start == NULL || start[2] == '\0' || start[2] == '/')
+        return -1;
+    start += 2;
+    const char *slash = strchr(start, '/');
+    size_t hostLen = (slash != NULL) ? (size_t)(slash - start) : strlen(start);
+
+    struct host *h;
+    for (h = hosts; h != NULL; h = h->next)
+        if (strlen(h->name) == hostLen && strncmp(h->name, start, hostLen) == 0)
+            break;
+    if (h == NULL) {
+        h = calloc(1, sizeof(struct host));
+        if (h == NULL || (h->name = strndup(start, hostLen)) == NULL) {
+            free(h);
+            return -1;
+        }
+        h->next = hosts;
+        hosts = h;
+    }
+
+    const char *base = (slash != NULL) ? strrchr(slash, '/') + 1 : "";
+    if (*base == '\0')
+        base = "index.html";
+    job->url = url;
+    job->path = slash;
+    job->host = h;
+    job->file = malloc(strlen(opt->dirPath) + strlen(base) + 2);
+    if (job->file == NULL)
+        return -1;
+    sprintf(job->file, "%s/%s", opt->dirPath, base);
+    enqueue(job);
+    return 0;
+}
+
+/**
+ * @brief Updates the events a connection waits for.
+ */
+static void watch(struct conn *c, int wantOut) {
+    if (c->wantOut == wantOut)
+        return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (wantOut ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->wantOut = wantOut;
+}
+
+/**
+ * @brief Opens a non-blocking connection to a host.
+ * @return 0 on success, -1 on error.
+ */
+static int openConn(struct host *h) {
+    if (h->addrs == NULL) {
+        const char *err;
+        if (dialResolve(h->name, opt->port, &h->addrs, &err) < 0) {
+            fprintf(stderr, "%s: %s: getaddrinfo: %s\n", opt->name, h->name, err);
+            return -1;
+        }
+        h->orderCount = dialOrder(h->addrs, h->order, DIAL_MAX_ATTEMPTS);
+    }
+    struct addrinfo *rp = h->order[h->orderNext % h->orderCount];
+
+    struct conn *c = calloc(1, sizeof(struct conn));
+    if (c == NULL)
+        return -1;
+    c->file = -1;
+    c->sent = calloc(opt->depth, sizeof(struct job *));
+    c->in = malloc(BATCH_BUF_SIZE);
+    c->fd = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, rp->ai_protocol);
+    if (c->sent == NULL || c->in == NULL || c->fd < 0
+            || (connect(c->fd, rp->ai_addr, rp->ai_addrlen) < 0 && errno != EINPROGRESS)) {
+        if (c->fd >= 0)
+            close(c->fd);
+        free(c->sent);
+        free(c->in);
+        free(c);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    c->wantOut = 1;
+    c->deadline = (opt->connectTimeout > 0) ? now + opt->connectTimeout : 0;
+    c->host = h;
+    c->next = conns;
+    if (conns != NULL)
+        conns->prev = c;
+    conns = c;
+    h->conns++;
+    h->connecting++;
+    openConns++;
+    totalConns++;
+    return 0;
+}
+
+/**
+ * @brief Closes a connection and puts its requests back into the queue.
+ * @param c the connection.
+ * @param reason why the connection broke, NULL if the server just ended it between responses.
+ * @return void
+ */
+static void closeConn(struct conn *c, const char *reason) {
+    struct host *h = c->host;
+    if (c->file >= 0)
+        close(c->file);
+    for (int i = 0; i < c->sentCount; i++) {
+        struct job *job = c->sent[(c->sentHead + i) % opt->depth];
+        if (reason != NULL && i == 0 && ++job->attempts >= BATCH_RETRIES)
+            giveUp(job, reason);
+        else
+            enqueue(job);
+    }
+    if (!c->connected) {
+        h->connecting--;
+        h->orderNext++; // the next connection tries another address
+        if (reason != NULL && ++h->connectFailures >= BATCH_RETRIES + h->orderCount - 1)
+            giveUpHost(h, reason);
+    }
+    if (c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        conns = c->next;
+    if (c->next != NULL)
+        c->next->prev = c->prev;
+    close(c->fd);
+    responseFree(&c->resp);
+    free(c->out);
+    free(c->in);
+    free(c->sent);
+    free(c);
+    h->conns--;
+    openConns--;
+}
+
+/**
+ * @brief Queues requests on a connection up to the pipelining depth and writes what it can.
+ * @return 0 on success, -1 if the connection broke.
+ */
+static int sendRequests(struct conn *c) {
+    struct host *h = c->host;
+    while (c->sentCount < opt->depth && h->head != NULL) {
+        struct job *job = h->head;
+        const char *path = (job->path != NULL) ? job->path : "/";
+        size_t need = strlen(path) + strlen(h->name) + 32;
+        if (c->outLen + need > c->outCap) {
+            char *grown = realloc(c->out, c->outLen + need);
+            if (grown == NULL)
+                return -1;
+            c->out = grown;
+            c->outCap = c->outLen + need;
+        }
+        c->outLen += sprintf(c->out + c->outLen, "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", path, h->name);
+        h->head = job->next;
+        if (h->head == NULL)
+            h->tail = NULL;
+        h->waiting--;
+        c->sent[(c->sentHead + c->sentCount) % opt->depth] = job;
+        c->sentCount++;
+    }
+
+    while (c->outOff < c->outLen) {
+        ssize_t n = send(c->fd, c->out + c->outOff, c->outLen - c->outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            return -1;
+        }
+        c->outOff += n;
+    }
+    if (c->outOff == c->outLen)
+        c->outOff = c->outLen = 0;
+    watch(c, c->outLen > 0);
+    return 0;
+}
+
+/**
+ * @brief Handles the header of the oldest response, opens its output file.
+ * @return 0 on success, -1 if the file can not be opened.
+ */
+static int startResponse(struct conn *c) {
+    struct job *job = c->sent[c->sentHead];
+    c->headerSeen = 1;
+    if (c->resp.status != 200) {
+        size_t len = strcspn(c->resp.header, "\r\n");
+        fprintf(stderr, "%s: %s: %.*s\n", opt->name, job->url, (int)((len > 9) ? len - 9 : 0), c->resp.header + 9);
+        notFound++;
+        return 0;
+    }
+    c->file = open(job->file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (c->file < 0) {
+        fprintf(stderr, "%s: Error opening %s: %s\n", opt->name, job->file, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Finishes the oldest response of a connection.
+ * @return 0 on success, -1 if the file could not be written.
+ */
+static int finishResponse(struct conn *c) {
+    int ret = 0;
+    if (c->file >= 0) {
+        if (close(c->file) < 0)
+            ret = -1;
+        else
+            done++;
+        c->file = -1;
+    }
+    c->sentHead = (c->sentHead + 1) % opt->depth;
+    c->sentCount--;
+    c->headerSeen = 0;
+    return ret;
+}
+
+/**
+ * @brief Parses received bytes of a connection.
+ * @return 1 to keep the connection, 0 if the server ends it after this response, -1 on a protocol error.
+ */
+static int parseInput(struct conn *c, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        if (c->sentCount == 0)
+            return -1;
+        if (c->resp.state == RESP_DONE)
+            responseInit(&c->resp, 0);
+        ssize_t n = responseFeed(&c->resp, c->in + pos, len - pos, writeFile, c);
+        if (n < 0)
+            return -1;
+        pos += n;
+        if (!c->headerSeen && c->resp.state != RESP_HEADER && startResponse(c) < 0)
+            return -1;
+        if (c->resp.state == RESP_DONE) {
+            if (finishResponse(c) < 0)
+                return -1;
+            if (!c->resp.keepAlive)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Handles readiness of a connection.
+ */
+static void handleConn(struct conn *c, unsigned events) {
+    if (!c->connected) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if ((events & (EPOLLERR | EPOLLHUP)) || getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            closeConn(c, (err != 0) ? strerror(err) : "Could not connect to host");
+            return;
+        }
+        c->connected = 1;
+        c->host->connecting--;
+        c->host->connectFailures = 0;
+        c->deadline = 0;
+    }
+
+    if (events & EPOLLIN) {
+        for (;;) {
+            ssize_t n = read(c->fd, c->in, BATCH_BUF_SIZE);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                break;
+            if (n < 0) {
+                closeConn(c, strerror(errno));
+                return;
+            }
+            if (n == 0) {
+                if (c->sentCount > 0 && c->headerSeen && responseEof(&c->resp) == 0) {
+                    if (finishResponse(c) < 0) {
+                        closeConn(c, "Error writing file");
+                        return;
+                    }
+                }
+                closeConn(c, (c->sentCount > 0) ? "Connection closed early" : NULL);
+                return;
+            }
+            if (opt->readTimeout > 0)
+                c->deadline = now + opt->readTimeout;
+            int ret = parseInput(c, n);
+            if (ret < 0) {
+                closeConn(c, "Protocol error!");
+                return;
+            }
+            if (ret == 0) {
+                closeConn(c, NULL);
+                return;
+            }
+            if (n < BATCH_BUF_SIZE)
+                break;
+        }
+    }
+
+    if (sendRequests(c) < 0) {
+        closeConn(c, strerror(errno));
+        return;
+    }
+    if (c->sentCount == 0 && c->host->head == NULL)
+        closeConn(c, NULL);
+    else if (c->sentCount > 0 && c->deadline == 0 && opt->readTimeout > 0)
+        c->deadline = now + opt->readTimeout;
+    else if (c->sentCount == 0)
+        c->deadline = 0;
+}
+
+/**
+ * @brief Opens connections for hosts with waiting urls.
+ * @details A host gets another connection while the connections still being set up can not take all of its
+ * waiting urls.
+ * @return 1 if work is left, 0 if all urls are done.
+ */
+static int schedule(void) {
+    for (struct host *h = hosts; h != NULL; h = h->next) {
+        while (h->conns < opt->connections && h->connecting * opt->depth < h->waiting) {
+            if (openConn(h) == 0)
+                continue;
+            if (++h->connectFailures >= BATCH_RETRIES || h->conns == 0)
+                giveUpHost(h, "Could not connect to host");
+            break;
+        }
+    }
+    return openConns > 0;
+}
+
+/**
+ * @brief Fetches all urls and writes each into its file below the directory.
+ * @param urls the urls.
+ * @param count number of urls.
+ * @param options settings of the run.
+ * @return 0 if all urls were fetched, 3 if a server answered with an error status, 2 if urls failed.
+ */
+int batchRun(char **urls, int count, const struct batchOptions *options) {
+    opt = options;
+    struct job *jobs = calloc(count, sizeof(struct job));
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (jobs == NULL || epfd < 0) {
+        fprintf(stderr, "%s: %s\n", opt->name, strerror(errno));
+        free(jobs);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; i++) {
+        if (addJob(&jobs[i], urls[i]) < 0) {
+            jobs[i].url = urls[i];
+            giveUp(&jobs[i], "The provided URL is not conform!");
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct epoll_event events[BATCH_EVENTS];
+    now = nowMs();
+    while (schedule()) {
+        int n = epoll_wait(epfd, events, BATCH_EVENTS, BATCH_TICK);
+        if (n < 0 && errno != EINTR)
+            break;
+        now = nowMs();
+        for (int i = 0; i < n; i++)
+            handleConn(events[i].data.ptr, events[i].events);
+        for (struct conn *c = conns, *next; c != NULL; c = next) {
+            next = c->next;
+            if (c->deadline != 0 && now >= c->deadline)
+                closeConn(c, "Connection timed out");
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%s: %d of %d files, %lld bytes in %.3f s (%.1f MB/s) over %d connections\n", opt->name,
+            done, count, bytes, secs, (secs > 0) ? bytes / secs / 1e6 : 0.0, totalConns);
+
+    close(epfd);
+    for (int i = 0; i < count; i++)
+        free(jobs[i].file);
+    free(jobs);
+    while (hosts != NULL) {
+        struct host *h = hosts;
+        hosts = h->next;
+        if (h->addrs != NULL)
+            freeaddrinfo(h->addrs);
+        free(h->name);
+        free(h);
+    }
+    if (failed > 0)
+        return 2;
+    return (notFound > 0) ? 3 : 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file batch.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Batch mode of the client, many urls fetched in one event loop.
+ *
+ * Every host gets a pool of keep-alive connections. Requests are pipelined on each connection up to
+ * a configurable depth, responses are matched to their requests in order and written straight into
+ * their files. Requests lost with a broken connection are queued again.
+ **/
+#ifndef BATCH_H
+#define BATCH_H
+
+#define BATCH_CONNECTIONS 4                     /*!< default connections per host */
+#define BATCH_DEPTH 1                           /*!< default number of requests in flight per connection */
+#define BATCH_RETRIES 3                         /*!< attempts per url and failed connects per host */
+#define BATCH_BUF_SIZE (256 * 1024)             /*!< receive buffer per connection */
+#define BATCH_EVENTS 64                         /*!< events handled per epoll_wait() */
+#define BATCH_TICK 100                          /*!< ms between checks of the connection deadlines */
+
+/**
+ * @brief Settings of a batch run.
+ */
+struct batchOptions {
+    const char *name;                           /*!< program name for messages */
+    const char *port;                           /*!< server port */
+    const char *dirPath;                        /*!< directory the files are written to */
+    int connections;                            /*!< connections per host */
+    int depth;                                  /*!< pipelined requests per connection */
+    int connectTimeout;                         /*!< ms to establish a connection, 0 for no limit */
+    int readTimeout;                            /*!< ms without progress on a busy connection, 0 for no limit */
+};
+
+int batchLoadList(const char *path, char ***urls, int *count);
+int batchRun(char **urls, int count, const struct batchOptions *opt);
+
+#endif
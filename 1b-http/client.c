@@ -8,13 +8,26 @@
  * @detail: This Program allows to load Files from HTTP Server supporting HTTP/1.1.
  **/
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <signal.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <netdb.h>
 #include <unistd.h>
+#include "batch.h"
+#include "decoder.h"
+#include "dial.h"
+#include "diskcache.h"
+#include "response.h"
+#include "segment.h"
+
+#define COPY_BUF_SIZE (256 * 1024)  /*!< block size of the read()/write() copy */
+#define PIPE_SIZE (1024 * 1024)     /*!< requested capacity of the splice() pipe */
 
 static char *name;
 
@@ -27,6 +40,52 @@ static char *dirPath;           /*!< folder path of where data should be written
 static char *url;               /*!< request url */
 static char *req;               /*!< request string */
 static char *host;              /*!< request host */
+static char **urls;             /*!< all request urls */
+static int urlCount;            /*!< number of entries in urls */
+static char *listPath;          /*!< file with urls for batch mode, set by `-b` */
+static int connections = BATCH_CONNECTIONS; /*!< connections per host in batch mode */
+static int depth = BATCH_DEPTH; /*!< pipelined requests per connection in batch mode */
+static int segments = 0;        /*!< parallel range requests for a single url, set by `-n` */
+static int continueFlag = 0;    /*!< is set when partial files should be completed, set by `-c` */
+static long long resumeFrom = 0;/*!< size of the partial file of the current url */
+static int connectTimeout = CONNECT_TIMEOUT;    /*!< ms to establish a connection, set by `-t` */
+static int readTimeout = READ_TIMEOUT;          /*!< ms a read may block, set by `-t` */
+static char *cacheDir;          /*!< directory of the response cache, set by `-C` */
+static struct diskCache cache;  /*!< the opened response cache */
+static char *cacheKey;          /*!< cache key of the current url */
+static struct diskCacheEntry cached;    /*!< cache entry of the current url */
+static int cachedSlot = -1;     /*!< slot of cached, -1 if the current url is not cached */
+static int cachedBody = -1;     /*!< the cached body of the current url */
+static char *cacheTmp;          /*!< file the body of the current url is stored in for the cache */
+static int cacheOut = -1;       /*!< descriptor of cacheTmp, -1 once writing to it failed */
+static struct decoder decoder;  /*!< decodes the body of the current url */
+static int decoding = 0;        /*!< the body of the current url goes through decoder */
+
+static struct response resp;            /*!< parser of the current response */
+static char inBuf[COPY_BUF_SIZE];       /*!< bytes read from the connection */
+static size_t inPos = 0;                /*!< first unparsed byte in inBuf */
+static size_t inLen = 0;                /*!< bytes in inBuf */
+static int spliceFds[2] = {-1, -1};     /*!< pipe used by splice(), created on first use */
+static int canSplice = 1;               /*!< cleared once the output turned out not to support splice() */
+
+/**
+ * @brief Forgets the cache state of the current url.
+ * @details A body that was not stored completely is removed from the cache directory.
+ * @return void
+ * @param void
+ */
+void dropCached(void) {
+    if (cachedBody >= 0)
+        close(cachedBody);
+    if (cacheOut >= 0)
+        close(cacheOut);
+    if (cacheTmp != NULL)
+        unlink(cacheTmp);
+    free(cacheTmp);
+    free(cacheKey);
+    cacheKey = cacheTmp = NULL;
+    cachedBody = cacheOut = cachedSlot = -1;
+}
 
 /**
  * @brief clean up function.
@@ -39,6 +98,17 @@ void cleanUp(void) {
         free(host);
     if(req != NULL)
         free(req);
+    host = NULL;
+    req = NULL;
+    responseFree(&resp);
+    dropCached();
+    if (cache.index != NULL)
+        diskCacheClose(&cache);
+    if (spliceFds[0] >= 0) {
+        close(spliceFds[0]);
+        close(spliceFds[1]);
+        spliceFds[0] = spliceFds[1] = -1;
+    }
 }
 
 /**
@@ -50,7 +120,7 @@ void cleanUp(void) {
  */
 void usage(void) {
     cleanUp();
-    fprintf(stderr, "SYNOPSIS\n\t\tclient [-p PORT] [ -o FILE | -d DIR ] URL\n\tEXAMPLE\n\t\tclient http://pan.vmars.tuwien.ac.at/osue/\n");
+    fprintf(stderr, "SYNOPSIS\n\t\tclient [-p PORT] [-t CONNECT,READ] [-c] [-C CACHE_DIR] [ -o FILE | -d DIR ] URL...\n\t\tclient [-p PORT] ( -o FILE | -d DIR ) -n CONNECTIONS URL\n\t\tclient [-p PORT] -d DIR -b URL_FILE [-P CONNECTIONS] [-q DEPTH] [URL...]\n\tEXAMPLE\n\t\tclient http://pan.vmars.tuwien.ac.at/osue/\n");
     exit(EXIT_FAILURE);
 }
 
@@ -76,6 +146,46 @@ int findLastOccurence(char *pnt, char search) {
     return 0;
 }
 
+/**
+ * @brief Parses a positive count given as option argument.
+ * @param arg the option argument.
+ * @param max largest accepted value.
+ * @return the count, exits through usage() if it is invalid.
+ */
+int parseCount(const char *arg, int max) {
+    char *endpnt;
+    long value = strtol(arg, &endpnt, 10);
+    if (*endpnt != '\0' || value < 1 || value > max) {
+        fprintf(stderr, "%s: invalid count %s!\n", name, arg);
+        usage();
+    }
+    return value;
+}
+
+/**
+ * @brief Parses the connect and read timeout given as "CONNECT,READ" in seconds.
+ * @details Either value may be omitted to keep its default, 0 disables the limit.
+ * @param arg the option argument.
+ * @return void, exits through usage() if a value is invalid.
+ */
+void parseTimeouts(const char *arg) {
+    int *targets[2] = { &connectTimeout, &readTimeout };
+    for (int i = 0; i < 2 && *arg != '\0'; i++) {
+        char *endpnt;
+        if (*arg != ',') {
+            double secs = strtod(arg, &endpnt);
+            if (endpnt == arg || secs < 0 || secs > 86400 || (*endpnt != ',' && *endpnt != '\0')) {
+                fprintf(stderr, "%s: invalid timeout %s!\n", name, arg);
+                usage();
+            }
+            *targets[i] = secs * 1000;
+            arg = endpnt;
+        }
+        if (*arg == ',')
+            arg++;
+    }
+}
+
 /**
  * @brief Reads in all arguments and parses them.
  * @details Attempts to map all given arguments to the needed variables and pointers.
@@ -85,7 +195,7 @@ int findLastOccurence(char *pnt, char search) {
  */
 void readArgs(int argc, char **argv) {
     int opt;
-    while((opt = getopt(argc, argv, "p:o:d:")) != -1) {
+    while((opt = getopt(argc, argv, "p:o:d:b:P:q:n:ct:C:")) != -1) {
         switch(opt) {
             case 'p':
                 port = optarg;
@@ -104,11 +214,32 @@ void readArgs(int argc, char **argv) {
                 dirPath = optarg;
                 dirFlag = 1;
                 break;
+            case 'b':
+                listPath = optarg;
+                break;
+            case 'P':
+                connections = parseCount(optarg, 1024);
+                break;
+            case 'q':
+                depth = parseCount(optarg, 1024);
+                break;
+            case 'n':
+                segments = parseCount(optarg, 256);
+                break;
+            case 'c':
+                continueFlag = 1;
+                break;
+            case 't':
+                parseTimeouts(optarg);
+                break;
+            case 'C':
+                cacheDir = optarg;
+                break;
             default: /* '?' */
                 usage();
         }
     }
-    if (optind >= argc) {
+    if (optind >= argc && listPath == NULL) {
         fprintf(stderr, "%s: Missing arguments\n", name);
         usage();
     }
@@ -116,19 +247,71 @@ void readArgs(int argc, char **argv) {
     if(port == NULL)
         port = port80;
 
-    url = argv[optind];
+    urls = argv + optind;
+    urlCount = argc - optind;
     if(filePath != NULL && dirPath != NULL) {
         fprintf(stderr, "%s: Both, file and direcotry paths are set. Remove one!\n", name);
         usage();	
     }
-    if(dirFlag == 1) {
-        int lastSlash = findLastOccurence(url, '/');	
-        if(lastSlash == 0) {
-            filePath = "index.html";
-        } else {
-            filePath = url+lastSlash;
-        }
+    if (listPath != NULL && dirPath == NULL) {
+        fprintf(stderr, "%s: Batch mode writes into a directory, set one with -d!\n", name);
+        usage();
+    }
+    if (segments > 0 && (listPath != NULL || urlCount != 1 || (fileFlag == 0 && dirFlag == 0))) {
+        fprintf(stderr, "%s: Segmented download needs exactly one url and a file or directory!\n", name);
+        usage();
+    }
+    if (continueFlag == 1 && (listPath != NULL || segments > 0 || (fileFlag == 0 && dirFlag == 0) || (fileFlag == 1 && urlCount != 1))) {
+        fprintf(stderr, "%s: Continuing needs a directory or a file for exactly one url!\n", name);
+        usage();
+    }
+    if (cacheDir != NULL && (listPath != NULL || segments > 0)) {
+        fprintf(stderr, "%s: The cache is only used when fetching urls one after the other!\n", name);
+        usage();
+    }
+}
 
+/**
+ * @brief Fetches the urls of the command line and of the url file in batch mode.
+ * @return exit status of the batch run.
+ * @param void
+ */
+int runBatch(void) {
+    char **all = malloc((urlCount > 0 ? urlCount : 1) * sizeof(char *));
+    int count = urlCount;
+    if (all == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        return EXIT_FAILURE;
+    }
+    memcpy(all, urls, urlCount * sizeof(char *));
+    if (batchLoadList(listPath, &all, &count) < 0) {
+        fprintf(stderr, "%s: Error reading %s: %s\n", name, listPath, strerror(errno));
+        for (int i = urlCount; i < count; i++)
+            free(all[i]);
+        free(all);
+        return EXIT_FAILURE;
+    }
+
+    struct batchOptions options = { name, port, dirPath, connections, depth, connectTimeout, readTimeout };
+    int ret = batchRun(all, count, &options);
+    for (int i = urlCount; i < count; i++)
+        free(all[i]);
+    free(all);
+    return ret;
+}
+
+/**
+ * @brief Sets the file name for the current url in directory mode.
+ * @details The name is the last path component of the url, index.html if there is none.
+ * @return void
+ * @param void
+ */
+void fileNameFromURL(void) {
+    int lastSlash = findLastOccurence(url, '/');	
+    if(lastSlash == 0) {
+        filePath = "index.html";
+    } else {
+        filePath = url+lastSlash;
     }
 }
 
@@ -190,12 +373,25 @@ void hostFromURL(void) {
  * @brief Build the request header.
  * @details When all data is set. This function will merge all components into the global 'req' variable.
  * @return void
- * @param void
+ * @param keepAlive 0 to ask the server to close the connection after the response.
  */
-void buildRequest(void) {
+void buildRequest(int keepAlive) {
     char *method = "GET";
     char *file = fileFromURL();
     char *HTTPVersion = "HTTP/1.1";
+    char *connection = keepAlive ? "" : "Connection: close\r\n";
+    char *encoding = (resumeFrom > 0) ? "" : "Accept-Encoding: " DECODER_ACCEPT "\r\n"; // ranges of an encoding can not be appended
+    char range[48] = "";
+    char validators[2 * DISK_CACHE_FIELD_MAX + 48] = "";
+    if (resumeFrom > 0)
+        snprintf(range, sizeof(range), "Range: bytes=%lld-\r\n", resumeFrom);
+    if (cachedSlot >= 0) {
+        int len = 0;
+        if (cached.etag[0] != '\0')
+            len = snprintf(validators, sizeof(validators), "If-None-Match: %s\r\n", cached.etag);
+        if (cached.lastModified[0] != '\0')
+            snprintf(validators + len, sizeof(validators) - len, "If-Modified-Since: %s\r\n", cached.lastModified);
+    }
     hostFromURL();
 
     if(host == NULL) {
@@ -209,16 +405,15 @@ void buildRequest(void) {
         usage();
     }
 
-    size_t size = 0;
-    size = snprintf(NULL, 0, "%s %s %s\r\nHost: %s\r\n\r\n", method, file, HTTPVersion, host);
+    int size = snprintf(NULL, 0, "%s %s %s\r\nHost: %s\r\n%s%s%s%s\r\n", method, file, HTTPVersion, host, range, encoding, validators, connection);
     if( size > 0 ) {
-        req = (char *)malloc(size + 1 + (19*sizeof(char)));
+        req = (char *)malloc(size + 1);
         if(req == NULL) {
             fprintf(stderr, "%s: Memory error!\n", name);
             cleanUp();
             exit(EXIT_FAILURE);
         }
-        snprintf(req, size+1+ (19*sizeof(char)), "%s %s %s\r\nHost: %s\r\nConnection: close\r\n\r\n", method, file, HTTPVersion, host);
+        snprintf(req, size + 1, "%s %s %s\r\nHost: %s\r\n%s%s%s%s\r\n", method, file, HTTPVersion, host, range, encoding, validators, connection);
     } else {
         fprintf(stderr, "%s: Cannot get size of request String\n", name);
         cleanUp();
@@ -229,118 +424,30 @@ void buildRequest(void) {
 
 /**
  * @brief Connect to Server over Socket.
- * @details This function will create a socket, bind it, listen on it and start accepting connections.
+ * @details Resolves the IPv6 and IPv4 addresses of the host and races connection attempts to them,
+ * see dial.c. The socket gets the read timeout, a read that times out fails with EAGAIN.
  * @return created Socket ID.
  * @param void
  */
 int connectToServer(void) {
-    int connection;
-    struct addrinfo hints;
-    struct addrinfo *result, *rp;
-    int s;
-
-    /* Obtain address(es) matching host/port */
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_INET;       /* Allow IPv4 or IPv6 */
-    hints.ai_socktype = SOCK_STREAM; /* stream socket */
-    hints.ai_flags = 0;
-    hints.ai_protocol = 0; /* Any protocol */
-
-    s = getaddrinfo(host, port, &hints, &result);
-    if (s != 0 ) {
-        fprintf(stderr, "%s: getaddrinfo: %s\n", name, gai_strerror(s));
+    struct addrinfo *result;
+    const char *err;
+
+    if (dialResolve(host, port, &result, &err) < 0) {
+        fprintf(stderr, "%s: getaddrinfo: %s\n", name, err);
         cleanUp();
         exit(EXIT_FAILURE);
     }
-
-    for (rp = result; rp != NULL; rp = rp->ai_next) {
-        connection = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (connection == -1) {
-            fprintf(stderr,"%s: socket error! \n", name);
-            cleanUp();
-            exit(EXIT_FAILURE);
-        }
-
-        if (connect(connection, rp->ai_addr, rp->ai_addrlen) != -1) {
-            break; /* Success */
-        }
-
-        close(connection);
-    }
-
+    int connection = dialAddrs(result, connectTimeout, readTimeout, &err);
     freeaddrinfo(result);
-    if (rp == NULL) { /* No address succeeded */
-        fprintf(stderr,"%s: Could not connect to host\n", name);
+    if (connection < 0) {
+        fprintf(stderr,"%s: Could not connect to host: %s\n", name, err);
         cleanUp();
         exit(EXIT_FAILURE);
     }
-
     return connection;
 }
 
-/**
- * @brief Getline from Socket.
- * @details By reading character by character, this function builds up a whole line and then returns it.
- * The Memory needed is dynamically allocated.
- * @param con socket id.
- * @param pnt an empty pointer pointing to the resulting line.
- * @return size of the buffer created to store the line.
- */
-int fgetline(int con, char **pnt) {
-    int bufferSize = 0; 
-    int currentBufferSize = 0; 
-    int linelen;
-    char msg; 
-    char *buffer = NULL; 
-    char *newBuffer;
-
-    for(;;) {
-        linelen = read(con, &msg, 1);
-        if (linelen < 1) {
-            fprintf(stderr, "%s: Nothing was recived\n", name);
-            free(buffer);
-            cleanUp();
-            exit(2);
-        }
-        if (msg == '\n')
-            break;
-        if ((bufferSize == 0) || (currentBufferSize == bufferSize)) { 
-            bufferSize += 64; 
-            newBuffer = realloc(buffer, bufferSize); 
-            if (!newBuffer) { 
-                fprintf(stderr, "%s: Error realloc memory!\n", name);	
-                free(buffer);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            } 
-            buffer = newBuffer; 
-        } 
-        buffer[currentBufferSize] = msg;
-        ++currentBufferSize;
-    } 
-
-    if ((currentBufferSize > 0) && (buffer[currentBufferSize-1] == '\r'))
-        --currentBufferSize;
-
-    // when an empty line is omitted... we need to recheck.
-    if ((bufferSize == 0) || (currentBufferSize == bufferSize)) { 
-        bufferSize += 64; 
-        newBuffer = realloc(buffer, bufferSize); 
-        if (!newBuffer) { 
-            fprintf(stderr, "%s: Error realloc memory!\n", name);	
-            free(buffer);
-            cleanUp();
-            exit(EXIT_FAILURE);
-        } 
-        buffer = newBuffer; 
-    } 
-
-    buffer[currentBufferSize] = '\0';
-    *pnt = buffer; 	
-    return currentBufferSize;
-
-}
-
 /**
  * @brief Validates the first line of a response header.
  * @details This function goes throu the first line of a response Header and will check if it complies with requirements given for this task. 
@@ -392,125 +499,488 @@ void checkFirstLine(char *pnt) {
 }
 
 /**
- * Program entry point.
- * @brief Program starts here.
- * @details The Program will first handle and validate all arguments and then it will attempt to fetch the requested file.
- * @param argc The argument counter.
- * @param argv The argument vector.
- * @return Returns EXIT_SUCCESS.
+ * @brief Writes a whole buffer.
+ * @param fd file to write to.
+ * @param buf the data.
+ * @param len number of bytes.
+ * @return 0 on success, -1 on error.
  */
-int main (int argc, char **argv) {
-    int con;
-    name = argv[0];
-    readArgs(argc, argv);
-    buildRequest();
+int writeAll(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Passes decoded body bytes to the output and to the cache.
+ * @details A failing cache write only stops storing the body, the download goes on.
+ */
+static int writeOut(void *arg, const char *data, size_t len) {
+    int out = *(int *)arg;
+    if (cacheOut >= 0 && writeAll(cacheOut, data, len) < 0) {
+        close(cacheOut);
+        cacheOut = -1;
+    }
+    return (out < 0) ? 0 : writeAll(out, data, len);
+}
+
+/**
+ * @brief Passes body bytes on, used as bodyFunc of the parser.
+ * @details An encoded body goes to the decoder thread, which calls writeOut(), any other straight to writeOut().
+ */
+static int writeBody(void *arg, const char *data, size_t len) {
+    return decoding ? decoderFeed(&decoder, data, len) : writeOut(arg, data, len);
+}
+
+/**
+ * @brief Refills the input buffer from the socket.
+ * @param con socket id.
+ * @return number of bytes read, 0 when the server closed the connection, -1 on error.
+ */
+ssize_t fillBuffer(int con) {
+    for (;;) {
+        ssize_t n = read(con, inBuf, sizeof(inBuf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        inPos = 0;
+        inLen = (n > 0) ? n : 0;
+        return n;
+    }
+}
+
+/**
+ * @brief Reads the response header.
+ * @details Bytes after the header stay in the input buffer.
+ * @param con socket id.
+ * @return 1 when the header is complete, 0 if the server closed the connection before sending anything,
+ * -1 on a malformed or truncated response.
+ */
+int readHeader(int con) {
+    responseInit(&resp, 0);
+    while (resp.state == RESP_HEADER) {
+        if (inPos == inLen) {
+            ssize_t n = fillBuffer(con);
+            if (n <= 0)
+                return (n == 0 && resp.headerLen == 0) ? 0 : -1;
+        }
+        ssize_t used = responseFeed(&resp, inBuf + inPos, inLen - inPos, NULL, NULL);
+        if (used < 0)
+            return -1;
+        inPos += used;
+    }
+    return 1;
+}
+
+/**
+ * @brief Creates the pipe used by spliceBody().
+ * @return 0 on success, -1 if splice() can not be used.
+ * @param void
+ */
+int preparePipe(void) {
+    if (spliceFds[0] >= 0)
+        return 0;
+    if (pipe2(spliceFds, O_CLOEXEC) < 0) {
+        canSplice = 0;
+        return -1;
+    }
+    fcntl(spliceFds[1], F_SETPIPE_SZ, PIPE_SIZE);
+    return 0;
+}
+
+/**
+ * @brief Moves body bytes from the socket to the output with splice().
+ * @details The data goes from the socket into a pipe and from there into the output, so it never
+ * passes through user space. If the output does not support splice() (e.g. a terminal) the bytes
+ * already in the pipe are copied by hand and canSplice is cleared.
+ * @param con socket id.
+ * @param out file to write to.
+ * @param max bytes to move at most.
+ * @return number of bytes moved, 0 when the server closed the connection, -1 on error.
+ */
+ssize_t spliceBody(int con, int out, size_t max) {
+    if (max > PIPE_SIZE)
+        max = PIPE_SIZE;
+
+    ssize_t n;
+    while ((n = splice(con, NULL, spliceFds[1], NULL, max, SPLICE_F_MOVE | SPLICE_F_MORE)) < 0 && errno == EINTR)
+        ;
+    if (n <= 0)
+        return n;
+    ssize_t left = n;
+    while (left > 0) {
+        ssize_t m = splice(spliceFds[0], NULL, out, NULL, left, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (m < 0 && errno == EINTR)
+            continue;
+        if (m < 0 && errno == EINVAL) { // output can not splice, move what is in the pipe by hand
+            canSplice = 0;
+            while (left > 0) {
+                ssize_t r = read(spliceFds[0], inBuf, (left < (ssize_t)sizeof(inBuf)) ? left : (ssize_t)sizeof(inBuf));
+                if (r <= 0 || writeAll(out, inBuf, r) < 0)
+                    return -1;
+                left -= r;
+            }
+            return n;
+        }
+        if (m <= 0)
+            return -1;
+        left -= m;
+    }
+    return n;
+}
+
+/**
+ * @brief Copies the response body to the output.
+ * @details Buffered bytes go through the parser. Stretches of the body without framing, i.e. the rest of a
+ * Content-Length body or of a chunk, are moved with spliceBody() when the buffer is empty and the body is
+ * neither encoded nor stored in the cache. Binary data is
+ * copied unchanged. The body ends where the response says, so the connection can be used again.
+ * @param con socket id, the header has been read by readHeader().
+ * @param out file to write to, -1 to discard the body.
+ * @return 0 on success, -1 on error.
+ */
+int receiveBody(int con, int out) {
+    while (resp.state != RESP_DONE) {
+        if (inPos < inLen) {
+            ssize_t used = responseFeed(&resp, inBuf + inPos, inLen - inPos, writeBody, &out);
+            if (used < 0)
+                return -1;
+            inPos += used;
+            continue;
+        }
+        long long raw = responseRawBody(&resp);
+        ssize_t n;
+        if (raw != 0 && canSplice && out >= 0 && cacheOut < 0 && !decoding && preparePipe() == 0) {
+            n = spliceBody(con, out, (raw < 0) ? PIPE_SIZE : (size_t)raw);
+            if (n > 0) {
+                responseSkip(&resp, n);
+                continue;
+            }
+        } else {
+            n = fillBuffer(con);
+        }
+        if (n == 0)
+            return responseEof(&resp);
+        if (n < 0)
+            return -1;
+    }
+    return 0;
+}
 
-    if((con = connectToServer()) == (-1)) {
-        fprintf(stderr, "%s: Error while attempting to connect to Server.\n",name);
+/**
+ * @brief Builds the path the body of the current url is written to.
+ * @return malloc'ed path, exits on error.
+ * @param void
+ */
+char *buildWritePath(void) {
+    int filePathLen = 0;
+    int dirPathLen = 0;
+    if(filePath != NULL)
+        filePathLen = strlen(filePath);
+    if(dirPath != NULL)
+        dirPathLen = strlen(dirPath);
+    int bufferSize = filePathLen + dirPathLen + 2;
+    char *writePath;
+    writePath = (char *)malloc(bufferSize);
+    if(writePath == NULL) {
+        fprintf(stderr, "%s: Memory error!", name);
         cleanUp();
         exit(EXIT_FAILURE);
     }
+    memset(writePath, 0, bufferSize);
+    if(dirPathLen > 0) {
+        strncat(writePath, dirPath, dirPathLen+1);
+        strncat(writePath, "/\0", 2);
+    }
+    strncat(writePath, filePath, filePathLen);
+    return writePath;
+}
 
-    if (write(con, req, strlen(req)+1) != strlen(req)+1) {
-        fprintf(stderr, "%s: Error while sending request.\n", name);
+/**
+ * @brief Opens the file the body of the current url goes to.
+ * @param mode O_TRUNC to start from scratch, O_APPEND to complete a partial file.
+ * @return file descriptor, exits on error.
+ */
+int openOutput(int mode) {
+    char *writePath = buildWritePath();
+    int out = open(writePath, O_WRONLY | O_CREAT | O_CLOEXEC | mode, 0644);
+    if (out < 0) {
+        fprintf(stderr, "%s: Error opening %s: %s\n", name, writePath, strerror(errno));
+        free(writePath);
         cleanUp();
         exit(EXIT_FAILURE);
     }
+    free(writePath);
+    return out;
+}
 
-    char *line = NULL;
-    int linelen = 0;
-    int firstLine = 0;
-    for(;;) {
-        if ((linelen = fgetline(con, &line)) <= 1) {
-            break;
-        }
-        if (firstLine == 0)
-            checkFirstLine(line);
+/**
+ * @brief Starts decoding the body of the current url if it has a content coding.
+ * @param out file the decoded body is written to, it has to stay valid until finishDecoding().
+ * @return void, exits on an unsupported coding.
+ */
+void startDecoding(int *out) {
+    size_t len;
+    const char *value = responseField(&resp, "Content-Encoding", &len);
+    int coding = (value == NULL) ? CODING_IDENTITY : decoderCoding(value, len);
+    if (coding < 0) {
+        fprintf(stderr, "%s: %s: unsupported Content-Encoding %.*s\n", name, url, (int)len, value);
+        cleanUp();
+        exit(2);
+    }
+    if (coding == CODING_IDENTITY || resp.state == RESP_DONE)
+        return;
+    if (decoderStart(&decoder, coding, writeOut, out) < 0) {
+        fprintf(stderr, "%s: Error starting the decoder!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+    decoding = 1;
+}
 
-        free(line);
-        line=NULL;
-        firstLine = 1;
+/**
+ * @brief Waits until the decoder thread has written what it got.
+ * @details errno is preserved for the report of a receive error.
+ * @param complete the whole body was received.
+ * @return 0 on success, -1 if the body could not be decoded.
+ */
+int finishDecoding(int complete) {
+    if (!decoding)
+        return 0;
+    int saved = errno;
+    decoding = 0;
+    int ret = decoderFinish(&decoder, complete);
+    errno = saved;
+    if (ret == 0)
+        return 0;
+    fprintf(stderr, "%s: Error decoding %s: %s\n", name, url, decoder.error);
+    return -1;
+}
+
+/**
+ * @brief Looks up the current url in the cache.
+ * @details Sets cacheKey and, if a body is cached, cached, cachedSlot and cachedBody. The key holds the
+ * port since the url does not.
+ * @return void
+ * @param void
+ */
+void lookupCache(void) {
+    int len = snprintf(NULL, 0, "%s %s", port, url);
+    cacheKey = malloc(len + 1);
+    if (cacheKey == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
     }
-    free(line);
+    snprintf(cacheKey, len + 1, "%s %s", port, url);
+    cachedSlot = diskCacheLookup(&cache, cacheKey, &cached, &cachedBody);
+}
 
+/**
+ * @brief Makes the body received for the current url the cached one.
+ * @return void
+ * @param void
+ */
+void storeCached(void) {
+    int fd = cacheOut;
+    cacheOut = -1;
+    if (cacheTmp == NULL || fd < 0 || close(fd) < 0)
+        return; // dropCached() removes the incomplete file
+    diskCacheStore(&cache, cacheKey, cacheTmp, &resp);
+    free(cacheTmp);
+    cacheTmp = NULL;
+}
 
-    if(fileFlag == 1 || dirFlag == 1) { // file or folder
+/**
+ * @brief Fetches the single url over parallel range requests.
+ * @return exit status of the download.
+ * @param void
+ */
+int runSegmented(void) {
+    url = urls[0];
+    buildRequest(1);
+    if (dirFlag == 1)
+        fileNameFromURL();
+    char *writePath = buildWritePath();
+    struct segmentOptions options = { name, host, port, fileFromURL(), writePath, segments, connectTimeout, readTimeout };
+    int ret = segmentRun(&options);
+    free(writePath);
+    cleanUp();
+    return ret;
+}
 
-        int filePathLen = 0;
-        int dirPathLen = 0;
-        if(filePath != NULL)
-            filePathLen = strlen(filePath);
-        if(dirPath != NULL)
-            dirPathLen = strlen(dirPath);
-        int bufferSize = filePathLen + dirPathLen + 2;
-        char *writePath;
-        writePath = (char *)malloc(bufferSize);
-        if(writePath == NULL) {
-            fprintf(stderr, "%s: Memory error!", name);
-            exit(EXIT_FAILURE);
+/**
+ * Program entry point.
+ * @brief Program starts here.
+ * @details The Program will first handle and validate all arguments and then it will fetch the requested files
+ * one after the other. Consecutive urls of the same host share one connection as long as the server keeps it open,
+ * only the last request asks the server to close. With a cache, a url whose cached body is still fresh is not
+ * requested at all, any other cached body is revalidated and copied from the cache on 304.
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return Returns EXIT_SUCCESS.
+ */
+int main (int argc, char **argv) {
+    int con = -1;
+    char *conHost = NULL;
+    int out = STDOUT_FILENO;
+    name = argv[0];
+    readArgs(argc, argv);
+    signal(SIGPIPE, SIG_IGN); // a reused connection may be gone, write() reports that as EPIPE
+    if (listPath != NULL)
+        exit(runBatch());
+    if (segments > 0)
+        exit(runSegmented());
+    if (cacheDir != NULL && diskCacheOpen(&cache, cacheDir) < 0) {
+        fprintf(stderr, "%s: Error opening cache %s: %s\n", name, cacheDir, strerror(errno));
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+
+    if (fileFlag == 1 && continueFlag == 0)
+        out = openOutput(O_TRUNC);
+    int perUrl = (dirFlag == 1 || continueFlag == 1);
+
+    for (int i = 0; i < urlCount; i++) {
+        url = urls[i];
+        free(host);
+        free(req);
+        host = req = NULL; // a fresh cache hit skips buildRequest()
+        if (dirFlag == 1)
+            fileNameFromURL();
+        resumeFrom = 0;
+        if (continueFlag == 1) {
+            char *writePath = buildWritePath();
+            struct stat st;
+            if (stat(writePath, &st) == 0 && S_ISREG(st.st_mode))
+                resumeFrom = st.st_size;
+            free(writePath);
         }
-        memset(writePath, 0, bufferSize);
-        if(dirPathLen > 0) {
-            strncat(writePath, dirPath, dirPathLen+1);
-            strncat(writePath, "/\0", 2);
+        dropCached();
+        if (cacheDir != NULL && resumeFrom == 0) {
+            lookupCache();
+            if (cachedSlot >= 0 && diskCacheFresh(&cached)) {
+                if (perUrl)
+                    out = openOutput(O_TRUNC);
+                if (diskCacheCopy(cachedBody, out) < 0 || (perUrl && close(out) < 0)) {
+                    fprintf(stderr, "%s: Error writing %s: %s\n", name, url, strerror(errno));
+                    cleanUp();
+                    exit(EXIT_FAILURE);
+                }
+                continue;
+            }
         }
-        strncat(writePath, filePath, filePathLen);
-        if(writePath == NULL) {
-            fprintf(stderr, "%s: Error with Memory", name);
-            exit(EXIT_FAILURE);
+        buildRequest(i < urlCount - 1);
+
+        if (con >= 0 && (!resp.keepAlive || strcmp(conHost, host) != 0)) {
+            close(con);
+            con = -1;
+        }
+        int reused = (con >= 0);
+        for (;;) {
+            if (con < 0) {
+                if((con = connectToServer()) == (-1)) {
+                    fprintf(stderr, "%s: Error while attempting to connect to Server.\n",name);
+                    cleanUp();
+                    exit(EXIT_FAILURE);
+                }
+                free(conHost);
+                conHost = strdup(host);
+                inPos = inLen = 0;
+            }
+            if (writeAll(con, req, strlen(req)) < 0 && !reused) {
+                fprintf(stderr, "%s: Error while sending request.\n", name);
+                cleanUp();
+                exit(EXIT_FAILURE);
+            }
+            errno = 0;
+            int ret = readHeader(con);
+            if (ret > 0)
+                break;
+            close(con);
+            con = -1;
+            if (ret == 0 && reused) { // the server closed the idle connection, retry on a new one
+                reused = 0;
+                continue;
+            }
+            fprintf(stderr, "%s: %s\n", name, (ret == 0) ? "Nothing was recived" : (errno == EAGAIN) ? "Timed out" : "Protocol error!");
+            cleanUp();
+            exit(2);
         }
 
-        FILE *f = fopen(writePath, "w");
-        if (f == NULL) {
-            fprintf(stderr, "%s: Error opening file!\n", name);
+        size_t lineLen = strcspn(resp.header, "\r\n");
+        char *line = strndup(resp.header, lineLen);
+        if (line == NULL) {
+            fprintf(stderr, "%s: Memory error!\n", name);
+            cleanUp();
             exit(EXIT_FAILURE);
         }
-
-        FILE *sockfile = (FILE *) fdopen(con, "r");
-        int ch;
-        while ((ch = fgetc(sockfile)) != EOF) {
-            fprintf(f, "%c", ch);
+        int mode = O_TRUNC;
+        int fromCache = 0;
+        long long first, size;
+        if (cachedSlot >= 0 && resp.status == 304) {
+            diskCacheRefresh(&cache, cachedSlot, cacheKey, &resp);
+            fromCache = 1;
+        } else if (resumeFrom > 0 && resp.status == 206) {
+            if (responseContentRange(&resp, &first, &size) < 0 || first != resumeFrom) {
+                fprintf(stderr, "%s: Protocol error!\n", name);
+                free(line);
+                cleanUp();
+                exit(2);
+            }
+            mode = O_APPEND;
+        } else if (resumeFrom > 0 && resp.status == 416 && responseContentRange(&resp, &first, &size) == 0 && size == resumeFrom) {
+            mode = 0; // the partial file is already complete
+        } else {
+            checkFirstLine(line);
+            if (resumeFrom > 0)
+                fprintf(stderr, "%s: %s: the server does not support ranges, fetching the whole file\n", name, url);
         }
+        free(line);
 
-        // tell server read is done!
-        shutdown(con, SHUT_WR);
-        void* ttest = NULL;
-        size_t siz = 0;
-        if(read(con, &ttest, siz) < 0) {
-            fprintf(stderr, "%s: socket error!", name);
+        if (perUrl)
+            out = (mode != 0) ? openOutput(mode) : -1;
+        if (fromCache && diskCacheCopy(cachedBody, out) < 0) {
+            fprintf(stderr, "%s: Error writing %s: %s\n", name, url, strerror(errno));
+            close(con);
+            cleanUp();
             exit(EXIT_FAILURE);
         }
-
-        fclose(sockfile);
-        fclose(f);
-        shutdown(con, SHUT_RDWR);
-        close(con);
-
-        free(writePath);
-    } else {
-
-        FILE *sockfile = (FILE *) fdopen(con, "r");
-        int ch;
-
-        while ((ch = fgetc(sockfile)) > 0) {
-            fprintf(stdout, "%c", ch);
+        if (cacheKey != NULL && !fromCache && diskCacheStorable(&resp))
+            cacheOut = diskCacheBegin(&cache, &cacheTmp);
+        startDecoding(&out);
+        errno = 0;
+        int ret = receiveBody(con, out);
+        if (finishDecoding(ret == 0) < 0) { // also when the decoder made receiveBody() fail
+            close(con);
+            cleanUp();
+            exit(2);
         }
-        shutdown(con, SHUT_WR);
-        void* ttest = NULL;
-        size_t siz = 0;
-        if(read(con, &ttest, siz) < 0) {
-            fprintf(stderr, "%s: socket error!", name);
+        if (ret < 0 || (perUrl && out >= 0 && close(out) < 0)) {
+            fprintf(stderr, "%s: Error receiving %s: %s\n", name, url, (ret < 0 && errno == 0) ? "truncated response"
+                    : (errno == EAGAIN) ? "Timed out" : strerror(errno));
+            close(con);
+            cleanUp();
             exit(EXIT_FAILURE);
         }
+        storeCached();
+    }
 
-
-        fclose(sockfile);
-        shutdown(con, SHUT_RDWR);
+    if (con >= 0)
         close(con);
-
+    free(conHost);
+    if (fileFlag == 1 && continueFlag == 0 && close(out) < 0) {
+        fprintf(stderr, "%s: Error writing %s: %s\n", name, filePath, strerror(errno));
+        cleanUp();
+        exit(EXIT_FAILURE);
     }
-
     cleanUp();
     exit(EXIT_SUCCESS);
 }
-
@@ -0,0 +1,247 @@
+/**
+ * @file decoder.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Streaming decoder of content codings running beside the network reads.
+ *
+ * The blocks form a ring: the queued ones start at head, the one after them (tail) is filled by
+ * the producer without holding the lock. Once a block is full it is queued, the producer waits only if
+ * all blocks are queued. The decoder thread works on the head block without the lock and frees it
+ * afterwards. After a failure the thread keeps freeing blocks unread, so the producer never blocks
+ * and learns about the failure on its next call.
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "decoder.h"
+
+/**
+ * @brief Maps the value of a Content-Encoding field to a coding.
+ * @param value the field value.
+ * @param len length of value.
+ * @return one of the CODING_ constants, -1 if the coding is not supported.
+ */
+int decoderCoding(const char *value, size_t len) {
+    if (len == 8 && strncasecmp(value, "identity", len) == 0)
+        return CODING_IDENTITY;
+    if ((len == 4 && strncasecmp(value, "gzip", len) == 0) || (len == 6 && strncasecmp(value, "x-gzip", len) == 0)
+            || (len == 7 && strncasecmp(value, "deflate", len) == 0))
+        return CODING_GZIP;
+#ifdef HAVE_ZSTD
+    if (len == 4 && strncasecmp(value, "zstd", len) == 0)
+        return CODING_ZSTD;
+#endif
+    return -1;
+}
+
+/**
+ * @brief Decodes one block and passes the output on.
+ * @param d the decoder.
+ * @param data encoded bytes.
+ * @param len number of bytes.
+ * @return 0 on success, -1 on error with d->error set.
+ */
+static int decodeBlock(struct decoder *d, const char *data, size_t len) {
+    d->inBytes += len;
+#ifdef HAVE_ZSTD
+    if (d->coding == CODING_ZSTD) {
+        ZSTD_inBuffer in = { data, len, 0 };
+        int full = 0;
+        while (in.pos < in.size || full) {
+            ZSTD_outBuffer out = { d->out, DECODE_OUT, 0 };
+            size_t r = ZSTD_decompressStream(d->zstd, &out, &in);
+            if (ZSTD_isError(r)) {
+                d->error = ZSTD_getErrorName(r);
+                return -1;
+            }
+            d->ended = (r == 0);
+            full = (out.pos == out.size);
+            d->outBytes += out.pos;
+            if (out.pos > 0 && d->sink(d->arg, d->out, out.pos) < 0) {
+                d->error = "writing failed";
+                return -1;
+            }
+        }
+        return 0;
+    }
+#endif
+    z_stream *z = &d->zs;
+    z->next_in = (unsigned char *)data;
+    z->avail_in = len;
+    do {
+        if (d->ended) { // gzip allows several members one after the other
+            if (z->avail_in == 0) // no next member in this block yet
+                break;
+            if (inflateReset(z) != Z_OK) {
+                d->error = "corrupt stream";
+                return -1;
+            }
+            d->ended = 0;
+        }
+        z->next_out = (unsigned char *)d->out;
+        z->avail_out = DECODE_OUT;
+        int r = inflate(z, Z_NO_FLUSH);
+        size_t produced = DECODE_OUT - z->avail_out;
+        if (r == Z_STREAM_END) {
+            d->ended = 1;
+        } else if (r != Z_OK && !(r == Z_BUF_ERROR && z->avail_in == 0)) {
+            d->error = (z->msg != NULL) ? z->msg : "corrupt stream";
+            return -1;
+        }
+        d->outBytes += produced;
+        if (produced > 0 && d->sink(d->arg, d->out, produced) < 0) {
+            d->error = "writing failed";
+            return -1;
+        }
+    } while (z->avail_in > 0 || (z->avail_out == 0 && !d->ended)); // a full buffer may hold back output, unless the member ended
+    return 0;
+}
+
+/**
+ * @brief Body of the decoder thread.
+ */
+static void *decodeThread(void *arg) {
+    struct decoder *d = arg;
+    for (;;) {
+        pthread_mutex_lock(&d->lock);
+        while (d->count == 0 && !d->finished)
+            pthread_cond_wait(&d->changed, &d->lock);
+        if (d->count == 0) {
+            pthread_mutex_unlock(&d->lock);
+            break;
+        }
+        int block = d->head;
+        int failed = d->failed;
+        pthread_mutex_unlock(&d->lock);
+
+        if (!failed && decodeBlock(d, d->blocks + (size_t)block * DECODE_BLOCK, d->lens[block]) < 0)
+            failed = 1;
+
+        pthread_mutex_lock(&d->lock);
+        d->failed |= failed;
+        d->head = (d->head + 1) % DECODE_BLOCKS;
+        d->count--;
+        pthread_cond_signal(&d->changed);
+        pthread_mutex_unlock(&d->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts a decoder thread.
+ * @param d the decoder.
+ * @param coding CODING_GZIP or CODING_ZSTD.
+ * @param sink receives the decoded bytes on the decoder thread.
+ * @param arg argument of sink.
+ * @return 0 on success, -1 on error.
+ */
+int decoderStart(struct decoder *d, int coding, bodyFunc sink, void *arg) {
+    memset(d, 0, sizeof(*d));
+    d->coding = coding;
+    d->sink = sink;
+    d->arg = arg;
+    d->blocks = malloc((size_t)DECODE_BLOCKS * DECODE_BLOCK);
+    d->out = malloc(DECODE_OUT);
+    if (d->blocks == NULL || d->out == NULL)
+        goto fail;
+#ifdef HAVE_ZSTD
+    if (coding == CODING_ZSTD && (d->zstd = ZSTD_createDStream()) == NULL)
+        goto fail;
+#endif
+    if (coding == CODING_GZIP && inflateInit2(&d->zs, 15 + 32) != Z_OK) // 32: detect gzip or zlib header
+        goto fail;
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->changed, NULL);
+    if (pthread_create(&d->thread, NULL, decodeThread, d) != 0) {
+        pthread_mutex_destroy(&d->lock);
+        pthread_cond_destroy(&d->changed);
+        if (coding == CODING_GZIP)
+            inflateEnd(&d->zs);
+        goto fail;
+    }
+    return 0;
+
+fail:
+#ifdef HAVE_ZSTD
+    ZSTD_freeDStream(d->zstd);
+#endif
+    free(d->blocks);
+    free(d->out);
+    return -1;
+}
+
+/**
+ * @brief Queues the block being filled and waits for a free one.
+ * @param d the decoder.
+ * @return 0 on success, -1 if the decoder failed.
+ */
+static int queueBlock(struct decoder *d) {
+    pthread_mutex_lock(&d->lock);
+    d->lens[d->tail] = d->fill;
+    d->tail = (d->tail + 1) % DECODE_BLOCKS;
+    d->count++;
+    d->fill = 0;
+    pthread_cond_signal(&d->changed);
+    while (d->count == DECODE_BLOCKS && !d->failed)
+        pthread_cond_wait(&d->changed, &d->lock);
+    int failed = d->failed;
+    pthread_mutex_unlock(&d->lock);
+    return failed ? -1 : 0;
+}
+
+/**
+ * @brief Hands encoded bytes to the decoder thread, used as bodyFunc of the parser.
+ * @param arg the decoder.
+ * @param data encoded bytes.
+ * @param len number of bytes.
+ * @return 0 on success, -1 if the decoder failed.
+ */
+int decoderFeed(void *arg, const char *data, size_t len) {
+    struct decoder *d = arg;
+    while (len > 0) {
+        char *block = d->blocks + (size_t)d->tail * DECODE_BLOCK; // queueBlock() waited until it is free
+        size_t n = DECODE_BLOCK - d->fill;
+        if (n > len)
+            n = len;
+        memcpy(block + d->fill, data, n);
+        d->fill += n;
+        data += n;
+        len -= n;
+        if (d->fill == DECODE_BLOCK && queueBlock(d) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues the last bytes, waits for the decoder thread and frees the decoder.
+ * @param d the decoder.
+ * @param complete the whole body has been fed, a stream that is not complete then is an error.
+ * @return 0 if the stream was decoded and passed on, -1 on error with d->error set.
+ */
+int decoderFinish(struct decoder *d, int complete) {
+    if (d->fill > 0)
+        queueBlock(d);
+    pthread_mutex_lock(&d->lock);
+    d->finished = 1;
+    pthread_cond_signal(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    if (complete && !d->failed && d->inBytes > 0 && !d->ended) {
+        d->error = "truncated stream";
+        d->failed = 1;
+    }
+
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->changed);
+    if (d->coding == CODING_GZIP)
+        inflateEnd(&d->zs);
+#ifdef HAVE_ZSTD
+    ZSTD_freeDStream(d->zstd);
+#endif
+    free(d->blocks);
+    free(d->out);
+    d->blocks = d->out = NULL;
+    return d->failed ? -1 : 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file decoder.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Streaming decoder of content codings running beside the network reads.
+ *
+ * The thread reading the socket hands the encoded body over in blocks, a decoder thread inflates
+ * them and passes the decoded bytes on. A small ring of blocks between the two keeps both busy:
+ * the next bytes are received while the previous ones are decoded and written.
+ * gzip (and zlib deflate) is always supported, zstd when built with HAVE_ZSTD.
+ **/
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "response.h"
+
+#ifdef HAVE_ZSTD
+#define DECODER_ACCEPT "gzip, zstd"             /*!< value of the Accept-Encoding request field */
+#else
+#define DECODER_ACCEPT "gzip"                   /*!< value of the Accept-Encoding request field */
+#endif
+
+#define DECODE_BLOCK (256 * 1024)               /*!< encoded bytes per block */
+#define DECODE_BLOCKS 8                         /*!< blocks between the network and the decoder thread */
+#define DECODE_OUT (256 * 1024)                 /*!< decoded bytes passed on at once */
+
+#define CODING_IDENTITY 0                       /*!< no content coding */
+#define CODING_GZIP 1                           /*!< gzip, x-gzip or deflate */
+#define CODING_ZSTD 2                           /*!< zstd */
+
+/**
+ * @brief A decoder thread and the blocks queued for it.
+ */
+struct decoder {
+    int coding;                                 /*!< one of the CODING_ constants */
+    bodyFunc sink;                              /*!< receives the decoded bytes */
+    void *arg;                                  /*!< argument of sink */
+    pthread_t thread;                           /*!< the decoder thread */
+    pthread_mutex_t lock;                       /*!< guards head, count, finished and failed */
+    pthread_cond_t changed;                     /*!< signaled when a block was queued or freed */
+    char *blocks;                               /*!< DECODE_BLOCKS blocks of DECODE_BLOCK bytes */
+    size_t lens[DECODE_BLOCKS];                 /*!< bytes in each queued block */
+    int head;                                   /*!< block decoded next */
+    int count;                                  /*!< queued blocks */
+    int tail;                                   /*!< block being filled, the one after the queued ones */
+    size_t fill;                                /*!< bytes in the block being filled */
+    int finished;                               /*!< no more blocks follow */
+    int failed;                                 /*!< decoding or passing on failed */
+    const char *error;                          /*!< message when failed */
+    char *out;                                  /*!< decoded bytes */
+    long long inBytes;                          /*!< encoded bytes decoded */
+    long long outBytes;                         /*!< decoded bytes passed on */
+    int ended;                                  /*!< the current stream is complete */
+    z_stream zs;                                /*!< inflate state for CODING_GZIP */
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;                         /*!< stream state for CODING_ZSTD */
+#endif
+};
+
+int decoderCoding(const char *value, size_t len);
+int decoderStart(struct decoder *d, int coding, bodyFunc sink, void *arg);
+int decoderFeed(void *arg, const char *data, size_t len);
+int decoderFinish(struct decoder *d, int complete);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * @file dial.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Connection setup racing the addresses of a host (Happy Eyeballs, RFC 8305).
+ *
+ * All attempts of one connection are polled together. Every attempt that fails starts the next one
+ * right away, an attempt that just takes long starts the next one after DIAL_ATTEMPT_DELAY. Once a
+ * socket connected the others are closed and the winner is switched back to blocking mode with the
+ * read timeout set as SO_RCVTIMEO and SO_SNDTIMEO.
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "dial.h"
+
+/**
+ * @brief Returns a monotonic clock in ms.
+ */
+static long long nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Resolves the IPv6 and IPv4 addresses of a host.
+ * @param host host name or address literal.
+ * @param port port number.
+ * @param addrs receives the list, free it with freeaddrinfo().
+ * @param err receives a message on error.
+ * @return 0 on success, -1 on error.
+ */
+int dialResolve(const char *host, const char *port, struct addrinfo **addrs, const char **err) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int s = getaddrinfo(host, port, &hints, addrs);
+    if (s != 0) {
+        *err = gai_strerror(s);
+        *addrs = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Orders addresses for connection attempts.
+ * @details The family of the first address, as sorted by getaddrinfo() after RFC 6724, goes first,
+ * then the families alternate as long as both have addresses left.
+ * @param addrs the resolved addresses.
+ * @param order receives the addresses in attempt order.
+ * @param max capacity of order.
+ * @return number of entries in order.
+ */
+int dialOrder(struct addrinfo *addrs, struct addrinfo **order, int max) {
+    if (addrs == NULL)
+        return 0;
+    int first = addrs->ai_family;
+    struct addrinfo *a = addrs;
+    struct addrinfo *b = addrs;
+    int n = 0;
+    while (n < max && (a != NULL || b != NULL)) {
+        while (a != NULL && a->ai_family != first)
+            a = a->ai_next;
+        while (b != NULL && b->ai_family == first)
+            b = b->ai_next;
+        if (a != NULL && n < max) {
+            order[n++] = a;
+            a = a->ai_next;
+        }
+        if (b != NULL && n < max) {
+            order[n++] = b;
+            b = b->ai_next;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Sets the read and write timeout of a connected socket.
+ * @param fd the socket.
+ * @param readTimeout ms a read or write may block, 0 for no limit.
+ * @return 0 on success, -1 on error.
+ */
+int dialSetTimeout(int fd, int readTimeout) {
+    struct timeval tv;
+    tv.tv_sec = readTimeout / 1000;
+    tv.tv_usec = (readTimeout % 1000) * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+        return -1;
+    return setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * @brief Connects to the first address that answers.
+ * @param addrs the resolved addresses.
+ * @param connectTimeout ms until the whole attempt is given up, 0 for no limit.
+ * @param readTimeout ms a read or write on the connection may block, 0 for no limit.
+ * @param err receives a message on error.
+ * @return blocking socket, -1 on error.
+ */
+int dialAddrs(struct addrinfo *addrs, int connectTimeout, int readTimeout, const char **err) {
+    struct addrinfo *order[DIAL_MAX_ATTEMPTS];
+    struct pollfd fds[DIAL_MAX_ATTEMPTS];
+    int count = dialOrder(addrs, order, DIAL_MAX_ATTEMPTS);
+    int next = 0;
+    int active = 0;
+    int winner = -1;
+    int lastError = EHOSTUNREACH;
+    long long start = nowMs();
+    long long nextAttempt = start;
+
+    while (winner < 0) {
+        long long now = nowMs();
+        if (next < count && (active == 0 || now >= nextAttempt)) {
+            struct addrinfo *rp = order[next++];
+            int fd = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, rp->ai_protocol);
+            if (fd < 0) {
+                lastError = errno;
+                continue;
+            }
+            if (connect(fd, rp->ai_addr, rp->ai_addrlen) == 0) {
+                winner = fd;
+                break;
+            }
+            if (errno != EINPROGRESS) {
+                lastError = errno;
+                close(fd);
+                continue;
+            }
+            fds[active].fd = fd;
+            fds[active].events = POLLOUT;
+            active++;
+            nextAttempt = now + DIAL_ATTEMPT_DELAY;
+        }
+        if (active == 0) {
+            if (next < count)
+                continue;
+            break;
+        }
+
+        long long wait = -1;
+        if (next < count)
+            wait = nextAttempt - now;
+        if (connectTimeout > 0 && (wait < 0 || start + connectTimeout - now < wait))
+            wait = start + connectTimeout - now;
+        if (connectTimeout > 0 && now >= start + connectTimeout) {
+            lastError = ETIMEDOUT;
+            break;
+        }
+        int n = poll(fds, active, (wait < 0) ? -1 : (int)wait);
+        if (n < 0 && errno != EINTR) {
+            lastError = errno;
+            break;
+        }
+        for (int i = 0; i < active && n > 0; i++) {
+            if (fds[i].revents == 0)
+                continue;
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (getsockopt(fds[i].fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+                error = errno;
+            if (error == 0) {
+                winner = fds[i].fd;
+                fds[i] = fds[--active];
+                break;
+            }
+            lastError = error;
+            close(fds[i].fd);
+            fds[i--] = fds[--active];
+            nextAttempt = now; // a failed attempt starts the next one right away
+        }
+    }
+
+    for (int i = 0; i < active; i++)
+        close(fds[i].fd);
+    if (winner < 0) {
+        *err = strerror(lastError);
+        return -1;
+    }
+    int flags = fcntl(winner, F_GETFL);
+    if (flags < 0 || fcntl(winner, F_SETFL, flags & ~O_NONBLOCK) < 0 || dialSetTimeout(winner, readTimeout) < 0) {
+        *err = strerror(errno);
+        close(winner);
+        return -1;
+    }
+    return winner;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file dial.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Connection setup racing the addresses of a host (Happy Eyeballs, RFC 8305).
+ *
+ * The addresses are ordered alternating between IPv6 and IPv4. A new non-blocking connect is started
+ * whenever the previous one failed or has not finished within the attempt delay, the first one to
+ * succeed wins. An unreachable address therefore costs at most the attempt delay instead of the kernel
+ * TCP timeout, and the whole setup is bounded by the connect timeout.
+ **/
+#ifndef DIAL_H
+#define DIAL_H
+
+#include <netdb.h>
+
+#define DIAL_ATTEMPT_DELAY 250                  /*!< ms before the next address is tried, RFC 8305 recommends 250 */
+#define DIAL_MAX_ATTEMPTS 64                    /*!< addresses tried per connection */
+#define CONNECT_TIMEOUT 10000                   /*!< default ms to establish a connection */
+#define READ_TIMEOUT 30000                      /*!< default ms a read may block */
+
+int dialResolve(const char *host, const char *port, struct addrinfo **addrs, const char **err);
+int dialOrder(struct addrinfo *addrs, struct addrinfo **order, int max);
+int dialAddrs(struct addrinfo *addrs, int connectTimeout, int readTimeout, const char **err);
+int dialSetTimeout(int fd, int readTimeout);
+
+#endif
@@ -0,0 +1,418 @@
+/**
+ * @file dirindex.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Generated listings of directories without an index file.
+ *
+ * Entries are read with getdents64 in batches of DIR_BATCH bytes and rendered in directory order,
+ * sorting would require reading the whole directory first. While a listing is streamed, the produced
+ * chunks are also collected; if the listing stays small enough it is published to the cache at the end.
+ **/
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "dirindex.h"
+
+#define DIR_BUCKETS 64                          /*!< number of hash buckets */
+#define DIR_BATCH 32768                         /*!< bytes of directory entries fetched per getdents64 */
+#define DIR_ROW_MAX 4096                        /*!< upper bound of one rendered entry, names have at most 255 bytes */
+#define DIR_CHUNK_HEADER 6                      /*!< "XXXX\r\n", the size is zero padded to a fixed width */
+
+/**
+ * @brief Entry layout returned by the getdents64 system call.
+ */
+struct linuxDirent64 {
+    uint64_t d_ino;                             /*!< inode number */
+    int64_t d_off;                              /*!< offset of the next entry */
+    unsigned short d_reclen;                    /*!< size of this record */
+    unsigned char d_type;                       /*!< file type, DT_UNKNOWN on some file systems */
+    char d_name[];                              /*!< NUL terminated name */
+};
+
+/**
+ * @brief State of a listing being rendered.
+ */
+struct dirStream {
+    int fd;                                     /*!< the directory */
+    char *path;                                 /*!< path of the directory, cache key */
+    struct stat st;                             /*!< version of the directory */
+    char *title;                                /*!< HTML escaped request target */
+    int root;                                   /*!< listing of the document root, no parent link */
+    int stage;                                  /*!< 0 before the header, 1 listing entries, 2 finished */
+    char dents[DIR_BATCH];                      /*!< entries of the last getdents64 call */
+    long pos;                                   /*!< next unrendered entry in dents */
+    long len;                                   /*!< valid bytes in dents */
+    char *collect;                              /*!< chunks produced so far, NULL once the listing got too large */
+    size_t collectLen;                          /*!< bytes in collect */
+    size_t collectCap;                          /*!< capacity of collect */
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;    /*!< guards all fields below and the refs of all entries */
+static struct dirListing *buckets[DIR_BUCKETS];            /*!< hash table */
+static struct dirListing *lruHead = NULL;                   /*!< most recently used entry */
+static struct dirListing *lruTail = NULL;                   /*!< least recently used entry */
+static size_t cachedBytes = 0;                              /*!< bytes held by the cache */
+
+/**
+ * @brief FNV-1a hash of a path.
+ */
+static unsigned int hashPath(const char *path) {
+    unsigned int h = 2166136261u;
+    while (*path) {
+        h ^= (unsigned char)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Drops one reference, the caller must hold the lock.
+ */
+static void releaseLocked(struct dirListing *listing) {
+    if (--listing->refs > 0)
+        return;
+    free(listing->data);
+    free(listing->path);
+    free(listing);
+}
+
+/**
+ * @brief Removes an entry from hash table and LRU list, the caller must hold the lock.
+ */
+static void unlinkLocked(struct dirListing *listing) {
+    struct dirListing **pp = &buckets[listing->hash % DIR_BUCKETS];
+    while (*pp != listing)
+        pp = &(*pp)->hnext;
+    *pp = listing->hnext;
+
+    if (listing->prev != NULL)
+        listing->prev->next = listing->next;
+    else
+        lruHead = listing->next;
+    if (listing->next != NULL)
+        listing->next->prev = listing->prev;
+    else
+        lruTail = listing->prev;
+
+    cachedBytes -= listing->len;
+    releaseLocked(listing);
+}
+
+/**
+ * @brief Checks if a cache entry still describes the given directory version.
+ */
+static int sameVersion(const struct dirListing *listing, const struct stat *st) {
+    return listing->dev == st->st_dev && listing->ino == st->st_ino &&
+           listing->mtime.tv_sec == st->st_mtim.tv_sec && listing->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Returns the cached listing of a directory.
+ * @details An outdated entry is dropped. The returned entry stays valid until dirCacheRelease() is called.
+ * @param path path of the directory.
+ * @param st stat result of the directory.
+ * @return the entry or NULL if the listing has to be rendered.
+ */
+struct dirListing *dirCacheGet(const char *path, const struct stat *st) {
+    unsigned int hash = hashPath(path);
+    struct dirListing *listing;
+
+    pthread_mutex_lock(&lock);
+    for (listing = buckets[hash % DIR_BUCKETS]; listing != NULL; listing = listing->hnext) {
+        if (listing->hash == hash && strcmp(listing->path, path) == 0)
+            break;
+    }
+    if (listing != NULL && !sameVersion(listing, st)) {
+        unlinkLocked(listing);
+        listing = NULL;
+    }
+    if (listing != NULL && lruHead != listing) {
+        listing->prev->next = listing->next;
+        if (listing->next != NULL)
+            listing->next->prev = listing->prev;
+        else
+            lruTail = listing->prev;
+        listing->prev = NULL;
+        listing->next = lruHead;
+        lruHead->prev = listing;
+        lruHead = listing;
+    }
+    if (listing != NULL)
+        listing->refs++;
+    pthread_mutex_unlock(&lock);
+    return listing;
+}
+
+/**
+ * @brief Stores a completely rendered listing, replacing an older one of the same directory.
+ */
+static void publish(struct dirStream *s) {
+    struct dirListing *listing = calloc(1, sizeof(*listing));
+    if (listing == NULL || (listing->path = strdup(s->path)) == NULL) {
+        free(listing);
+        return;
+    }
+    listing->dev = s->st.st_dev;
+    listing->ino = s->st.st_ino;
+    listing->mtime = s->st.st_mtim;
+    listing->data = s->collect;
+    listing->len = s->collectLen;
+    listing->hash = hashPath(s->path);
+    listing->refs = 1;
+    s->collect = NULL;
+
+    pthread_mutex_lock(&lock);
+    struct dirListing *other;
+    for (other = buckets[listing->hash % DIR_BUCKETS]; other != NULL; other = other->hnext) {
+        if (other->hash == listing->hash && strcmp(other->path, listing->path) == 0) {
+            unlinkLocked(other);
+            break;
+        }
+    }
+    listing->hnext = buckets[listing->hash % DIR_BUCKETS];
+    buckets[listing->hash % DIR_BUCKETS] = listing;
+    listing->next = lruHead;
+    if (lruHead != NULL)
+        lruHead->prev = listing;
+    lruHead = listing;
+    if (lruTail == NULL)
+        lruTail = listing;
+    cachedBytes += listing->len;
+    while (cachedBytes > DIR_CACHE_BUDGET && lruTail != listing)
+        unlinkLocked(lruTail);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Returns an entry obtained by dirCacheGet().
+ * @param listing the entry, NULL is ignored.
+ * @return void
+ */
+void dirCacheRelease(struct dirListing *listing) {
+    if (listing == NULL)
+        return;
+    pthread_mutex_lock(&lock);
+    releaseLocked(listing);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Frees all cached listings.
+ * @return void
+ */
+void dirCacheDestroy(void) {
+    pthread_mutex_lock(&lock);
+    while (lruTail != NULL)
+        unlinkLocked(lruTail);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Copies a string with the HTML special characters escaped.
+ * @return number of bytes written, at most 6 per input byte.
+ */
+static size_t htmlEscape(char *out, const char *s) {
+    size_t n = 0;
+    for (; *s != '\0'; s++) {
+        const char *rep = NULL;
+        switch (*s) {
+            case '&': rep = "&amp;"; break;
+            case '<': rep = "&lt;"; break;
+            case '>': rep = "&gt;"; break;
+            case '"': rep = "&quot;"; break;
+            case '\'': rep = "&#39;"; break;
+        }
+        if (rep != NULL) {
+            size_t len = strlen(rep);
+            memcpy(out + n, rep, len);
+            n += len;
+        } else {
+            out[n++] = *s;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Copies a file name percent-encoded for use as a relative link.
+ * @return number of bytes written, at most 3 per input byte.
+ */
+static size_t urlEscape(char *out, const char *s) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (; *s != '\0'; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+            ch == '-' || ch == '_' || ch == '.' || ch == '~') {
+            out[n++] = ch;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[ch >> 4];
+            out[n++] = hex[ch & 15];
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Starts rendering the listing of a directory.
+ * @param path path of the directory.
+ * @param url request target of the directory, shown as title.
+ * @param st stat result of the directory, the version the listing is cached as.
+ * @return the stream or NULL if the directory can not be read.
+ */
+struct dirStream *dirStreamOpen(const char *path, const char *url, const struct stat *st) {
+    struct dirStream *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return NULL;
+    s->fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    s->path = strdup(path);
+    s->title = malloc(strlen(url) * 6 + 1);
+    if (s->fd < 0 || s->path == NULL || s->title == NULL) {
+        dirStreamClose(s);
+        return NULL;
+    }
+    s->title[htmlEscape(s->title, url)] = '\0';
+    s->root = (strcmp(url, "/") == 0);
+    s->st = *st;
+    s->collectCap = DIR_CHUNK_MAX;
+    s->collect = malloc(s->collectCap);
+    return s;
+}
+
+/**
+ * @brief Renders one directory entry as a table row.
+ * @return number of bytes written, 0 if the entry is skipped.
+ */
+static size_t renderEntry(struct dirStream *s, char *out, const struct linuxDirent64 *d) {
+    if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+        return 0;
+
+    struct stat st;
+    int known = (fstatat(s->fd, d->d_name, &st, 0) == 0);
+    int isDir = known ? S_ISDIR(st.st_mode) : (d->d_type == DT_DIR);
+    char date[32] = "-";
+    char size[32] = "-";
+    if (known) {
+        struct tm tm_info;
+        gmtime_r(&st.st_mtim.tv_sec, &tm_info);
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", &tm_info);
+        if (!isDir)
+            snprintf(size, sizeof(size), "%lld", (long long)st.st_size);
+    }
+
+    size_t n = 0;
+    memcpy(out + n, "<tr><td><a href=\"", 17);
+    n += 17;
+    n += urlEscape(out + n, d->d_name);
+    if (isDir)
+        out[n++] = '/';
+    memcpy(out + n, "\">", 2);
+    n += 2;
+    n += htmlEscape(out + n, d->d_name);
+    if (isDir)
+        out[n++] = '/';
+    n += sprintf(out + n, "</a></td><td>%s</td><td align=\"right\">%s</td></tr>\n", date, size);
+    return n;
+}
+
+/**
+ * @brief Renders the next chunk of the listing.
+ * @details The chunk is framed with the chunked transfer coding, the last one also carries the
+ * terminating zero length chunk. Once the listing is complete and small enough it is cached.
+ * @param s the stream.
+ * @param out buffer of at least DIR_CHUNK_MAX bytes.
+ * @return number of bytes written, 0 after the last chunk, -1 if reading the directory failed.
+ */
+ssize_t dirStreamRead(struct dirStream *s, char *out) {
+    if (s->stage == 2)
+        return 0;
+
+    char *p = out + DIR_CHUNK_HEADER;
+    size_t n = 0;
+    if (s->stage == 0) {
+        n += sprintf(p, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Index of %.*s</title></head>\n"
+                        "<body>\n<h1>Index of %.*s</h1>\n<table>\n<tr><th>Name</th><th>Last modified</th><th>Size</th></tr>\n",
+                        DIR_ROW_MAX, s->title, DIR_ROW_MAX, s->title);
+        if (!s->root)
+            n += sprintf(p + n, "<tr><td><a href=\"../\">../</a></td><td></td><td></td></tr>\n");
+        s->stage = 1;
+    }
+
+    while (s->stage == 1 && n + DIR_ROW_MAX <= DIR_CHUNK_SIZE) {
+        if (s->pos >= s->len) {
+            s->len = syscall(SYS_getdents64, s->fd, s->dents, sizeof(s->dents));
+            s->pos = 0;
+            if (s->len < 0)
+                return -1;
+            if (s->len == 0) {
+                n += sprintf(p + n, "</table>\n</body></html>\n");
+                s->stage = 2;
+                break;
+            }
+        }
+        const struct linuxDirent64 *d = (const struct linuxDirent64 *)(s->dents + s->pos);
+        s->pos += d->d_reclen;
+        n += renderEntry(s, p + n, d);
+    }
+
+    char header[DIR_CHUNK_HEADER + 1];
+    snprintf(header, sizeof(header), "%04zx\r\n", n);
+    memcpy(out, header, DIR_CHUNK_HEADER);
+    size_t len = DIR_CHUNK_HEADER + n;
+    memcpy(out + len, "\r\n", 2);
+    len += 2;
+    if (s->stage == 2) {
+        memcpy(out + len, "0\r\n\r\n", 5);
+        len += 5;
+    }
+
+    if (s->collect != NULL) {
+        if (s->collectLen + len > DIR_CACHE_MAX_LISTING) {
+            free(s->collect);
+            s->collect = NULL;
+        } else {
+            if (s->collectLen + len > s->collectCap) {
+                size_t newCap = s->collectCap * 2;
+                char *grown = realloc(s->collect, newCap);
+                if (grown == NULL) {
+                    free(s->collect);
+                    s->collect = NULL;
+                }
+                s->collect = grown;
+                s->collectCap = newCap;
+            }
+            if (s->collect != NULL) {
+                memcpy(s->collect + s->collectLen, out, len);
+                s->collectLen += len;
+            }
+        }
+    }
+    if (s->stage == 2 && s->collect != NULL)
+        publish(s);
+    return len;
+}
+
+/**
+ * @brief Stops rendering and frees the stream. A listing that was not completed is not cached.
+ * @param s the stream, NULL is ignored.
+ * @return void
+ */
+void dirStreamClose(struct dirStream *s) {
+    if (s == NULL)
+        return;
+    if (s->fd >= 0)
+        close(s->fd);
+    free(s->collect);
+    free(s->title);
+    free(s->path);
+    free(s);
+}
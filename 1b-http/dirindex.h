@@ -0,0 +1,50 @@
+/**
+ * @file dirindex.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Generated listings of directories without an index file.
+ *
+ * A listing is rendered chunk by chunk while it is sent, so huge directories are never held in memory.
+ * Listings up to DIR_CACHE_MAX_LISTING are kept until the modification time of the directory changes.
+ * Only adding, removing or renaming entries changes it, sizes of files modified in place may be stale.
+ **/
+#ifndef DIRINDEX_H
+#define DIRINDEX_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define DIR_CHUNK_SIZE 32768                    /*!< rendered bytes per chunk of the transfer encoding */
+#define DIR_CHUNK_MAX (DIR_CHUNK_SIZE + 16)     /*!< buffer needed by dirStreamRead() including the framing */
+#define DIR_CACHE_BUDGET (16 * 1024 * 1024)     /*!< maximum bytes of listings kept in memory */
+#define DIR_CACHE_MAX_LISTING (1024 * 1024)     /*!< larger listings are rendered on every request */
+
+/**
+ * @brief A rendered listing, already framed with the chunked transfer coding.
+ */
+struct dirListing {
+    char *path;                                 /*!< path of the directory */
+    dev_t dev;                                  /*!< device of the directory */
+    ino_t ino;                                  /*!< inode of the directory */
+    struct timespec mtime;                      /*!< modification time of the directory */
+    char *data;                                 /*!< the chunked body including the last chunk */
+    size_t len;                                 /*!< number of bytes of data */
+    int refs;                                   /*!< users of this entry, the cache itself holds one */
+    unsigned int hash;                          /*!< hash of path */
+    struct dirListing *hnext;                   /*!< next entry in the same hash bucket */
+    struct dirListing *prev;                    /*!< more recently used entry */
+    struct dirListing *next;                    /*!< less recently used entry */
+};
+
+struct dirStream;
+
+struct dirListing *dirCacheGet(const char *path, const struct stat *st);
+void dirCacheRelease(struct dirListing *listing);
+void dirCacheDestroy(void);
+struct dirStream *dirStreamOpen(const char *path, const char *url, const struct stat *st);
+ssize_t dirStreamRead(struct dirStream *s, char *out);
+void dirStreamClose(struct dirStream *s);
+
+#endif
@@ -0,0 +1,346 @@
+/**
+ * @file diskcache.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief On-disk cache of response bodies for the client.
+ *
+ * The index is an open addressed hash table with linear probing. Slots are never emptied, only
+ * taken over, so a probe can stop at the first free slot. When the probe sequence of a key is full
+ * the key replaces the entry in its home slot. A new body is written to a temporary file and renamed
+ * over the body file of its slot, so other processes never see half of a body. Every access to the
+ * index happens under an exclusive flock() of the index file.
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "diskcache.h"
+
+#define COPY_CHUNK (1024 * 1024)                /*!< bytes moved per sendfile() call */
+
+/**
+ * @brief FNV-1a hash of a key, never 0 since that marks a free slot.
+ */
+static uint64_t hashKey(const char *key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (; *key != '\0'; key++) {
+        h ^= (unsigned char)*key;
+        h *= 1099511628211ULL;
+    }
+    return (h == 0) ? 1 : h;
+}
+
+/**
+ * @brief Builds "dir/name".
+ * @return malloc'ed path, NULL on memory error.
+ */
+static char *cachePath(const struct diskCache *c, const char *name) {
+    size_t len = strlen(c->dir) + strlen(name) + 2;
+    char *path = malloc(len);
+    if (path != NULL)
+        snprintf(path, len, "%s/%s", c->dir, name);
+    return path;
+}
+
+/**
+ * @brief Builds the path of the body file of a slot.
+ * @return malloc'ed path, NULL on memory error.
+ */
+static char *slotPath(const struct diskCache *c, int slot) {
+    char name[16];
+    snprintf(name, sizeof(name), "%d", slot);
+    return cachePath(c, name);
+}
+
+/**
+ * @brief Finds the slot of a key.
+ * @param c the cache, locked.
+ * @param key the key.
+ * @param hash hash of the key.
+ * @param freeSlot receives the first free slot of the probe sequence, -1 if there is none.
+ * @return the slot, -1 if the key is not in the index.
+ */
+static int findSlot(const struct diskCache *c, const char *key, uint64_t hash, int *freeSlot) {
+    *freeSlot = -1;
+    for (int i = 0; i < DISK_CACHE_SLOTS; i++) {
+        int slot = (hash + i) % DISK_CACHE_SLOTS;
+        const struct diskCacheEntry *e = &c->index->entries[slot];
+        if (e->hash == 0) {
+            *freeSlot = slot;
+            return -1;
+        }
+        if (e->hash == hash && strcmp(e->key, key) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+/**
+ * @brief Copies a header field of the response into an entry.
+ * @param dst the field of the entry.
+ * @param r the response.
+ * @param field name of the header field.
+ * @param keep keep the old value if the response does not have the field.
+ */
+static void copyField(char *dst, const struct response *r, const char *field, int keep) {
+    size_t len;
+    const char *value = responseField(r, field, &len);
+    if (value == NULL && keep)
+        return;
+    if (value == NULL || len >= DISK_CACHE_FIELD_MAX) // a cut off validator would never match
+        len = 0;
+    if (len > 0)
+        memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
+/**
+ * @brief Takes the validators and the freshness of a response into an entry.
+ * @param e the entry.
+ * @param r the response, 200 for a new body or 304 for a revalidated one.
+ * @param keep keep the old fields the response does not carry.
+ */
+static void fillEntry(struct diskCacheEntry *e, const struct response *r, int keep) {
+    copyField(e->etag, r, "ETag", keep);
+    copyField(e->lastModified, r, "Last-Modified", keep);
+    copyField(e->cacheControl, r, "Cache-Control", keep);
+    e->noCache = (strcasestr(e->cacheControl, "no-cache") != NULL);
+    e->maxAge = -1;
+    const char *maxAge = strcasestr(e->cacheControl, "max-age=");
+    if (maxAge != NULL)
+        e->maxAge = strtoll(maxAge + 8, NULL, 10);
+    e->stored = time(NULL);
+}
+
+/**
+ * @brief Opens a cache directory, creating it and its index if needed.
+ * @details An index of a different layout is cleared.
+ * @param c receives the opened cache.
+ * @param dir the cache directory.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int diskCacheOpen(struct diskCache *c, const char *dir) {
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return -1;
+    if ((c->dir = strdup(dir)) == NULL)
+        return -1;
+    char *path = cachePath(c, "index");
+    if (path == NULL)
+        goto fail;
+    c->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    free(path);
+    if (c->fd < 0)
+        goto fail;
+
+    c->mapLen = sizeof(struct diskCacheIndex) + DISK_CACHE_SLOTS * sizeof(struct diskCacheEntry);
+    flock(c->fd, LOCK_EX);
+    struct stat st;
+    if (fstat(c->fd, &st) < 0 || ((size_t)st.st_size != c->mapLen && ftruncate(c->fd, c->mapLen) < 0)) {
+        flock(c->fd, LOCK_UN);
+        goto fail;
+    }
+    c->index = mmap(NULL, c->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if (c->index == MAP_FAILED) {
+        c->index = NULL;
+        flock(c->fd, LOCK_UN);
+        goto fail;
+    }
+    if (c->index->magic != DISK_CACHE_MAGIC || c->index->slots != DISK_CACHE_SLOTS
+            || c->index->entrySize != sizeof(struct diskCacheEntry)) {
+        memset(c->index, 0, c->mapLen);
+        c->index->magic = DISK_CACHE_MAGIC;
+        c->index->slots = DISK_CACHE_SLOTS;
+        c->index->entrySize = sizeof(struct diskCacheEntry);
+    }
+    flock(c->fd, LOCK_UN);
+    return 0;
+
+fail:
+    diskCacheClose(c);
+    return -1;
+}
+
+/**
+ * @brief Unmaps the index and frees the cache.
+ * @param c the cache.
+ */
+void diskCacheClose(struct diskCache *c) {
+    int saved = errno;
+    if (c->index != NULL)
+        munmap(c->index, c->mapLen);
+    if (c->fd >= 0)
+        close(c->fd);
+    free(c->dir);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    errno = saved;
+}
+
+/**
+ * @brief Looks up the body stored for a key.
+ * @param c the cache.
+ * @param key port and url.
+ * @param entry receives a copy of the entry.
+ * @param body receives the opened body file.
+ * @return the slot of the entry, -1 if there is no complete body for the key.
+ */
+int diskCacheLookup(struct diskCache *c, const char *key, struct diskCacheEntry *entry, int *body) {
+    int freeSlot;
+    uint64_t hash = hashKey(key);
+    flock(c->fd, LOCK_EX);
+    int slot = findSlot(c, key, hash, &freeSlot);
+    if (slot >= 0) {
+        *entry = c->index->entries[slot];
+        char *path = slotPath(c, slot);
+        struct stat st;
+        *body = (path != NULL) ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+        free(path);
+        if (*body >= 0 && (fstat(*body, &st) < 0 || st.st_size != entry->size)) {
+            close(*body);
+            *body = -1;
+        }
+        if (*body < 0)
+            slot = -1;
+    }
+    flock(c->fd, LOCK_UN);
+    return slot;
+}
+
+/**
+ * @brief Checks if a body may be used without asking the server.
+ * @param entry the entry of the body.
+ * @return 1 if Cache-Control max-age has not run out yet, 0 otherwise.
+ */
+int diskCacheFresh(const struct diskCacheEntry *entry) {
+    return !entry->noCache && entry->maxAge >= 0 && time(NULL) < entry->stored + entry->maxAge;
+}
+
+/**
+ * @brief Checks if a response may be stored.
+ * @param r a response whose header is complete.
+ * @return 1 for a 200 response without Cache-Control no-store, 0 otherwise.
+ */
+int diskCacheStorable(const struct response *r) {
+    size_t len;
+    const char *value = responseField(r, "Cache-Control", &len);
+    if (r->status != 200)
+        return 0;
+    for (size_t i = 0; value != NULL && i + 8 <= len; i++)
+        if (strncasecmp(value + i, "no-store", 8) == 0)
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief Creates the temporary file a new body is written to.
+ * @param c the cache.
+ * @param tmpPath receives the malloc'ed path of the file.
+ * @return file descriptor, -1 on error.
+ */
+int diskCacheBegin(struct diskCache *c, char **tmpPath) {
+    *tmpPath = cachePath(c, "tmp.XXXXXX");
+    if (*tmpPath == NULL)
+        return -1;
+    int fd = mkostemp(*tmpPath, O_CLOEXEC);
+    if (fd < 0) {
+        free(*tmpPath);
+        *tmpPath = NULL;
+    }
+    return fd;
+}
+
+/**
+ * @brief Makes a completely received body the cached body of a key.
+ * @param c the cache.
+ * @param key port and url.
+ * @param tmpPath the file from diskCacheBegin(), it is renamed or removed.
+ * @param r the response the body belongs to.
+ * @return 0 on success, -1 on error.
+ */
+int diskCacheStore(struct diskCache *c, const char *key, const char *tmpPath, const struct response *r) {
+    struct stat st;
+    if (strlen(key) >= DISK_CACHE_KEY_MAX || stat(tmpPath, &st) < 0) {
+        unlink(tmpPath);
+        return -1;
+    }
+    int freeSlot;
+    uint64_t hash = hashKey(key);
+    flock(c->fd, LOCK_EX);
+    int slot = findSlot(c, key, hash, &freeSlot);
+    if (slot < 0)
+        slot = (freeSlot >= 0) ? freeSlot : (int)(hash % DISK_CACHE_SLOTS);
+    char *path = slotPath(c, slot);
+    if (path == NULL || rename(tmpPath, path) < 0) {
+        flock(c->fd, LOCK_UN);
+        free(path);
+        unlink(tmpPath);
+        return -1;
+    }
+    free(path);
+    struct diskCacheEntry *e = &c->index->entries[slot];
+    memset(e, 0, sizeof(*e));
+    e->hash = hash;
+    e->size = st.st_size;
+    strcpy(e->key, key);
+    fillEntry(e, r, 0);
+    flock(c->fd, LOCK_UN);
+    return 0;
+}
+
+/**
+ * @brief Records that the server confirmed a cached body with 304.
+ * @details Fields sent with the 304 replace the stored ones, the freshness starts again.
+ * @param c the cache.
+ * @param slot the slot returned by diskCacheLookup().
+ * @param key port and url.
+ * @param r the 304 response.
+ */
+void diskCacheRefresh(struct diskCache *c, int slot, const char *key, const struct response *r) {
+    flock(c->fd, LOCK_EX);
+    struct diskCacheEntry *e = &c->index->entries[slot];
+    if (e->hash == hashKey(key) && strcmp(e->key, key) == 0)
+        fillEntry(e, r, 1);
+    flock(c->fd, LOCK_UN);
+}
+
+/**
+ * @brief Copies a cached body to the output.
+ * @details sendfile() is used where the output supports it, read() and write() otherwise.
+ * @param body the body file from diskCacheLookup().
+ * @param out file to write to.
+ * @return 0 on success, -1 on error.
+ */
+int diskCacheCopy(int body, int out) {
+    ssize_t n;
+    while ((n = sendfile(out, body, NULL, COPY_CHUNK)) != 0) {
+        if (n > 0 || errno == EINTR)
+            continue;
+        if (errno != EINVAL && errno != ENOSYS)
+            return -1;
+        char buf[64 * 1024];
+        while ((n = read(body, buf, sizeof(buf))) != 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+                return -1;
+            for (ssize_t done = 0; done < n; ) {
+                ssize_t m = write(out, buf + done, n - done);
+                if (m < 0 && errno != EINTR)
+                    return -1;
+                done += (m > 0) ? m : 0;
+            }
+        }
+        return 0;
+    }
+    return 0;
+}
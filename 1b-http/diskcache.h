@@ -0,0 +1,72 @@
+/**
+ * @file diskcache.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief On-disk cache of response bodies for the client.
+ *
+ * The cache directory holds an index file and one body file per index slot. The index is a fixed
+ * size hash table of entries that is mapped into memory, an entry keeps the key (port and url), the
+ * body size and the ETag, Last-Modified and Cache-Control fields of the response. A cached body is
+ * revalidated with If-None-Match and If-Modified-Since, or used without asking the server as long
+ * as Cache-Control max-age says it is fresh.
+ **/
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "response.h"
+
+#define DISK_CACHE_MAGIC 0x31435448             /*!< "HTC1", marks an index file of this layout */
+#define DISK_CACHE_SLOTS 1024                   /*!< entries in the index */
+#define DISK_CACHE_KEY_MAX 1024                 /*!< longest key, longer ones are not cached */
+#define DISK_CACHE_FIELD_MAX 128                /*!< longest stored header value */
+
+/**
+ * @brief One slot of the index.
+ */
+struct diskCacheEntry {
+    uint64_t hash;                              /*!< hash of the key, 0 for a free slot */
+    long long size;                             /*!< bytes in the body file */
+    long long stored;                           /*!< time the body was stored or last revalidated */
+    long long maxAge;                           /*!< seconds the body is fresh after stored, -1 if unknown */
+    int noCache;                                /*!< the body has to be revalidated before every use */
+    char key[DISK_CACHE_KEY_MAX];               /*!< port and url */
+    char etag[DISK_CACHE_FIELD_MAX];            /*!< ETag field, empty if none */
+    char lastModified[DISK_CACHE_FIELD_MAX];    /*!< Last-Modified field, empty if none */
+    char cacheControl[DISK_CACHE_FIELD_MAX];    /*!< Cache-Control field, empty if none */
+};
+
+/**
+ * @brief Layout of the index file.
+ */
+struct diskCacheIndex {
+    uint32_t magic;                             /*!< DISK_CACHE_MAGIC */
+    uint32_t slots;                             /*!< DISK_CACHE_SLOTS */
+    uint32_t entrySize;                         /*!< sizeof(struct diskCacheEntry) */
+    uint32_t reserved;                          /*!< keeps the entries aligned */
+    struct diskCacheEntry entries[];            /*!< the hash table */
+};
+
+/**
+ * @brief An opened cache directory.
+ */
+struct diskCache {
+    char *dir;                                  /*!< the cache directory */
+    int fd;                                     /*!< the index file, locked with flock() while in use */
+    struct diskCacheIndex *index;               /*!< the mapped index */
+    size_t mapLen;                              /*!< bytes mapped */
+};
+
+int diskCacheOpen(struct diskCache *c, const char *dir);
+void diskCacheClose(struct diskCache *c);
+int diskCacheLookup(struct diskCache *c, const char *key, struct diskCacheEntry *entry, int *body);
+int diskCacheFresh(const struct diskCacheEntry *entry);
+int diskCacheStorable(const struct response *r);
+int diskCacheBegin(struct diskCache *c, char **tmpPath);
+int diskCacheStore(struct diskCache *c, const char *key, const char *tmpPath, const struct response *r);
+void diskCacheRefresh(struct diskCache *c, int slot, const char *key, const struct response *r);
+int diskCacheCopy(int body, int out);
+
+#endif
@@ -0,0 +1,354 @@
+/**
+ * @file filecache.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Cache of compressed file representations.
+ *
+ * Entries are found through a small hash table and evicted in least recently used order
+ * once CACHE_BUDGET is exceeded. An entry is only freed when nobody sends it anymore.
+ * A miss inserts a pending entry before the compression job is queued, so other requests for the
+ * same version neither wait nor compress it a second time.
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <brotli/encode.h>
+#include "filecache.h"
+#include "handler.h"
+
+#define CACHE_BUCKETS 256                       /*!< number of hash buckets */
+#define GZIP_LEVEL 6                            /*!< zlib compression level */
+#define BROTLI_QUALITY 5                        /*!< brotli quality, good ratio at gzip like speed */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;    /*!< guards all fields below and the refs of all entries */
+static struct cachedBody *buckets[CACHE_BUCKETS];          /*!< hash table */
+static struct cachedBody *lruHead = NULL;                   /*!< most recently used entry */
+static struct cachedBody *lruTail = NULL;                   /*!< least recently used entry */
+static size_t cachedBytes = 0;                              /*!< compressed bytes held by the cache */
+
+/**
+ * @brief Name of a content coding as used in HTTP headers.
+ * @param encoding one of the ENC_ constants.
+ * @return the token or NULL for ENC_IDENTITY.
+ */
+const char *encodingName(int encoding) {
+    switch (encoding) {
+        case ENC_GZIP:
+            return "gzip";
+        case ENC_BR:
+            return "br";
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief File name suffix of a pre-compressed sibling file.
+ * @param encoding one of the ENC_ constants.
+ * @return the suffix including the dot or NULL for ENC_IDENTITY.
+ */
+const char *encodingSuffix(int encoding) {
+    switch (encoding) {
+        case ENC_GZIP:
+            return ".gz";
+        case ENC_BR:
+            return ".br";
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief FNV-1a hash of a path and an encoding.
+ */
+static unsigned int hashKey(const char *path, int encoding) {
+    unsigned int h = 2166136261u ^ (unsigned int)encoding;
+    while (*path) {
+        h ^= (unsigned char)*path++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Drops one reference, the caller must hold the lock.
+ */
+static void releaseLocked(struct cachedBody *body) {
+    if (--body->refs > 0)
+        return;
+    free(body->data);
+    free(body->path);
+    free(body);
+}
+
+/**
+ * @brief Removes an entry from hash table and LRU list, the caller must hold the lock.
+ */
+static void unlinkLocked(struct cachedBody *body) {
+    struct cachedBody **pp = &buckets[body->hash % CACHE_BUCKETS];
+    while (*pp != body)
+        pp = &(*pp)->hnext;
+    *pp = body->hnext;
+
+    if (body->prev != NULL)
+        body->prev->next = body->next;
+    else
+        lruHead = body->next;
+    if (body->next != NULL)
+        body->next->prev = body->prev;
+    else
+        lruTail = body->prev;
+
+    cachedBytes -= body->len;
+    releaseLocked(body);
+}
+
+/**
+ * @brief Checks if an entry is still in the cache, the caller must hold the lock.
+ */
+static int linkedLocked(const struct cachedBody *body) {
+    const struct cachedBody *other = buckets[body->hash % CACHE_BUCKETS];
+    while (other != NULL && other != body)
+        other = other->hnext;
+    return other != NULL;
+}
+
+/**
+ * @brief Moves an entry to the front of the LRU list, the caller must hold the lock.
+ */
+static void touchLocked(struct cachedBody *body) {
+    if (lruHead == body)
+        return;
+    body->prev->next = body->next;
+    if (body->next != NULL)
+        body->next->prev = body->prev;
+    else
+        lruTail = body->prev;
+    body->prev = NULL;
+    body->next = lruHead;
+    lruHead->prev = body;
+    lruHead = body;
+}
+
+/**
+ * @brief Compresses a buffer into the gzip format.
+ * @return 0 on success, -1 on error. On success *out has to be freed by the caller.
+ */
+static int compressGzip(const unsigned char *in, size_t inLen, unsigned char **out, size_t *outLen) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    size_t bound = deflateBound(&zs, inLen);
+    unsigned char *buf = malloc(bound);
+    if (buf == NULL) {
+        deflateEnd(&zs);
+        return -1;
+    }
+    zs.next_in = (unsigned char *)in;
+    zs.avail_in = inLen;
+    zs.next_out = buf;
+    zs.avail_out = bound;
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&zs);
+        free(buf);
+        return -1;
+    }
+    *outLen = zs.total_out;
+    *out = buf;
+    deflateEnd(&zs);
+    return 0;
+}
+
+/**
+ * @brief Compresses a buffer into the brotli format.
+ * @return 0 on success, -1 on error. On success *out has to be freed by the caller.
+ */
+static int compressBrotli(const unsigned char *in, size_t inLen, unsigned char **out, size_t *outLen) {
+    size_t bound = BrotliEncoderMaxCompressedSize(inLen);
+    if (bound == 0)
+        return -1;
+    unsigned char *buf = malloc(bound);
+    if (buf == NULL)
+        return -1;
+    *outLen = bound;
+    if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, inLen, in, outLen, buf)) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    return 0;
+}
+
+/**
+ * @brief Checks if a cache entry still describes the given file version.
+ */
+static int sameVersion(const struct cachedBody *body, const struct stat *st) {
+    return body->dev == st->st_dev && body->ino == st->st_ino && body->size == st->st_size &&
+           body->mtime.tv_sec == st->st_mtim.tv_sec && body->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Reads the file of an entry and compresses it.
+ * @details The file is read with pread() instead of being mapped, so a file truncated meanwhile only makes the
+ * read come up short instead of raising SIGBUS. A file that changed since the entry was made is not compressed.
+ * @param body the entry.
+ * @param out receives the compressed bytes, to be freed by the caller.
+ * @param outLen receives the number of compressed bytes.
+ * @return 0 on success, -1 on error.
+ */
+static int compressFile(const struct cachedBody *body, unsigned char **out, size_t *outLen) {
+    int fd = open(body->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    unsigned char *src = NULL;
+    int ret = -1;
+    if (fstat(fd, &st) == 0 && sameVersion(body, &st) && (src = malloc(body->size > 0 ? body->size : 1)) != NULL) {
+        off_t done = 0;
+        while (done < body->size) {
+            ssize_t n = pread(fd, src + done, body->size - done, done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        if (done == body->size)
+            ret = (body->encoding == ENC_BR) ? compressBrotli(src, done, out, outLen) : compressGzip(src, done, out, outLen);
+    }
+    free(src);
+    close(fd);
+    return ret;
+}
+
+/**
+ * @brief Background job compressing a pending entry.
+ * @details The result is only published if the entry is still in the cache, a failed entry is removed so a
+ * later request tries again.
+ * @param arg the entry, the job holds a reference on it.
+ * @param run 0 if the pool stopped before the job ran.
+ * @return void
+ */
+static void compressJob(void *arg, int run) {
+    struct cachedBody *body = arg;
+    unsigned char *data = NULL;
+    size_t len = 0;
+    int ret = run ? compressFile(body, &data, &len) : -1;
+
+    pthread_mutex_lock(&lock);
+    if (linkedLocked(body) && ret == 0) {
+        body->data = data;
+        body->len = len;
+        body->ready = 1;
+        cachedBytes += len;
+        while (cachedBytes > CACHE_BUDGET && lruTail != body)
+            unlinkLocked(lruTail);
+    } else {
+        if (linkedLocked(body))
+            unlinkLocked(body);
+        free(data);
+    }
+    releaseLocked(body);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Returns the compressed representation of a file if it is ready.
+ * @details Never compresses on the calling thread: on a miss a pending entry is made and a background job of
+ * the handler pool compresses the file, until then NULL is returned and the file is sent as is. Outdated
+ * entries of the same path are replaced. The returned entry stays valid until cacheRelease() is called, even
+ * if it gets evicted meanwhile.
+ * @param path path of the source file, used as cache key and opened again by the job.
+ * @param st stat result of the source file.
+ * @param encoding ENC_GZIP or ENC_BR.
+ * @return the entry or NULL if it is not ready, the file is too large or could not be compressed.
+ */
+struct cachedBody *cacheGetCompressed(const char *path, const struct stat *st, int encoding) {
+    unsigned int hash = hashKey(path, encoding);
+    struct cachedBody *body;
+
+    if (st->st_size > CACHE_MAX_SOURCE)
+        return NULL;
+
+    pthread_mutex_lock(&lock);
+    for (body = buckets[hash % CACHE_BUCKETS]; body != NULL; body = body->hnext) {
+        if (body->hash == hash && body->encoding == encoding && strcmp(body->path, path) == 0)
+            break;
+    }
+    if (body != NULL) {
+        if (sameVersion(body, st)) {
+            if (!body->ready) {
+                pthread_mutex_unlock(&lock);
+                return NULL;
+            }
+            touchLocked(body);
+            body->refs++;
+            pthread_mutex_unlock(&lock);
+            return body;
+        }
+        unlinkLocked(body);
+    }
+
+    body = calloc(1, sizeof(*body));
+    if (body == NULL || (body->path = strdup(path)) == NULL) {
+        pthread_mutex_unlock(&lock);
+        free(body);
+        return NULL;
+    }
+    body->encoding = encoding;
+    body->dev = st->st_dev;
+    body->ino = st->st_ino;
+    body->size = st->st_size;
+    body->mtime = st->st_mtim;
+    body->hash = hash;
+    body->refs = 2; // cache and job
+    body->hnext = buckets[hash % CACHE_BUCKETS];
+    buckets[hash % CACHE_BUCKETS] = body;
+    body->next = lruHead;
+    if (lruHead != NULL)
+        lruHead->prev = body;
+    lruHead = body;
+    if (lruTail == NULL)
+        lruTail = body;
+    pthread_mutex_unlock(&lock);
+
+    if (handlerSubmitBackground(compressJob, body) < 0) { // pool busy, a later request tries again
+        pthread_mutex_lock(&lock);
+        if (linkedLocked(body))
+            unlinkLocked(body);
+        releaseLocked(body);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns an entry obtained by cacheGetCompressed().
+ * @param body the entry, NULL is ignored.
+ * @return void
+ */
+void cacheRelease(struct cachedBody *body) {
+    if (body == NULL)
+        return;
+    pthread_mutex_lock(&lock);
+    releaseLocked(body);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Frees all cached entries.
+ * @return void
+ */
+void cacheDestroy(void) {
+    pthread_mutex_lock(&lock);
+    while (lruTail != NULL)
+        unlinkLocked(lruTail);
+    pthread_mutex_unlock(&lock);
+}
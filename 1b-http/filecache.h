@@ -0,0 +1,52 @@
+/**
+ * @file filecache.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Cache of compressed file representations.
+ *
+ * Text files are compressed once per version (inode, size, mtime) and kept in memory,
+ * so repeated requests do not pay for the compression again. Compression runs as a background job
+ * of the handler pool, the event loops send the file as is until the compressed body is ready.
+ **/
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define ENC_IDENTITY 0                          /*!< no content coding */
+#define ENC_GZIP 1                              /*!< gzip content coding */
+#define ENC_BR 2                                /*!< brotli content coding */
+
+#define CACHE_BUDGET (64 * 1024 * 1024)         /*!< maximum bytes of compressed data kept in memory */
+#define CACHE_MAX_SOURCE (8 * 1024 * 1024)      /*!< larger files are never compressed on the fly */
+
+/**
+ * @brief A compressed representation of a file.
+ */
+struct cachedBody {
+    char *path;                                 /*!< path of the source file */
+    int encoding;                               /*!< ENC_GZIP or ENC_BR */
+    dev_t dev;                                  /*!< device of the source file */
+    ino_t ino;                                  /*!< inode of the source file */
+    off_t size;                                 /*!< size of the source file */
+    struct timespec mtime;                      /*!< modification time of the source file */
+    int ready;                                  /*!< data holds the compressed bytes, otherwise compression is pending */
+    unsigned char *data;                        /*!< compressed bytes */
+    size_t len;                                 /*!< number of compressed bytes */
+    int refs;                                   /*!< users of this entry, the cache itself holds one */
+    unsigned int hash;                          /*!< hash of path and encoding */
+    struct cachedBody *hnext;                   /*!< next entry in the same hash bucket */
+    struct cachedBody *prev;                    /*!< more recently used entry */
+    struct cachedBody *next;                    /*!< less recently used entry */
+};
+
+const char *encodingName(int encoding);
+const char *encodingSuffix(int encoding);
+struct cachedBody *cacheGetCompressed(const char *path, const struct stat *st, int encoding);
+void cacheRelease(struct cachedBody *body);
+void cacheDestroy(void);
+
+#endif
@@ -0,0 +1,300 @@
+/**
+ * @file handler.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Dynamic request handlers running on a thread pool.
+ *
+ * The pool shares one bounded FIFO of pending jobs. Each finished job goes to the completion
+ * queue of the worker that submitted it, so a connection is only ever touched by its own worker.
+ * A background job has no worker waiting for it and is freed by the thread that ran it.
+ **/
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "handler.h"
+
+static struct handler handlers[MAX_HANDLERS];               /*!< registered handlers */
+static int handlerCount = 0;                                /*!< entries in handlers */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;    /*!< guards the fields below */
+static pthread_cond_t pending = PTHREAD_COND_INITIALIZER;   /*!< signalled when a job is queued or the pool stops */
+static struct handlerJob *queueHead = NULL;                 /*!< oldest pending job */
+static struct handlerJob *queueTail = NULL;                 /*!< newest pending job */
+static int queued = 0;                                      /*!< number of pending jobs */
+static int stopping = 0;                                    /*!< set to stop the pool */
+static pthread_t *threads = NULL;                           /*!< the pool */
+static int threadCount = 0;                                 /*!< number of threads */
+
+/**
+ * @brief Registers a handler, has to happen before the workers start.
+ * @param prefix request targets starting with prefix at a path boundary are handled.
+ * @param run the handler function.
+ * @return 0 on success, -1 if the registry is full.
+ */
+int handlerRegister(const char *prefix, handlerFunc run) {
+    if (handlerCount == MAX_HANDLERS)
+        return -1;
+    handlers[handlerCount].prefix = prefix;
+    handlers[handlerCount].run = run;
+    handlerCount++;
+    return 0;
+}
+
+/**
+ * @brief Finds the handler with the longest prefix matching a request target.
+ * @details "/api" matches "/api", "/api/x" and "/api?x" but not "/apis".
+ * @param url the request target.
+ * @return the handler or NULL if the target maps to a file.
+ */
+const struct handler *handlerLookup(const char *url) {
+    const struct handler *best = NULL;
+    size_t bestLen = 0;
+    for (int i = 0; i < handlerCount; i++) {
+        size_t len = strlen(handlers[i].prefix);
+        if (len <= bestLen || strncmp(url, handlers[i].prefix, len) != 0)
+            continue;
+        char next = url[len];
+        if (handlers[i].prefix[len-1] == '/' || next == '\0' || next == '/' || next == '?') {
+            best = &handlers[i];
+            bestLen = len;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Hands a finished job to its worker.
+ */
+static void complete(struct handlerJob *job) {
+    struct completionQueue *q = job->owner;
+    job->next = NULL;
+    pthread_mutex_lock(&q->lock);
+    if (q->tail != NULL)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+    pthread_mutex_unlock(&q->lock);
+
+    uint64_t one = 1;
+    while (write(q->fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+/**
+ * @brief Body of a pool thread.
+ */
+static void *poolMain(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (queueHead == NULL && !stopping)
+            pthread_cond_wait(&pending, &lock);
+        if (stopping)
+            break;
+        struct handlerJob *job = queueHead;
+        queueHead = job->next;
+        if (queueHead == NULL)
+            queueTail = NULL;
+        queued--;
+        pthread_mutex_unlock(&lock);
+
+        if (job->handler == NULL) {
+            job->background(job->arg, 1);
+            free(job);
+        } else {
+            job->result.status = 500;
+            job->result.contentType = "text/plain; charset=utf-8";
+            job->handler->run(&job->call, &job->result);
+            complete(job);
+        }
+
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts the pool threads.
+ * @param count number of threads.
+ * @return 0 on success, -1 on error.
+ */
+int handlerPoolStart(int count) {
+    threads = calloc(count, sizeof(pthread_t));
+    if (threads == NULL)
+        return -1;
+    for (; threadCount < count; threadCount++) {
+        if (pthread_create(&threads[threadCount], NULL, poolMain, NULL) != 0) {
+            handlerPoolStop();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the pool. Jobs still waiting for a thread are dropped.
+ * @details Running handlers are waited for, they still complete into the queues of their workers.
+ * @param void
+ * @return void
+ */
+void handlerPoolStop(void) {
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_broadcast(&pending);
+    pthread_mutex_unlock(&lock);
+    for (int i = 0; i < threadCount; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    threads = NULL;
+    threadCount = 0;
+
+    while (queueHead != NULL) {
+        struct handlerJob *job = queueHead;
+        queueHead = job->next;
+        if (job->handler == NULL)
+            job->background(job->arg, 0);
+        handlerJobFree(job);
+    }
+    queueTail = NULL;
+    queued = 0;
+}
+
+/**
+ * @brief Appends a job to the pending ones.
+ * @param job the job.
+ * @return 0 on success, -1 if the queue is full or the pool is not running.
+ */
+static int enqueue(struct handlerJob *job) {
+    pthread_mutex_lock(&lock);
+    if (queued >= HANDLER_QUEUE || threadCount == 0) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    if (queueTail != NULL)
+        queueTail->next = job;
+    else
+        queueHead = job;
+    queueTail = job;
+    queued++;
+    pthread_cond_signal(&pending);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+/**
+ * @brief Queues a request for a pool thread.
+ * @param h the handler returned by handlerLookup().
+ * @param url the request target, copied.
+ * @param loopback the client connected from the local host.
+ * @param owner completion queue of the calling worker.
+ * @return the job, NULL if the queue is full or memory ran out.
+ */
+struct handlerJob *handlerSubmit(const struct handler *h, const char *url, int loopback, struct completionQueue *owner) {
+    size_t urlLen = strlen(url);
+    struct handlerJob *job = calloc(1, sizeof(struct handlerJob) + urlLen + 1);
+    if (job == NULL)
+        return NULL;
+    memcpy(job->url, url, urlLen + 1);
+    char *query = strchr(job->url, '?');
+    job->handler = h;
+    job->call.url = job->url;
+    job->call.query = (query != NULL) ? query + 1 : "";
+    job->call.loopback = loopback;
+    job->owner = owner;
+
+    if (enqueue(job) < 0) {
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+/**
+ * @brief Queues a background job for a pool thread.
+ * @details It counts against the same bound as requests, a full queue rejects it.
+ * @param fn called on a pool thread with run set, or with run 0 if the pool stops before.
+ * @param arg argument of fn.
+ * @return 0 on success, -1 if the queue is full or memory ran out, fn is not called then.
+ */
+int handlerSubmitBackground(backgroundFunc fn, void *arg) {
+    struct handlerJob *job = calloc(1, sizeof(struct handlerJob));
+    if (job == NULL)
+        return -1;
+    job->background = fn;
+    job->arg = arg;
+
+    if (enqueue(job) < 0) {
+        free(job);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees a job and its response body.
+ * @param job the job, NULL is ignored.
+ * @return void
+ */
+void handlerJobFree(struct handlerJob *job) {
+    if (job == NULL)
+        return;
+    free(job->result.body);
+    free(job);
+}
+
+/**
+ * @brief Sets up an empty completion queue.
+ * @param q the queue.
+ * @return 0 on success, -1 on error.
+ */
+int completionInit(struct completionQueue *q) {
+    pthread_mutex_init(&q->lock, NULL);
+    q->head = NULL;
+    q->tail = NULL;
+    q->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return (q->fd < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Takes all finished jobs out of a queue and resets its eventfd.
+ * @param q the queue.
+ * @return the finished jobs linked through next, oldest first.
+ */
+struct handlerJob *completionTake(struct completionQueue *q) {
+    uint64_t count;
+    if (read(q->fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return NULL;
+    pthread_mutex_lock(&q->lock);
+    struct handlerJob *jobs = q->head;
+    q->head = NULL;
+    q->tail = NULL;
+    pthread_mutex_unlock(&q->lock);
+    return jobs;
+}
+
+/**
+ * @brief Frees a queue and the jobs nobody took.
+ * @details The pool has to be stopped already.
+ * @param q the queue.
+ * @return void
+ */
+void completionDestroy(struct completionQueue *q) {
+    if (q->fd < 0)
+        return;
+    while (q->head != NULL) {
+        struct handlerJob *job = q->head;
+        q->head = job->next;
+        handlerJobFree(job);
+    }
+    q->tail = NULL;
+    close(q->fd);
+    q->fd = -1;
+    pthread_mutex_destroy(&q->lock);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file handler.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Dynamic request handlers running on a thread pool.
+ *
+ * Handlers are registered by path prefix before the server starts. A worker submits a matching
+ * request as a job and goes on serving other connections; a pool thread runs the handler and
+ * puts the finished job into the completion queue of the submitting worker, whose eventfd wakes
+ * its event loop. The job queue is bounded, when it is full the request is rejected right away.
+ * Background jobs, e.g. compressing a file for the cache, share the pool but complete into no queue.
+ **/
+#ifndef HANDLER_H
+#define HANDLER_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define MAX_HANDLERS 32                         /*!< registered prefixes */
+#define HANDLER_THREADS 4                       /*!< default size of the pool */
+#define HANDLER_QUEUE 256                       /*!< jobs waiting for a pool thread, more are rejected */
+
+/**
+ * @brief What a handler gets to see of a request.
+ */
+struct handlerCall {
+    const char *url;                            /*!< request target including the query */
+    const char *query;                          /*!< text after '?', empty if there is none */
+    int loopback;                               /*!< the client connected from the local host */
+};
+
+/**
+ * @brief The response filled in by a handler.
+ */
+struct handlerResult {
+    int status;                                 /*!< HTTP status code */
+    const char *contentType;                    /*!< media type of the body, a static string */
+    char *body;                                 /*!< malloc'ed body, freed by the server */
+    size_t len;                                 /*!< number of bytes of body */
+};
+
+typedef void (*handlerFunc)(const struct handlerCall *call, struct handlerResult *res);
+typedef void (*backgroundFunc)(void *arg, int run); /*!< run is 0 if the pool stopped first, arg has to be released then */
+
+/**
+ * @brief A registered handler.
+ */
+struct handler {
+    const char *prefix;                         /*!< request targets starting with this are handled */
+    handlerFunc run;                            /*!< called on a pool thread */
+};
+
+/**
+ * @brief Finished jobs of one worker.
+ */
+struct completionQueue {
+    pthread_mutex_t lock;                       /*!< guards head and tail */
+    struct handlerJob *head;                    /*!< oldest finished job */
+    struct handlerJob *tail;                    /*!< newest finished job */
+    int fd;                                     /*!< eventfd signalled for every finished job */
+};
+
+/**
+ * @brief A request handed to the pool.
+ */
+struct handlerJob {
+    struct handlerJob *next;                    /*!< next job in the same queue */
+    const struct handler *handler;              /*!< the handler to run, NULL for a background job */
+    backgroundFunc background;                  /*!< the function of a background job */
+    void *arg;                                  /*!< argument of background */
+    struct handlerCall call;                    /*!< its input */
+    struct handlerResult result;                /*!< its output */
+    struct completionQueue *owner;              /*!< queue of the submitting worker */
+    void *conn;                                 /*!< waiting connection, NULL once it is gone, only used by the owner */
+    char url[];                                 /*!< storage of call.url */
+};
+
+int handlerRegister(const char *prefix, handlerFunc run);
+const struct handler *handlerLookup(const char *url);
+int handlerPoolStart(int threads);
+void handlerPoolStop(void);
+struct handlerJob *handlerSubmit(const struct handler *h, const char *url, int loopback, struct completionQueue *owner);
+int handlerSubmitBackground(backgroundFunc fn, void *arg);
+void handlerJobFree(struct handlerJob *job);
+int completionInit(struct completionQueue *q);
+struct handlerJob *completionTake(struct completionQueue *q);
+void completionDestroy(struct completionQueue *q);
+
+#endif
@@ -0,0 +1,915 @@
+/**
+ * @file loadgen.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief HTTP load generator and latency benchmark.
+ *
+ * Several threads each drive a share of the connections from their own epoll loop. In closed-loop mode
+ * every connection sends its next request as soon as the previous response is complete. In open-loop mode
+ * requests are scheduled at a fixed rate and latency is measured from the scheduled time, so a stalling
+ * server is not hidden by the generator waiting for it (coordinated omission).
+ * Latencies are recorded in log-linear histograms with about 1.5% precision.
+ * Stalled connections, which send the start of a request header and then nothing, check that such clients
+ * neither slow down the others nor stay open past the header timeout of the server.
+ **/
+#include <errno.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HIST_SUB_BITS 7                                  /*!< values below 2^HIST_SUB_BITS are recorded exactly */
+#define HIST_SUB (1 << HIST_SUB_BITS)                    /*!< exact buckets */
+#define HIST_HALF (HIST_SUB / 2)                         /*!< buckets per power of two above the exact range */
+#define HIST_BUCKETS (HIST_SUB + 48 * HIST_HALF)         /*!< covers up to 2^54 ns */
+#define MAX_PATHS 32                                     /*!< entries of the file mix */
+#define RESP_BUF 16384                                   /*!< receive buffer per connection */
+#define MAX_EVENTS 256                                   /*!< events fetched per epoll_wait() */
+
+#define LG_CONNECTING 0                                  /*!< non-blocking connect in progress */
+#define LG_IDLE 1                                        /*!< waiting for the next scheduled request */
+#define LG_SENDING 2                                     /*!< request partially sent */
+#define LG_HEADER 3                                      /*!< reading the response header */
+#define LG_BODY 4                                        /*!< reading the response body */
+
+#define CH_SIZE 0                                        /*!< reading a chunk size line */
+#define CH_DATA 1                                        /*!< reading chunk data */
+#define CH_DATA_END 2                                    /*!< reading the line break after chunk data */
+#define CH_TRAILER 3                                     /*!< reading trailer lines up to the empty line */
+
+/**
+ * @brief Log-linear latency histogram in nanoseconds.
+ */
+struct histogram {
+    uint64_t counts[HIST_BUCKETS];                       /*!< samples per bucket */
+    uint64_t total;                                      /*!< number of samples */
+    uint64_t max;                                        /*!< largest sample */
+};
+
+/**
+ * @brief One entry of the file mix.
+ */
+struct mixEntry {
+    char *path;                                          /*!< request target */
+    int weight;                                          /*!< relative frequency */
+    char *req[2];                                        /*!< request text without / with keep-alive */
+    size_t reqLen[2];                                    /*!< length of req */
+};
+
+/**
+ * @brief State of one benchmark connection.
+ */
+struct lgConn {
+    int fd;                                              /*!< socket, -1 if not connected */
+    int state;                                           /*!< one of the LG_ constants */
+    uint64_t due;                                        /*!< ns at which the next request is scheduled */
+    uint64_t start;                                      /*!< ns from which the latency of the current request counts */
+    const struct mixEntry *entry;                        /*!< file of the current request */
+    size_t sent;                                         /*!< bytes of the request sent */
+    char buf[RESP_BUF];                                  /*!< received header bytes */
+    size_t bufLen;                                       /*!< bytes in buf */
+    long long bodyLeft;                                  /*!< body bytes still expected, -1 until EOF */
+    int chunked;                                         /*!< body uses the chunked transfer coding */
+    int chunkState;                                      /*!< one of the CH_ constants */
+    int chunkExt;                                        /*!< skipping a chunk extension */
+    long long chunkLeft;                                 /*!< size of the current chunk or bytes left of it */
+    int lineLen;                                         /*!< bytes of the current trailer line */
+    int keepAlive;                                       /*!< server keeps the connection */
+    int status;                                          /*!< status code of the current response */
+};
+
+/**
+ * @brief A load generating thread.
+ */
+struct lgThread {
+    pthread_t thread;                                    /*!< the thread */
+    int epfd;                                            /*!< epoll instance */
+    struct lgConn *conns;                                /*!< connections of this thread */
+    int connCount;                                       /*!< number of connections */
+    unsigned int seed;                                   /*!< state of the mix selection */
+    struct histogram hist;                               /*!< latencies of this thread */
+    uint64_t requests;                                   /*!< completed requests */
+    uint64_t bytes;                                      /*!< received bytes */
+    uint64_t errors;                                     /*!< failed connections or requests */
+    uint64_t non2xx;                                     /*!< responses with a status outside 200-299 */
+};
+
+static char *name = NULL;                                /*!< program name */
+static char *host = NULL;                                /*!< server host */
+static char *port = "8080";                              /*!< server port */
+static int connCount = 32;                               /*!< total connections */
+static int threadCount = 2;                              /*!< generator threads */
+static int duration = 10;                                /*!< seconds of measurement */
+static int warmup = 1;                                   /*!< seconds before measuring */
+static double rate = 0;                                  /*!< requests per second, 0 for closed loop */
+static int keepAlive = 0;                                /*!< reuse connections */
+static char *baselinePath = NULL;                        /*!< baseline to compare with */
+static char *savePath = NULL;                            /*!< where to store the results as new baseline */
+static double threshold = 10;                            /*!< tolerated regression in percent */
+static int stallCount = 0;                               /*!< connections that send a partial header and stop */
+static double maxP99 = 0;                                /*!< p99 latency in ms that fails the run, 0 for none */
+static struct mixEntry mix[MAX_PATHS];                   /*!< the file mix */
+static int mixCount = 0;                                 /*!< entries in mix */
+static int mixWeight = 0;                                /*!< sum of all weights */
+static struct addrinfo *server = NULL;                   /*!< resolved server address */
+static uint64_t measureFrom = 0;                         /*!< ns after which samples count */
+static uint64_t measureUntil = 0;                        /*!< ns at which the run ends */
+
+/**
+ * Mandatory usage function.
+ * @brief This function writes helpful usage information about the program to stderr.
+ * @param void
+ * @return void
+ */
+void usage(void) {
+    fprintf(stderr, "SYNOPSIS\n\tloadgen [-p PORT] [-c CONNECTIONS] [-t THREADS] [-d SECONDS] [-w WARMUP] [-r RATE] [-k]\n"
+                    "\t        [-m PATH:WEIGHT,...] [-b BASELINE] [-s SAVE] [-T PERCENT] [-S STALLED] [-P P99_MS] HOST\n"
+                    "EXAMPLE\n\tloadgen -p 8080 -c 64 -t 4 -d 10 -k -m /small.bin:8,/large.bin:1 127.0.0.1\n"
+                    "\tloadgen -p 8080 -c 16 -d 5 -k -S 1000 -P 50 127.0.0.1\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Current monotonic time in nanoseconds.
+ */
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Histogram bucket of a value.
+ */
+int histIndex(uint64_t v) {
+    if (v < HIST_SUB)
+        return v;
+    int shift = 63 - __builtin_clzll(v) - (HIST_SUB_BITS - 1);
+    int idx = HIST_SUB + (shift - 1) * HIST_HALF + (int)((v >> shift) - HIST_HALF);
+    return (idx < HIST_BUCKETS) ? idx : HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief Largest value that falls into a bucket.
+ */
+uint64_t histValue(int idx) {
+    if (idx < HIST_SUB)
+        return idx;
+    int shift = (idx - HIST_SUB) / HIST_HALF + 1;
+    uint64_t m = (idx - HIST_SUB) % HIST_HALF + HIST_HALF;
+    return ((m + 1) << shift) - 1;
+}
+
+/**
+ * @brief Records a sample.
+ */
+void histRecord(struct histogram *h, uint64_t v) {
+    h->counts[histIndex(v)]++;
+    h->total++;
+    if (v > h->max)
+        h->max = v;
+}
+
+/**
+ * @brief Value below which the given fraction of all samples lies.
+ */
+uint64_t histPercentile(const struct histogram *h, double p) {
+    if (h->total == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * h->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank)
+            return (histValue(i) < h->max) ? histValue(i) : h->max;
+    }
+    return h->max;
+}
+
+/**
+ * @brief Parses the file mix "PATH:WEIGHT,PATH:WEIGHT".
+ * @return 0 on success, -1 if malformed.
+ */
+int parseMix(char *arg) {
+    char *save = NULL;
+    for (char *item = strtok_r(arg, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        if (mixCount == MAX_PATHS || item[0] != '/')
+            return -1;
+        int weight = 1;
+        char *colon = strrchr(item, ':');
+        if (colon != NULL) {
+            char *end;
+            *colon = '\0';
+            weight = strtol(colon + 1, &end, 10);
+            if (*end != '\0' || weight < 1)
+                return -1;
+        }
+        mix[mixCount].path = item;
+        mix[mixCount].weight = weight;
+        mixWeight += weight;
+        mixCount++;
+    }
+    return (mixCount > 0) ? 0 : -1;
+}
+
+/**
+ * @brief Reads in all arguments and parses them.
+ * @param argc Number of arguments..
+ * @param argv Argument Vector.
+ * @return void
+ */
+void readArgs(int argc, char **argv) {
+    int opt;
+    char *end;
+    while ((opt = getopt(argc, argv, "p:c:t:d:w:r:km:b:s:T:S:P:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = optarg;
+                break;
+            case 'c':
+                connCount = strtol(optarg, &end, 10);
+                if (*end != '\0' || connCount < 1)
+                    usage();
+                break;
+            case 't':
+                threadCount = strtol(optarg, &end, 10);
+                if (*end != '\0' || threadCount < 1)
+                    usage();
+                break;
+            case 'd':
+                duration = strtol(optarg, &end, 10);
+                if (*end != '\0' || duration < 1)
+                    usage();
+                break;
+            case 'w':
+                warmup = strtol(optarg, &end, 10);
+                if (*end != '\0' || warmup < 0)
+                    usage();
+                break;
+            case 'r':
+                rate = strtod(optarg, &end);
+                if (*end != '\0' || rate < 0)
+                    usage();
+                break;
+            case 'k':
+                keepAlive = 1;
+                break;
+            case 'm':
+                if (parseMix(optarg) < 0) {
+                    fprintf(stderr, "%s: invalid file mix!\n", name);
+                    usage();
+                }
+                break;
+            case 'b':
+                baselinePath = optarg;
+                break;
+            case 's':
+                savePath = optarg;
+                break;
+            case 'T':
+                threshold = strtod(optarg, &end);
+                if (*end != '\0' || threshold < 0)
+                    usage();
+                break;
+            case 'S':
+                stallCount = strtol(optarg, &end, 10);
+                if (*end != '\0' || stallCount < 0)
+                    usage();
+                break;
+            case 'P':
+                maxP99 = strtod(optarg, &end);
+                if (*end != '\0' || maxP99 < 0)
+                    usage();
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1)
+        usage();
+    host = argv[optind];
+    if (mixCount == 0) {
+        static char defaultPath[] = "/";
+        mix[0].path = defaultPath;
+        mix[0].weight = 1;
+        mixWeight = 1;
+        mixCount = 1;
+    }
+    if (threadCount > connCount)
+        threadCount = connCount;
+}
+
+/**
+ * @brief Builds the request texts of all mix entries.
+ * @return void
+ */
+void buildRequests(void) {
+    for (int i = 0; i < mixCount; i++) {
+        for (int k = 0; k < 2; k++) {
+            const char *con = k ? "" : "Connection: close\r\n";
+            int len = snprintf(NULL, 0, "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n", mix[i].path, host, con);
+            mix[i].req[k] = malloc(len + 1);
+            if (mix[i].req[k] == NULL) {
+                fprintf(stderr, "%s: Memory error!\n", name);
+                exit(EXIT_FAILURE);
+            }
+            snprintf(mix[i].req[k], len + 1, "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n", mix[i].path, host, con);
+            mix[i].reqLen[k] = len;
+        }
+    }
+}
+
+/**
+ * @brief Picks the file of the next request according to the weights.
+ */
+const struct mixEntry *pickEntry(struct lgThread *t) {
+    int r = rand_r(&t->seed) % mixWeight;
+    for (int i = 0; i < mixCount; i++) {
+        if (r < mix[i].weight)
+            return &mix[i];
+        r -= mix[i].weight;
+    }
+    return &mix[0];
+}
+
+/**
+ * @brief Opens a non-blocking connection to the server.
+ * @return 0 on success, -1 on error.
+ */
+int openConn(struct lgThread *t, struct lgConn *c) {
+    c->fd = socket(server->ai_family, server->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, server->ai_protocol);
+    if (c->fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c->fd, server->ai_addr, server->ai_addrlen) < 0 && errno != EINPROGRESS) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    c->state = LG_CONNECTING;
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.ptr = c;
+    epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    return 0;
+}
+
+/**
+ * @brief Closes the socket of a connection.
+ */
+void closeConn(struct lgConn *c) {
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+}
+
+/**
+ * @brief Registers the events a connection waits for.
+ */
+void waitFor(struct lgThread *t, struct lgConn *c, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/**
+ * @brief Sends (the rest of) the current request.
+ * @return 0 if complete or pending, -1 on error.
+ */
+int sendRequest(struct lgThread *t, struct lgConn *c) {
+    const char *req = c->entry->req[keepAlive];
+    size_t len = c->entry->reqLen[keepAlive];
+    while (c->sent < len) {
+        ssize_t n = send(c->fd, req + c->sent, len - c->sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitFor(t, c, EPOLLOUT);
+                return 0;
+            }
+            return -1;
+        }
+        c->sent += n;
+    }
+    c->state = LG_HEADER;
+    c->bufLen = 0;
+    waitFor(t, c, EPOLLIN);
+    return 0;
+}
+
+/**
+ * @brief Starts the next request of a connection.
+ * @param start time from which the latency counts.
+ * @return 0 on success, -1 on error.
+ */
+int startRequest(struct lgThread *t, struct lgConn *c, uint64_t start) {
+    c->entry = pickEntry(t);
+    c->start = start;
+    c->sent = 0;
+    c->state = LG_SENDING;
+    return sendRequest(t, c);
+}
+
+/**
+ * @brief Parses the response header in c->buf.
+ * @return number of header bytes, 0 if incomplete, -1 if malformed.
+ */
+long parseHeader(struct lgConn *c) {
+    char *end = NULL;
+    for (size_t i = 3; i < c->bufLen; i++) {
+        if (c->buf[i] == '\n' && c->buf[i-1] == '\r' && c->buf[i-2] == '\n' && c->buf[i-3] == '\r') {
+            end = c->buf + i + 1;
+            break;
+        }
+    }
+    if (end == NULL)
+        return (c->bufLen == RESP_BUF) ? -1 : 0;
+
+    if (c->bufLen < 12 || strncmp(c->buf, "HTTP/1.", 7) != 0)
+        return -1;
+    c->status = atoi(c->buf + 9);
+    c->bodyLeft = -1;
+    c->chunked = 0;
+    c->keepAlive = keepAlive;
+    for (char *line = strstr(c->buf, "\r\n") + 2; line < end - 2; line = strstr(line, "\r\n") + 2) {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+            c->bodyLeft = strtoll(line + 15, NULL, 10);
+        else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked") != NULL)
+            c->chunked = 1;
+        else if (strncasecmp(line, "Connection:", 11) == 0 && strncasecmp(line + 11 + strspn(line + 11, " "), "close", 5) == 0)
+            c->keepAlive = 0;
+    }
+    if (c->status == 304 || c->status == 204)
+        c->bodyLeft = 0;
+    else if (c->chunked)
+        c->bodyLeft = -1;
+    c->chunkState = CH_SIZE;
+    c->chunkExt = 0;
+    c->chunkLeft = 0;
+    return end - c->buf;
+}
+
+/**
+ * @brief Follows the framing of a chunked body.
+ * @return 1 if the body is complete, 0 if more bytes are needed.
+ */
+int feedChunked(struct lgConn *c, const char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char ch = p[i];
+        switch (c->chunkState) {
+            case CH_SIZE:
+                if (ch == '\n') {
+                    c->chunkState = (c->chunkLeft > 0) ? CH_DATA : CH_TRAILER;
+                    c->chunkExt = 0;
+                    c->lineLen = 0;
+                } else if (ch == ';') {
+                    c->chunkExt = 1;
+                } else if (!c->chunkExt && ch >= '0' && ch <= '9') {
+                    c->chunkLeft = c->chunkLeft * 16 + (ch - '0');
+                } else if (!c->chunkExt && ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')) {
+                    c->chunkLeft = c->chunkLeft * 16 + ((ch | 0x20) - 'a' + 10);
+                }
+                break;
+            case CH_DATA: {
+                long long take = (long long)(len - i) < c->chunkLeft ? (long long)(len - i) : c->chunkLeft;
+                i += take - 1;
+                c->chunkLeft -= take;
+                if (c->chunkLeft == 0)
+                    c->chunkState = CH_DATA_END;
+                break;
+            }
+            case CH_DATA_END:
+                if (ch == '\n')
+                    c->chunkState = CH_SIZE;
+                break;
+            default:
+                if (ch == '\n') {
+                    if (c->lineLen == 0)
+                        return 1;
+                    c->lineLen = 0;
+                } else if (ch != '\r') {
+                    c->lineLen++;
+                }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Finishes the current request and schedules the next one.
+ * @return 0 on success, -1 if the connection has to be reopened.
+ */
+int completeRequest(struct lgThread *t, struct lgConn *c, uint64_t now) {
+    if (now >= measureFrom && now < measureUntil) {
+        histRecord(&t->hist, now - c->start);
+        t->requests++;
+        if (c->status < 200 || c->status > 299)
+            t->non2xx++;
+    }
+    if (rate > 0)
+        c->due += (uint64_t)(1e9 * connCount / rate);
+    else
+        c->due = now;
+
+    if (!c->keepAlive) {
+        closeConn(c);
+        c->state = LG_IDLE;
+        return 0;
+    }
+    c->state = LG_IDLE;
+    waitFor(t, c, 0);
+    return 0;
+}
+
+/**
+ * @brief Reads response bytes.
+ * @return 0 on success, -1 on error.
+ */
+int readResponse(struct lgThread *t, struct lgConn *c, uint64_t now) {
+    for (;;) {
+        if (c->state == LG_HEADER) {
+            ssize_t n = recv(c->fd, c->buf + c->bufLen, RESP_BUF - c->bufLen, 0);
+            if (n < 0)
+                return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+            if (n == 0)
+                return -1;
+            if (now >= measureFrom)
+                t->bytes += n;
+            c->bufLen += n;
+            long headerLen = parseHeader(c);
+            if (headerLen < 0)
+                return -1;
+            if (headerLen == 0)
+                continue;
+            long long extra = c->bufLen - headerLen;
+            c->state = LG_BODY;
+            if (c->chunked) {
+                if (feedChunked(c, c->buf + headerLen, extra))
+                    return completeRequest(t, c, nowNs());
+            } else if (c->bodyLeft >= 0) {
+                c->bodyLeft -= extra;
+                if (c->bodyLeft <= 0)
+                    return completeRequest(t, c, nowNs());
+            }
+        } else if (c->state == LG_BODY) {
+            char sink[65536];
+            size_t want = sizeof(sink);
+            if (c->bodyLeft >= 0 && (long long)want > c->bodyLeft)
+                want = c->bodyLeft;
+            ssize_t n = recv(c->fd, sink, want, 0);
+            if (n < 0)
+                return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+            if (n == 0) {
+                if (c->bodyLeft < 0) { // body delimited by the end of the connection
+                    c->keepAlive = 0;
+                    return completeRequest(t, c, nowNs());
+                }
+                return -1;
+            }
+            if (now >= measureFrom)
+                t->bytes += n;
+            if (c->chunked) {
+                if (feedChunked(c, sink, n))
+                    return completeRequest(t, c, nowNs());
+            } else if (c->bodyLeft >= 0) {
+                c->bodyLeft -= n;
+                if (c->bodyLeft == 0)
+                    return completeRequest(t, c, nowNs());
+            }
+        } else {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Starts the requests that are due.
+ * @return ms until the next request is due, -1 if none is waiting.
+ */
+int startDue(struct lgThread *t, uint64_t now) {
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < t->connCount; i++) {
+        struct lgConn *c = &t->conns[i];
+        if (c->state != LG_IDLE)
+            continue;
+        if (c->due > now) {
+            if (c->due < next)
+                next = c->due;
+            continue;
+        }
+        if (c->fd < 0) {
+            if (openConn(t, c) < 0) {
+                t->errors++;
+                c->due = now + 1000000;
+                continue;
+            }
+            c->start = (rate > 0) ? c->due : now;
+            continue;
+        }
+        if (startRequest(t, c, (rate > 0) ? c->due : now) < 0) {
+            t->errors++;
+            closeConn(c);
+            c->state = LG_IDLE;
+        }
+    }
+    if (next == UINT64_MAX)
+        return -1;
+    return (int)((next - now + 999999) / 1000000);
+}
+
+/**
+ * @brief Body of a generator thread.
+ */
+void *runThread(void *arg) {
+    struct lgThread *t = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    for (;;) {
+        uint64_t now = nowNs();
+        if (now >= measureUntil)
+            break;
+        int timeout = startDue(t, now);
+        uint64_t left = (measureUntil - now) / 1000000 + 1;
+        if (timeout < 0 || (uint64_t)timeout > left)
+            timeout = left;
+
+        int n = epoll_wait(t->epfd, events, MAX_EVENTS, timeout);
+        now = nowNs();
+        for (int i = 0; i < n; i++) {
+            struct lgConn *c = events[i].data.ptr;
+            int ret = 0;
+            if (c->state == LG_CONNECTING) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0)
+                    ret = -1;
+                else if (c->due <= now)
+                    ret = startRequest(t, c, c->start);
+                else {
+                    c->state = LG_IDLE;
+                    waitFor(t, c, 0);
+                }
+            } else if (c->state == LG_SENDING) {
+                ret = sendRequest(t, c);
+            } else {
+                ret = readResponse(t, c, now);
+            }
+            if (ret < 0) {
+                if (now >= measureFrom && now < measureUntil)
+                    t->errors++;
+                closeConn(c);
+                c->state = LG_IDLE;
+            }
+        }
+    }
+
+    for (int i = 0; i < t->connCount; i++)
+        closeConn(&t->conns[i]);
+    return NULL;
+}
+
+/**
+ * @brief Opens the stalled connections, each sends the start of a request header and then nothing.
+ * @return the sockets, stallCount of them.
+ */
+int *openStalled(void) {
+    int *fds = malloc((stallCount > 0 ? stallCount : 1) * sizeof(int));
+    if (fds == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    char partial[256];
+    int len = snprintf(partial, sizeof(partial), "GET / HTTP/1.1\r\nHost: %.200s\r\n", host);
+    for (int i = 0; i < stallCount; i++) {
+        fds[i] = socket(server->ai_family, server->ai_socktype | SOCK_CLOEXEC, server->ai_protocol);
+        if (fds[i] < 0 || connect(fds[i], server->ai_addr, server->ai_addrlen) < 0 ||
+            send(fds[i], partial, len, MSG_NOSIGNAL) != len) {
+            fprintf(stderr, "%s: Error opening stalled connection %d: %s\n", name, i, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return fds;
+}
+
+/**
+ * @brief Counts the stalled connections the server has closed and closes all of them.
+ * @details A timed out connection may still carry an error response before its end.
+ * @return number of connections that reached their end or were reset.
+ */
+int closeStalled(int *fds) {
+    int dropped = 0;
+    for (int i = 0; i < stallCount; i++) {
+        char sink[4096];
+        ssize_t n;
+        while ((n = recv(fds[i], sink, sizeof(sink), MSG_DONTWAIT)) > 0)
+            ;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            dropped++;
+        close(fds[i]);
+    }
+    free(fds);
+    return dropped;
+}
+
+/**
+ * @brief Summary of a run, also the format of the baseline file.
+ */
+struct result {
+    double rps;                                          /*!< completed requests per second */
+    double mbps;                                         /*!< received MiB per second */
+    double p50;                                          /*!< median latency in ms */
+    double p90;                                          /*!< 90th percentile in ms */
+    double p99;                                          /*!< 99th percentile in ms */
+    double p999;                                         /*!< 99.9th percentile in ms */
+    double max;                                          /*!< largest latency in ms */
+};
+
+/**
+ * @brief Reads a baseline written by saveResult().
+ * @return 0 on success, -1 if the file is missing or malformed.
+ */
+int loadResult(const char *path, struct result *r) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+    int n = fscanf(f, "rps %lf\nmbps %lf\np50 %lf\np90 %lf\np99 %lf\np999 %lf\nmax %lf\n",
+                   &r->rps, &r->mbps, &r->p50, &r->p90, &r->p99, &r->p999, &r->max);
+    fclose(f);
+    return (n == 7) ? 0 : -1;
+}
+
+/**
+ * @brief Stores a result as baseline.
+ * @return 0 on success, -1 on error.
+ */
+int saveResult(const char *path, const struct result *r) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL)
+        return -1;
+    fprintf(f, "rps %.1f\nmbps %.2f\np50 %.4f\np90 %.4f\np99 %.4f\np999 %.4f\nmax %.4f\n",
+            r->rps, r->mbps, r->p50, r->p90, r->p99, r->p999, r->max);
+    return fclose(f);
+}
+
+/**
+ * @brief Prints one line of the baseline comparison.
+ * @param gate whether a regression of this value fails the run, tail percentiles are too noisy for it.
+ * @return 1 if the value regressed by more than threshold percent and gate is set.
+ */
+int compare(const char *label, double now, double base, int higherIsBetter, int gate) {
+    double change = (base != 0) ? (now - base) / base * 100 : 0;
+    int regressed = gate && (higherIsBetter ? (change < -threshold) : (change > threshold));
+    printf("  %-10s %12.3f  baseline %12.3f  %+7.1f%%%s\n", label, now, base, change, regressed ? "  REGRESSION" : "");
+    return regressed;
+}
+
+/**
+ * Program entry point.
+ * @brief Runs the benchmark and prints throughput and latency percentiles.
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return EXIT_SUCCESS, EXIT_FAILURE on errors, if the baseline comparison found a regression, p99 exceeds its bound
+ * or a stalled connection is still open.
+ */
+int main(int argc, char **argv) {
+    name = argv[0];
+    readArgs(argc, argv);
+    buildRequests();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int s = getaddrinfo(host, port, &hints, &server);
+    if (s != 0) {
+        fprintf(stderr, "%s: getaddrinfo: %s\n", name, gai_strerror(s));
+        exit(EXIT_FAILURE);
+    }
+
+    struct lgThread *threads = calloc(threadCount, sizeof(struct lgThread));
+    struct lgConn *conns = calloc(connCount, sizeof(struct lgConn));
+    if (threads == NULL || conns == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    int *stalled = openStalled();
+    uint64_t start = nowNs();
+    measureFrom = start + (uint64_t)warmup * 1000000000ULL;
+    measureUntil = measureFrom + (uint64_t)duration * 1000000000ULL;
+    for (int i = 0; i < connCount; i++) {
+        conns[i].fd = -1;
+        conns[i].state = LG_IDLE;
+        // spread the first requests of an open loop run over one interval
+        conns[i].due = (rate > 0) ? start + (uint64_t)(1e9 / rate * i) : start;
+    }
+
+    int offset = 0;
+    for (int i = 0; i < threadCount; i++) {
+        struct lgThread *t = &threads[i];
+        t->conns = conns + offset;
+        t->connCount = connCount / threadCount + (i < connCount % threadCount);
+        offset += t->connCount;
+        t->seed = 0x9e3779b9u * (i + 1);
+        t->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (t->epfd < 0 || pthread_create(&t->thread, NULL, runThread, t) != 0) {
+            fprintf(stderr, "%s: Error starting threads!\n", name);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct histogram *hist = calloc(1, sizeof(struct histogram));
+    uint64_t requests = 0, bytes = 0, errors = 0, non2xx = 0;
+    if (hist == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        struct lgThread *t = &threads[i];
+        pthread_join(t->thread, NULL);
+        close(t->epfd);
+        for (int b = 0; b < HIST_BUCKETS; b++)
+            hist->counts[b] += t->hist.counts[b];
+        hist->total += t->hist.total;
+        if (t->hist.max > hist->max)
+            hist->max = t->hist.max;
+        requests += t->requests;
+        bytes += t->bytes;
+        errors += t->errors;
+        non2xx += t->non2xx;
+    }
+
+    struct result r;
+    r.rps = requests / (double)duration;
+    r.mbps = bytes / (double)duration / (1024 * 1024);
+    r.p50 = histPercentile(hist, 50) / 1e6;
+    r.p90 = histPercentile(hist, 90) / 1e6;
+    r.p99 = histPercentile(hist, 99) / 1e6;
+    r.p999 = histPercentile(hist, 99.9) / 1e6;
+    r.max = hist->max / 1e6;
+
+    printf("%d connections, %d threads, %ds, %s, %s\n", connCount, threadCount, duration,
+           keepAlive ? "keep-alive" : "new connection per request",
+           (rate > 0) ? "open loop" : "closed loop");
+    if (rate > 0)
+        printf("target rate  %.1f req/s\n", rate);
+    printf("requests     %llu (%llu errors, %llu non-2xx)\n", (unsigned long long)requests,
+           (unsigned long long)errors, (unsigned long long)non2xx);
+    printf("throughput   %.1f req/s, %.2f MiB/s\n", r.rps, r.mbps);
+    printf("latency ms   p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  p99.99 %.3f  max %.3f\n",
+           r.p50, r.p90, r.p99, r.p999, histPercentile(hist, 99.99) / 1e6, r.max);
+
+    int regressed = 0;
+    if (maxP99 > 0 && r.p99 > maxP99) {
+        printf("p99 %.3f ms exceeds the bound of %.3f ms\n", r.p99, maxP99);
+        regressed = 1;
+    }
+    int dropped = closeStalled(stalled);
+    if (stallCount > 0) {
+        printf("stalled      %d connections, %d dropped by the server\n", stallCount, dropped);
+        if (dropped < stallCount)
+            regressed = 1;
+    }
+    if (baselinePath != NULL) {
+        struct result base;
+        if (loadResult(baselinePath, &base) == 0) {
+            printf("compared to %s (threshold %.1f%%):\n", baselinePath, threshold);
+            regressed |= compare("req/s", r.rps, base.rps, 1, 1);
+            regressed |= compare("MiB/s", r.mbps, base.mbps, 1, 1);
+            regressed |= compare("p50 ms", r.p50, base.p50, 0, 1);
+            regressed |= compare("p99 ms", r.p99, base.p99, 0, 1);
+            compare("p99.9 ms", r.p999, base.p999, 0, 0);
+        } else {
+            printf("no baseline in %s\n", baselinePath);
+        }
+    }
+    if (savePath != NULL && saveResult(savePath, &r) < 0)
+        fprintf(stderr, "%s: Error writing %s!\n", name, savePath);
+
+    freeaddrinfo(server);
+    free(hist);
+    free(conns);
+    free(threads);
+    for (int i = 0; i < mixCount; i++) {
+        free(mix[i].req[0]);
+        free(mix[i].req[1]);
+    }
+    exit((regressed || (errors > 0 && requests == 0)) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,316 @@
+/**
+ * @file response.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Incremental parser of HTTP/1.1 responses.
+ *
+ * The header is collected until the empty line and then interpreted once. Body bytes are handed
+ * to a callback without copying, or, for bodies of known length and chunk data, may be consumed
+ * by the caller directly from the socket (e.g. with splice()) and reported with responseSkip().
+ **/
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "response.h"
+
+/**
+ * @brief Prepares a parser for the next response.
+ * @details The header buffer of a previous response is kept for reuse.
+ * @param r the parser, zeroed before its first use.
+ * @param noBody 1 if the request was HEAD.
+ * @return void
+ */
+void responseInit(struct response *r, int noBody) {
+    char *header = r->header;
+    size_t headerCap = r->headerCap;
+    memset(r, 0, sizeof(*r));
+    r->header = header;
+    r->headerCap = headerCap;
+    r->state = RESP_HEADER;
+    r->noBody = noBody;
+    r->contentLength = -1;
+}
+
+/**
+ * @brief Frees the header of a parser.
+ * @param r the parser.
+ * @return void
+ */
+void responseFree(struct response *r) {
+    free(r->header);
+    r->header = NULL;
+    r->headerLen = 0;
+    r->headerCap = 0;
+}
+
+/**
+ * @brief Returns the value of a header field.
+ * @details Field names are compared case insensitive, surrounding whitespace of the value is skipped.
+ * @param r the parser, the header may still be incomplete.
+ * @param field the field name without the colon.
+ * @param len receives the length of the value.
+ * @return the value, not NUL terminated, or NULL if the field is missing.
+ */
+const char *responseField(const struct response *r, const char *field, size_t *len) {
+    if (r->header == NULL || r->headerLen == 0)
+        return NULL;
+    size_t fieldLen = strlen(field);
+    const char *line = strchr(r->header, '\n');
+    while (line != NULL && line[1] != '\0') {
+        line++;
+        const char *end = strchr(line, '\n');
+        if (end == NULL)
+            end = line + strlen(line);
+        if (strncasecmp(line, field, fieldLen) == 0 && line[fieldLen] == ':') {
+            const char *value = line + fieldLen + 1;
+            while (value < end && (*value == ' ' || *value == '\t'))
+                value++;
+            const char *valueEnd = end;
+            while (valueEnd > value && (valueEnd[-1] == '\r' || valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+                valueEnd--;
+            *len = valueEnd - value;
+            return value;
+        }
+        line = (*end == '\0') ? NULL : end;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parses the Content-Range field of a 206 or 416 response.
+ * @param r a parser whose header is complete.
+ * @param first receives the first byte of the range, -1 if the range was not satisfiable.
+ * @param size receives the size of the whole file.
+ * @return 0 on success, -1 if the field is missing, malformed or the size is unknown.
+ */
+int responseContentRange(const struct response *r, long long *first, long long *size) {
+    size_t len;
+    const char *value = responseField(r, "Content-Range", &len);
+    if (value == NULL || len < 8 || strncmp(value, "bytes ", 6) != 0)
+        return -1;
+    char *end;
+    if (value[6] == '*') {
+        *first = -1;
+    } else {
+        *first = strtoll(value + 6, &end, 10);
+        if (end == value + 6 || *end != '-')
+            return -1;
+    }
+    const char *slash = memchr(value, '/', len);
+    if (slash == NULL || slash[1] == '*')
+        return -1;
+    *size = strtoll(slash + 1, &end, 10);
+    return (end == slash + 1) ? -1 : 0;
+}
+
+/**
+ * @brief Checks if a comma separated field value contains a token.
+ */
+static int hasToken(const char *value, size_t len, const char *token) {
+    size_t tokenLen = strlen(token);
+    const char *end = value + len;
+    while (value < end) {
+        while (value < end && (*value == ' ' || *value == '\t' || *value == ','))
+            value++;
+        const char *item = value;
+        while (value < end && *value != ',')
+            value++;
+        const char *itemEnd = value;
+        while (itemEnd > item && (itemEnd[-1] == ' ' || itemEnd[-1] == '\t'))
+            itemEnd--;
+        if ((size_t)(itemEnd - item) == tokenLen && strncasecmp(item, token, tokenLen) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Interprets a complete header and selects how the body is delimited.
+ * @return 0 on success, -1 if the header is malformed.
+ */
+static int parseHeader(struct response *r) {
+    const char *h = r->header;
+    if (strncmp(h, "HTTP/1.", 7) != 0 || (h[7] != '0' && h[7] != '1') || h[8] != ' ')
+        return -1;
+    char *end;
+    long status = strtol(h + 9, &end, 10);
+    if (end != h + 12 || status < 100 || status > 599)
+        return -1;
+    r->status = status;
+    r->keepAlive = (h[7] == '1');
+
+    size_t len;
+    const char *value;
+    if ((value = responseField(r, "Connection", &len)) != NULL) {
+        if (hasToken(value, len, "close"))
+            r->keepAlive = 0;
+        else if (hasToken(value, len, "keep-alive"))
+            r->keepAlive = 1;
+    }
+    if ((value = responseField(r, "Transfer-Encoding", &len)) != NULL)
+        r->chunked = hasToken(value, len, "chunked");
+    if ((value = responseField(r, "Content-Length", &len)) != NULL) {
+        r->contentLength = strtoll(value, &end, 10);
+        if (end == value || r->contentLength < 0)
+            return -1;
+    }
+
+    if (r->noBody || status < 200 || status == 204 || status == 304) {
+        r->state = RESP_DONE;
+    } else if (r->chunked) {
+        r->state = RESP_CHUNK_SIZE;
+    } else if (r->contentLength >= 0) {
+        r->left = r->contentLength;
+        r->state = (r->left > 0) ? RESP_LENGTH : RESP_DONE;
+    } else {
+        r->keepAlive = 0;
+        r->state = RESP_UNTIL_CLOSE;
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends header bytes up to and including the empty line.
+ * @return number of bytes consumed, -1 if the header is too large or malformed.
+ */
+static ssize_t feedHeader(struct response *r, const char *data, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        if (r->headerLen + 2 > r->headerCap) {
+            if (r->headerCap >= RESP_HEADER_MAX)
+                return -1;
+            size_t newCap = (r->headerCap == 0) ? 1024 : r->headerCap * 2;
+            char *grown = realloc(r->header, newCap);
+            if (grown == NULL)
+                return -1;
+            r->header = grown;
+            r->headerCap = newCap;
+        }
+        r->header[r->headerLen++] = data[i];
+        r->header[r->headerLen] = '\0';
+        if (data[i] != '\n')
+            continue;
+        size_t n = r->headerLen;
+        if ((n >= 2 && r->header[n-2] == '\n') || (n >= 3 && r->header[n-2] == '\r' && r->header[n-3] == '\n')) {
+            if (parseHeader(r) < 0)
+                return -1;
+            if (r->status >= 100 && r->status < 200 && r->status != 101) // interim response, the real one follows
+                responseInit(r, r->noBody);
+            return i + 1;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Parses received bytes.
+ * @details Returns after the header is complete and after the body is complete, the caller has to
+ * call again with the rest of its data while the state is not RESP_DONE.
+ * @param r the parser.
+ * @param data received bytes.
+ * @param len number of bytes.
+ * @param body receives the body, NULL to discard it.
+ * @param arg passed to body.
+ * @return number of bytes consumed, -1 if the response is malformed or body aborted.
+ */
+ssize_t responseFeed(struct response *r, const char *data, size_t len, bodyFunc body, void *arg) {
+    if (r->state == RESP_HEADER)
+        return feedHeader(r, data, len);
+
+    size_t i = 0;
+    while (i < len && r->state != RESP_DONE) {
+        char ch = data[i];
+        switch (r->state) {
+            case RESP_LENGTH:
+            case RESP_CHUNK_DATA:
+            case RESP_UNTIL_CLOSE: {
+                size_t take = len - i;
+                if (r->state != RESP_UNTIL_CLOSE && (long long)take > r->left)
+                    take = r->left;
+                if (body != NULL && body(arg, data + i, take) < 0)
+                    return -1;
+                i += take;
+                responseSkip(r, take);
+                break;
+            }
+            case RESP_CHUNK_SIZE:
+                i++;
+                if (ch == '\n') {
+                    if (r->lineLen == 0)
+                        return -1;
+                    r->state = (r->left > 0) ? RESP_CHUNK_DATA : RESP_TRAILER;
+                    r->lineLen = 0;
+                    r->chunkExt = 0;
+                } else if (ch == ';') {
+                    r->chunkExt = 1;
+                } else if (!r->chunkExt && ch != '\r' && ch != ' ' && ch != '\t') {
+                    int digit = (ch >= '0' && ch <= '9') ? ch - '0' : ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f') ? (ch | 0x20) - 'a' + 10 : -1;
+                    if (digit < 0 || r->left > (1LL << 56))
+                        return -1;
+                    r->left = r->left * 16 + digit;
+                    r->lineLen++;
+                }
+                break;
+            case RESP_CHUNK_END:
+                i++;
+                if (ch == '\n')
+                    r->state = RESP_CHUNK_SIZE;
+                else if (ch != '\r')
+                    return -1;
+                break;
+            case RESP_TRAILER:
+                i++;
+                if (ch == '\n') {
+                    if (r->lineLen == 0)
+                        r->state = RESP_DONE;
+                    r->lineLen = 0;
+                } else if (ch != '\r') {
+                    r->lineLen++;
+                }
+                break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Tells the parser that the server closed the connection.
+ * @param r the parser.
+ * @return 0 if this completes the response, -1 if the response was cut short.
+ */
+int responseEof(struct response *r) {
+    if (r->state == RESP_UNTIL_CLOSE)
+        r->state = RESP_DONE;
+    return (r->state == RESP_DONE) ? 0 : -1;
+}
+
+/**
+ * @brief Number of body bytes that follow on the connection without any framing.
+ * @param r the parser.
+ * @return the byte count, -1 for a body delimited by the end of the connection, 0 if framing comes next.
+ */
+long long responseRawBody(const struct response *r) {
+    if (r->state == RESP_LENGTH || r->state == RESP_CHUNK_DATA)
+        return r->left;
+    return (r->state == RESP_UNTIL_CLOSE) ? -1 : 0;
+}
+
+/**
+ * @brief Accounts for body bytes the caller took from the connection itself.
+ * @param r the parser.
+ * @param n number of bytes, at most responseRawBody() unless the body is delimited by the end of the connection.
+ * @return void
+ */
+void responseSkip(struct response *r, size_t n) {
+    r->received += n;
+    if (r->state == RESP_UNTIL_CLOSE)
+        return;
+    r->left -= n;
+    if (r->left > 0)
+        return;
+    if (r->state == RESP_LENGTH)
+        r->state = RESP_DONE;
+    else
+        r->state = RESP_CHUNK_END;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file response.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Incremental parser of HTTP/1.1 responses.
+ *
+ * The parser is fed whatever the socket returned. It stops at the end of the header, so the caller can
+ * look at the status before any body byte is delivered, and at the end of the body, so the bytes that
+ * follow belong to the next response on the same connection. Bodies are delimited by Content-Length,
+ * the chunked transfer coding or the end of the connection.
+ **/
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define RESP_HEADER_MAX 65536                   /*!< larger response headers are rejected */
+
+#define RESP_HEADER 0                           /*!< reading the header */
+#define RESP_LENGTH 1                           /*!< reading a body of known length */
+#define RESP_CHUNK_SIZE 2                       /*!< reading a chunk size line */
+#define RESP_CHUNK_DATA 3                       /*!< reading chunk data */
+#define RESP_CHUNK_END 4                        /*!< reading the line break after chunk data */
+#define RESP_TRAILER 5                          /*!< reading trailer lines */
+#define RESP_UNTIL_CLOSE 6                      /*!< reading a body delimited by the end of the connection */
+#define RESP_DONE 7                             /*!< the response is complete */
+
+/**
+ * @brief State of one response being parsed.
+ */
+struct response {
+    int state;                                  /*!< one of the RESP_ constants */
+    int noBody;                                 /*!< response to HEAD, it never has a body */
+    char *header;                               /*!< the header received so far, NUL terminated */
+    size_t headerLen;                           /*!< bytes in header */
+    size_t headerCap;                           /*!< capacity of header */
+    int status;                                 /*!< status code */
+    int keepAlive;                              /*!< the connection can be used for another request */
+    int chunked;                                /*!< the body uses the chunked transfer coding */
+    long long contentLength;                    /*!< value of Content-Length, -1 if absent */
+    long long left;                             /*!< bytes left of the body or the current chunk */
+    long long received;                         /*!< body bytes delivered so far */
+    int lineLen;                                /*!< bytes of the current chunk size or trailer line */
+    int chunkExt;                               /*!< skipping a chunk extension */
+};
+
+/**
+ * @brief Receives body bytes, returns 0 to continue or -1 to abort parsing.
+ */
+typedef int (*bodyFunc)(void *arg, const char *data, size_t len);
+
+void responseInit(struct response *r, int noBody);
+void responseFree(struct response *r);
+ssize_t responseFeed(struct response *r, const char *data, size_t len, bodyFunc body, void *arg);
+int responseEof(struct response *r);
+long long responseRawBody(const struct response *r);
+void responseSkip(struct response *r, size_t n);
+const char *responseField(const struct response *r, const char *field, size_t *len);
+int responseContentRange(const struct response *r, long long *first, long long *size);
+
+#endif
@@ -0,0 +1,396 @@
+/**
+ * @file segment.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Segmented download of one file over parallel range requests.
+ *
+ * Every connection runs on its own thread with a blocking socket and takes segments from a shared
+ * queue, so fast connections fetch more segments than slow ones. A segment that breaks off is put
+ * back into the queue with the bytes already written cut off. Requests carry If-Range with the
+ * ETag of the probe, so a file changing on the server ends the download instead of mixing versions.
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "dial.h"
+#include "response.h"
+#include "segment.h"
+
+/**
+ * @brief A byte range of the file still to be fetched.
+ */
+struct segment {
+    long long from;                             /*!< first missing byte */
+    long long to;                               /*!< last byte, inclusive */
+    int attempts;                               /*!< failed attempts so far */
+    struct segment *next;                       /*!< next segment in the queue */
+};
+
+/**
+ * @brief One connection and its thread.
+ */
+struct worker {
+    pthread_t thread;                           /*!< the thread */
+    int con;                                    /*!< socket, -1 if not connected */
+    struct response resp;                       /*!< parser of the current response */
+    char *buf;                                  /*!< received bytes */
+    size_t pos;                                 /*!< first unparsed byte in buf */
+    size_t len;                                 /*!< bytes in buf */
+    long long offset;                           /*!< file offset of the next body byte */
+};
+
+static const struct segmentOptions *opt;        /*!< settings of the download */
+static struct addrinfo *addrs = NULL;           /*!< resolved server addresses */
+static int out = -1;                            /*!< the output file */
+static char *etag = NULL;                       /*!< strong ETag of the file, NULL if there is none */
+static long long total = 0;                     /*!< size of the file */
+static long long progress = 0;                  /*!< bytes written, updated atomically */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;    /*!< guards the fields below */
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;   /*!< signalled when a worker ends */
+static struct segment *queue = NULL;            /*!< segments waiting for a connection */
+static int running = 0;                         /*!< workers still running */
+static const char *fatal = NULL;                /*!< reason the download failed, NULL while it goes on */
+
+/**
+ * @brief Connects to the server, see dial.c.
+ * @return socket, -1 on error.
+ */
+static int openConnection(void) {
+    const char *err;
+    return dialAddrs(addrs, opt->connectTimeout, opt->readTimeout, &err);
+}
+
+/**
+ * @brief Writes body bytes at their offset, used as bodyFunc of the parser.
+ */
+static int writeAt(void *arg, const char *data, size_t len) {
+    struct worker *w = arg;
+    while (len > 0) {
+        ssize_t n = pwrite(out, data, len, w->offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+        w->offset += n;
+        __atomic_fetch_add(&progress, n, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+/**
+ * @brief Refills the buffer of a worker.
+ * @return number of bytes read, 0 when the server closed the connection, -1 on error.
+ */
+static ssize_t fill(struct worker *w) {
+    ssize_t n;
+    while ((n = read(w->con, w->buf, SEGMENT_BUF_SIZE)) < 0 && errno == EINTR)
+        ;
+    w->pos = 0;
+    w->len = (n > 0) ? n : 0;
+    return n;
+}
+
+/**
+ * @brief Sends a request for a byte range and reads the response header.
+ * @param w the worker, connected.
+ * @param from first byte.
+ * @param to last byte, -1 for the end of the file.
+ * @return 0 when the header is complete, -1 if the connection broke.
+ */
+static int request(struct worker *w, long long from, long long to) {
+    char req[2048];
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%lld-", opt->path, opt->host, from);
+    if (to >= 0)
+        len += snprintf(req + len, sizeof(req) - len, "%lld", to);
+    if (etag != NULL)
+        len += snprintf(req + len, sizeof(req) - len, "\r\nIf-Range: %s", etag);
+    len += snprintf(req + len, sizeof(req) - len, "\r\n\r\n");
+    if (len >= (int)sizeof(req))
+        return -1;
+    for (int off = 0; off < len; ) {
+        ssize_t n = send(w->con, req + off, len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        off += n;
+    }
+
+    responseInit(&w->resp, 0);
+    while (w->resp.state == RESP_HEADER) {
+        if (w->pos == w->len && fill(w) <= 0)
+            return -1;
+        ssize_t used = responseFeed(&w->resp, w->buf + w->pos, w->len - w->pos, NULL, NULL);
+        if (used < 0)
+            return -1;
+        w->pos += used;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a response body into the file, starting at w->offset.
+ * @return 0 on success, -1 if the connection broke.
+ */
+static int receive(struct worker *w) {
+    while (w->resp.state != RESP_DONE) {
+        if (w->pos == w->len) {
+            ssize_t n = fill(w);
+            if (n == 0)
+                return responseEof(&w->resp);
+            if (n < 0)
+                return -1;
+        }
+        ssize_t used = responseFeed(&w->resp, w->buf + w->pos, w->len - w->pos, writeAt, w);
+        if (used < 0)
+            return -1;
+        w->pos += used;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the download.
+ */
+static void fail(const char *reason) {
+    pthread_mutex_lock(&lock);
+    if (fatal == NULL)
+        fatal = reason;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Puts a segment back into the queue or gives up on it.
+ */
+static void requeue(struct segment *s) {
+    pthread_mutex_lock(&lock);
+    if (++s->attempts >= SEGMENT_RETRIES) {
+        if (fatal == NULL)
+            fatal = "Too many failed attempts";
+        free(s);
+    } else {
+        s->next = queue;
+        queue = s;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Fetches one segment.
+ * @return 0 on success, -1 if the segment has to be tried again.
+ */
+static int fetch(struct worker *w, struct segment *s) {
+    if (w->con < 0 && (w->con = openConnection()) < 0)
+        return -1;
+    if (request(w, s->from, s->to) < 0)
+        return -1;
+    long long first, size;
+    if (w->resp.status != 206 || responseContentRange(&w->resp, &first, &size) < 0 || first != s->from || size != total) {
+        fail("The file changed on the server");
+        return 0;
+    }
+    w->offset = s->from;
+    int ret = receive(w);
+    s->from = w->offset;
+    return (ret == 0 && s->from > s->to) ? 0 : -1;
+}
+
+/**
+ * @brief Body of a worker thread.
+ */
+static void *workerMain(void *arg) {
+    struct worker *w = arg;
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        struct segment *s = (fatal == NULL) ? queue : NULL;
+        if (s != NULL)
+            queue = s->next;
+        pthread_mutex_unlock(&lock);
+        if (s == NULL)
+            break;
+
+        if (fetch(w, s) == 0) {
+            free(s);
+            if (!w->resp.keepAlive) {
+                close(w->con);
+                w->con = -1;
+            }
+        } else {
+            if (w->con >= 0)
+                close(w->con);
+            w->con = -1;
+            w->pos = w->len = 0;
+            requeue(s);
+        }
+    }
+
+    pthread_mutex_lock(&lock);
+    running--;
+    pthread_cond_signal(&changed);
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+/**
+ * @brief Returns seconds since a start time.
+ */
+static double since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief Prints the progress of the download.
+ */
+static void report(const struct timespec *start, int last) {
+    long long bytes = __atomic_load_n(&progress, __ATOMIC_RELAXED);
+    double secs = since(start);
+    fprintf(stderr, "%s: %5.1f%% %lld of %lld bytes in %.1f s, %.1f MB/s%s", opt->name, total ? 100.0 * bytes / total : 100.0,
+            bytes, total, secs, (secs > 0) ? bytes / secs / 1e6 : 0.0, (last || !isatty(STDERR_FILENO)) ? "\n" : "\r");
+}
+
+/**
+ * @brief Probes the file and fetches it over parallel range requests.
+ * @details If the server ignores the range of the probe, the probe response already carries the whole file
+ * and is written as it is.
+ * @param options settings of the download.
+ * @return 0 on success, 3 if the server answered with an error status, 2 if the download failed.
+ */
+int segmentRun(const struct segmentOptions *options) {
+    opt = options;
+    int connections = opt->connections;
+    struct worker *workers = calloc(connections, sizeof(struct worker));
+    if (workers == NULL)
+        return EXIT_FAILURE;
+    for (int i = 0; i < connections; i++) {
+        workers[i].con = -1;
+        if ((workers[i].buf = malloc(SEGMENT_BUF_SIZE)) == NULL)
+            fatal = "Memory error!";
+    }
+
+    const char *err;
+    if (dialResolve(opt->host, opt->port, &addrs, &err) < 0) {
+        fprintf(stderr, "%s: getaddrinfo: %s\n", opt->name, err);
+        fatal = "Could not resolve host";
+    }
+
+    int ret = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct worker *probe = &workers[0];
+    if (fatal == NULL && ((probe->con = openConnection()) < 0 || request(probe, 0, 0) < 0))
+        fatal = "Could not connect to host";
+    // the probe asks for the first byte, which an empty file does not have
+    long long first, size;
+    int empty = (fatal == NULL && probe->resp.status == 416 &&
+                 responseContentRange(&probe->resp, &first, &size) == 0 && first < 0 && size == 0);
+    if (fatal == NULL && probe->resp.status != 200 && probe->resp.status != 206 && !empty) {
+        size_t len = strcspn(probe->resp.header, "\r\n");
+        fprintf(stderr, "%s: %.*s\n", opt->name, (int)((len > 9) ? len - 9 : 0), probe->resp.header + 9);
+        ret = 3;
+    } else if (fatal == NULL && (out = open(opt->file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0) {
+        fatal = strerror(errno);
+    } else if (fatal == NULL && empty) {
+        total = 0;
+    } else if (fatal == NULL && probe->resp.status == 200) {
+        fprintf(stderr, "%s: the server does not support ranges, fetching in one piece\n", opt->name);
+        total = probe->resp.contentLength;
+        if (receive(probe) < 0)
+            fatal = "Connection closed early";
+        total = progress;
+    } else if (fatal == NULL) {
+        long long first;
+        size_t len;
+        const char *value = responseField(&probe->resp, "ETag", &len);
+        if (value != NULL && len > 0 && value[0] == '"')
+            etag = strndup(value, len);
+        if (responseContentRange(&probe->resp, &first, &total) < 0 || first != 0 || receive(probe) < 0)
+            fatal = "Protocol error!";
+        else if (!probe->resp.keepAlive) {
+            close(probe->con);
+            probe->con = -1;
+        }
+    }
+
+    if (fatal == NULL && total > progress) {
+        if (posix_fallocate(out, 0, total) != 0 && ftruncate(out, total) < 0)
+            fatal = strerror(errno);
+
+        long long size = (total - 1) / ((long long)connections * SEGMENTS_PER_CONN) + 1;
+        if (size < SEGMENT_MIN)
+            size = SEGMENT_MIN;
+        struct segment **tail = &queue;
+        for (long long from = progress; from < total && fatal == NULL; from += size) {
+            struct segment *seg = calloc(1, sizeof(struct segment));
+            if (seg == NULL) {
+                fatal = "Memory error!";
+                break;
+            }
+            seg->from = from;
+            seg->to = (from + size < total) ? from + size - 1 : total - 1;
+            *tail = seg;
+            tail = &seg->next;
+        }
+
+        pthread_mutex_lock(&lock);
+        for (int i = 0; i < connections && fatal == NULL; i++) {
+            if (pthread_create(&workers[i].thread, NULL, workerMain, &workers[i]) != 0)
+                break;
+            running++;
+        }
+        int started = running;
+        while (running > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            if (pthread_cond_timedwait(&changed, &lock, &deadline) == ETIMEDOUT)
+                report(&start, 0);
+        }
+        if (started == 0 && fatal == NULL)
+            fatal = "Cannot start threads";
+        pthread_mutex_unlock(&lock);
+        for (int i = 0; i < started; i++)
+            pthread_join(workers[i].thread, NULL);
+        if (fatal == NULL && progress < total)
+            fatal = "Too many failed attempts";
+    }
+
+    if (fatal == NULL && ret == 0)
+        report(&start, 1);
+    else if (ret == 0)
+        fprintf(stderr, "%s: Error receiving %s: %s\n", opt->name, opt->path, fatal);
+    if (out >= 0 && close(out) < 0 && fatal == NULL)
+        fatal = strerror(errno);
+
+    while (queue != NULL) {
+        struct segment *seg = queue;
+        queue = seg->next;
+        free(seg);
+    }
+    for (int i = 0; i < connections; i++) {
+        if (workers[i].con >= 0)
+            close(workers[i].con);
+        responseFree(&workers[i].resp);
+        free(workers[i].buf);
+    }
+    free(workers);
+    free(etag);
+    if (addrs != NULL)
+        freeaddrinfo(addrs);
+    if (ret == 0 && fatal != NULL)
+        ret = 2;
+    return ret;
+}
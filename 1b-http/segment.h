@@ -0,0 +1,36 @@
+/**
+ * @file segment.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Segmented download of one file over parallel range requests.
+ *
+ * A probe request for the first byte tells the size of the file and whether the server supports
+ * ranges. The file is then cut into segments which a number of connections fetch in parallel,
+ * each segment is written with pwrite() at its offset into the preallocated output file.
+ **/
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#define SEGMENT_MIN (1024 * 1024)               /*!< smallest segment in bytes */
+#define SEGMENTS_PER_CONN 4                     /*!< segments per connection, smaller ones balance slow connections */
+#define SEGMENT_RETRIES 3                       /*!< attempts per segment */
+#define SEGMENT_BUF_SIZE (256 * 1024)           /*!< receive buffer per connection */
+
+/**
+ * @brief Settings of a segmented download.
+ */
+struct segmentOptions {
+    const char *name;                           /*!< program name for messages */
+    const char *host;                           /*!< server host */
+    const char *port;                           /*!< server port */
+    const char *path;                           /*!< request target */
+    const char *file;                           /*!< output file */
+    int connections;                            /*!< parallel connections */
+    int connectTimeout;                         /*!< ms to establish a connection */
+    int readTimeout;                            /*!< ms a read may block */
+};
+
+int segmentRun(const struct segmentOptions *opt);
+
+#endif
@@ -4,48 +4,221 @@
  * @date 12.04.2019
  *
  * @brief HTTP Server Software
- * 
+ *
  * This Program allows to offer files that can be fetched by HTTP.
+ * Connections are served by worker threads, each running its own non-blocking epoll loop. Every connection has a
+ * deadline for receiving its request header, for making progress while its response is sent
+ * and for staying idle between requests; the deadlines are tracked in a timer wheel.
+ * Completed responses can be written to an access log by a background thread.
  **/
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
 #include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
+#include "accesslog.h"
+#include "dirindex.h"
+#include "filecache.h"
+#include "handler.h"
+#include "stats.h"
+#include "timerwheel.h"
+
+#define MAX_RANGES 16                                /*!< more ranges than this are ignored and the full file is sent */
+#define BOUNDARY "3d6b6a416f9b5bf0"                  /*!< separator for multipart/byteranges responses */
+#define MAX_HEADER_SIZE 16384                        /*!< larger request headers are rejected */
+#define MAX_EVENTS 256                               /*!< events fetched per epoll_wait() */
+#define MAX_IOV 16                                   /*!< memory segments sent per writev() */
+#define LISTEN_BACKLOG 1024                          /*!< pending connections the kernel queues for us */
+#define TICK_MS 100                                  /*!< granularity of the connection deadlines */
+#define HEADER_TIMEOUT 10                            /*!< default seconds to receive a complete request header */
+#define SEND_TIMEOUT 30                              /*!< default seconds a response may make no progress */
+#define IDLE_TIMEOUT 60                              /*!< default seconds a keep-alive connection may stay idle */
+#define DRAIN_GRACE_MS 500                           /*!< idle connections get this long to send one last request on reload */
+#define HANDOFF_TIMEOUT 10                           /*!< seconds the two processes wait for each other during a reload */
+
+#define CONN_READ_HEADER 0                           /*!< waiting for (the rest of) a request header */
+#define CONN_SEND 1                                  /*!< sending a response */
+#define CONN_IDLE 2                                  /*!< keep-alive connection between two requests */
+#define CONN_HANDLER 3                               /*!< waiting for a dynamic handler on the pool */
 
-static char *name = NULL;                            /*!< program name */  
+/**
+ * @brief A single satisfiable byte range of the requested file.
+ */
+struct byteRange {
+    off_t first;                                     /*!< offset of the first byte */
+    off_t last;                                      /*!< offset of the last byte (inclusive) */
+};
 
-static char *port = NULL;                            /*!< port given by user */  
-static char *defaultPort = "8080";                   /*!< port given by specification */
-static char *indexFile = NULL;                       /*!< index file by request*/
-static char *indexFileDefault = "index.html";        /*!< standard index file by specification */
-static char *docRoot = NULL;                         /*!< path to the document root, where server will load files from */
-static char *reqPath = NULL;                         /*!< request Path provided by client  */
-static char *reqUrl = NULL;                          /*!< request URL provided by client */  
-static char *resHeader = NULL;                       /*!< response Header build by server */
-static char *resStatusCode = NULL;                   /*!< response http status message */
-static char *resMsg = NULL;                          /*!< response Msg */
-static int sockfd;                                   /*!< socket descriptor */
+/**
+ * @brief The selected representation of the requested file.
+ * @details Either fd or data is used, data takes precedence.
+ */
+struct responseBody {
+    int fd;                                          /*!< descriptor of the file to send */
+    const unsigned char *data;                       /*!< in memory body, e.g. compressed on the fly */
+    off_t size;                                      /*!< number of bytes of the representation */
+    int encoding;                                    /*!< content coding, one of the ENC_ constants */
+};
 
-volatile sig_atomic_t done = 0;                      /*!< atomic runner variable */  
+/**
+ * @brief Maps a file name extension to a media type.
+ */
+struct mimeType {
+    const char *ext;                                 /*!< extension without the dot */
+    const char *type;                                /*!< media type sent as Content-Type */
+    int compressible;                                /*!< worth compressing on the fly */
+};
 
 /**
- * @brief Sets done to one to interrupt next loop.
- * @details This function will set done to 1, so that the after the handling of the last client request, the loop will be broken and the programm will exit instead of waiting for a new client.
- * @param signum SIGNAL number
- * @return void
+ * @brief A parsed request. The header values point into the input buffer of the connection.
  */
-void term (int signum) {
-    done = 1;
-}
+struct request {
+    char *url;                                       /*!< request target as sent by the client */
+    char *path;                                      /*!< file system path of the requested file */
+    int keepAlive;                                   /*!< connection may be reused after the response */
+    const char *range;                               /*!< value of the Range request header */
+    const char *ifRange;                             /*!< value of the If-Range request header */
+    const char *ifNoneMatch;                         /*!< value of the If-None-Match request header */
+    const char *ifModifiedSince;                     /*!< value of the If-Modified-Since request header */
+    const char *acceptEncoding;                      /*!< value of the Accept-Encoding request header */
+    int isDir;                                       /*!< path is a directory without index file, send a listing */
+    const struct handler *handler;                   /*!< dynamic handler of the request target, NULL for files */
+};
+
+/**
+ * @brief A piece of a response waiting to be sent, either memory or a file range.
+ */
+struct segment {
+    struct segment *next;                            /*!< next segment of the response */
+    const char *data;                                /*!< memory to send, NULL for file segments */
+    int fd;                                          /*!< file to send from if data is NULL */
+    off_t off;                                       /*!< offset of the next byte in data or the file */
+    off_t len;                                       /*!< number of bytes left */
+    char buf[];                                      /*!< storage of copied memory segments */
+};
+
+/**
+ * @brief State of one client connection.
+ */
+struct connection {
+    int fd;                                          /*!< socket descriptor */
+    int state;                                       /*!< one of the CONN_ constants */
+    uint32_t events;                                 /*!< epoll events we are registered for */
+    char *in;                                        /*!< received bytes not yet consumed */
+    size_t inLen;                                    /*!< number of bytes in in */
+    size_t inCap;                                    /*!< capacity of in */
+    size_t scanned;                                  /*!< bytes of in already searched for the header end */
+    struct segment *out;                             /*!< first segment to send */
+    struct segment *outTail;                         /*!< last segment to send */
+    int fileFd;                                      /*!< file of the current response */
+    int siblingFd;                                   /*!< pre-compressed sibling of the current response */
+    struct cachedBody *cached;                       /*!< compressed body of the current response */
+    struct dirListing *listing;                      /*!< cached directory listing of the current response */
+    struct dirStream *dirStream;                     /*!< directory listing still being rendered */
+    struct handlerJob *job;                          /*!< dynamic handler running for or answering the current request */
+    int keepAlive;                                   /*!< keep the connection after the current response */
+    int status;                                      /*!< status code of the current response */
+    uint64_t bytesSent;                              /*!< bytes sent of the current response */
+    uint64_t reqStart;                               /*!< microseconds at which the current request was complete */
+    struct sockaddr_storage peer;                    /*!< address of the client */
+    char method[LOG_METHOD_MAX];                     /*!< request method for the access log */
+    char url[LOG_URL_MAX];                           /*!< request target for the access log */
+    struct timer timer;                              /*!< deadline of the current state */
+    struct connection *prev;                         /*!< previous connection of the worker */
+    struct connection *next;                         /*!< next connection of the worker */
+};
+
+/**
+ * @brief An event loop serving connections.
+ */
+struct worker {
+    struct statsBlock stats;                         /*!< counters, only written by this worker */
+    pthread_t thread;                                /*!< thread running the event loop */
+    int index;                                       /*!< position in workers */
+    struct logRing *log;                             /*!< access log ring, NULL if logging is disabled */
+    int epfd;                                        /*!< epoll instance */
+    struct timerWheel wheel;                         /*!< deadlines of all connections */
+    struct connection *conns;                        /*!< all open connections */
+    int draining;                                    /*!< stopped accepting, exits when conns is empty */
+    struct completionQueue completions;              /*!< handler jobs finished for this worker */
+};
+
+static const struct mimeType mimeTypes[] = {
+    {"html", "text/html; charset=utf-8", 1},
+    {"htm", "text/html; charset=utf-8", 1},
+    {"css", "text/css; charset=utf-8", 1},
+    {"js", "text/javascript; charset=utf-8", 1},
+    {"mjs", "text/javascript; charset=utf-8", 1},
+    {"json", "application/json", 1},
+    {"txt", "text/plain; charset=utf-8", 1},
+    {"csv", "text/csv; charset=utf-8", 1},
+    {"md", "text/markdown; charset=utf-8", 1},
+    {"xml", "application/xml", 1},
+    {"svg", "image/svg+xml", 1},
+    {"wasm", "application/wasm", 1},
+    {"ico", "image/x-icon", 1},
+    {"png", "image/png", 0},
+    {"jpg", "image/jpeg", 0},
+    {"jpeg", "image/jpeg", 0},
+    {"gif", "image/gif", 0},
+    {"webp", "image/webp", 0},
+    {"woff", "font/woff", 0},
+    {"woff2", "font/woff2", 0},
+    {"pdf", "application/pdf", 0},
+    {"zip", "application/zip", 0},
+    {"gz", "application/gzip", 0},
+    {"mp4", "video/mp4", 0},
+    {"webm", "video/webm", 0},
+    {"mp3", "audio/mpeg", 0},
+    {NULL, NULL, 0}
+};
+
+static char *name = NULL;                            /*!< program name */
+
+static char *port = NULL;                            /*!< port given by user */
+static char *defaultPort = "8080";                   /*!< port given by specification */
+static char *indexFile = NULL;                       /*!< index file by request*/
+static char *indexFileDefault = "index.html";        /*!< standard index file by specification */
+static char *docRoot = NULL;                         /*!< path to the document root, where server will load files from */
+static int headerTimeout = HEADER_TIMEOUT;           /*!< seconds to receive a request header */
+static int sendTimeout = SEND_TIMEOUT;               /*!< seconds a response may stall */
+static char *logPath = NULL;                         /*!< access log file, NULL if logging is disabled */
+static int idleTimeout = IDLE_TIMEOUT;               /*!< seconds a keep-alive connection may stay idle */
+static int workerCount = 0;                          /*!< number of worker threads, 0 for one per CPU */
+static int handlerThreads = HANDLER_THREADS;         /*!< threads running dynamic handlers */
+static struct worker *workers = NULL;                /*!< all workers */
+static int sockfd = -1;                              /*!< socket descriptor */
+static int wakeFd = -1;                              /*!< eventfd waking all workers on shutdown */
+static int listenTag;                                /*!< epoll tag of the listening socket */
+static int wakeTag;                                  /*!< epoll tag of wakeFd */
+static char *controlPath = NULL;                     /*!< UNIX socket used to hand the listener to a new process */
+static int controlFd = -1;                           /*!< listening control socket */
+static char **savedArgv = NULL;                      /*!< arguments to restart with on SIGHUP */
+static int runningWorkers = 0;                       /*!< workers whose event loop has not returned yet */
+
+volatile sig_atomic_t done = 0;                      /*!< atomic runner variable */
+volatile sig_atomic_t draining = 0;                  /*!< the listener has been handed over, finish and exit */
 
 /**
  * @brief clean up function.
@@ -54,10 +227,19 @@ void term (int signum) {
  * @return void
  */
 void cleanUp(void) {
-    free(reqPath);
-    reqPath = NULL;
-    free(resHeader);
-    resHeader = NULL;
+    if (sockfd >= 0)
+        close(sockfd);
+    sockfd = -1;
+    if (wakeFd >= 0)
+        close(wakeFd);
+    wakeFd = -1;
+    if (controlFd >= 0)
+        close(controlFd);
+    controlFd = -1;
+    free(workers);
+    workers = NULL;
+    cacheDestroy();
+    dirCacheDestroy();
 }
 
 /**
@@ -68,10 +250,37 @@ void cleanUp(void) {
  */
 void usage(void) {
     cleanUp();
-    printf("SYNOPSIS\n\tserver [-p PORT] [-i INDEX] DOC_ROOT\nEXAMPLE\n\tserver -p 1280 -i index.html /Documents/my_website/\n");
+    printf("SYNOPSIS\n\tserver [-p PORT] [-i INDEX] [-t HEADER,SEND,IDLE] [-w WORKERS] [-j HANDLER_THREADS] [-l ACCESS_LOG] [-s CONTROL_SOCKET] DOC_ROOT\nEXAMPLE\n\tserver -p 1280 -i index.html -t 10,30,60 -w 4 -j 4 -l access.log -s /run/server.sock /Documents/my_website/\n");
     exit(EXIT_FAILURE);
 }
 
+/**
+ * @brief Parses the timeout argument.
+ * @details Expects three positive numbers of seconds separated by commas.
+ * @param arg the argument of -t.
+ * @return 0 on success, -1 if the argument is malformed.
+ */
+int parseTimeouts(const char *arg) {
+    int values[3];
+    char *end;
+    for (int i = 0; i < 3; i++) {
+        errno = 0;
+        long v = strtol(arg, &end, 10);
+        if (errno != 0 || end == arg || v < 1 || v > 86400)
+            return -1;
+        values[i] = v;
+        if (i < 2 && *end++ != ',')
+            return -1;
+        arg = end;
+    }
+    if (*end != '\0')
+        return -1;
+    headerTimeout = values[0];
+    sendTimeout = values[1];
+    idleTimeout = values[2];
+    return 0;
+}
+
 /**
  * @brief Reads in all arguments and parses them.
  * @details Attempts to map all given arguments to the needed variables and pointers.
@@ -81,7 +290,8 @@ void usage(void) {
  */
 void readArgs(int argc, char **argv) {
     int opt;
-    while((opt = getopt(argc, argv, "p:i:")) != -1) {
+    char *endpnt;
+    while((opt = getopt(argc, argv, "p:i:t:w:j:l:s:")) != -1) {
         switch (opt) {
             case 'p':
                 port = optarg;
@@ -89,6 +299,36 @@ void readArgs(int argc, char **argv) {
             case 'i':
                 indexFileDefault = optarg;
                 break;
+            case 't':
+                if (parseTimeouts(optarg) < 0) {
+                    fprintf(stderr, "%s: invalid timeouts!\n", name);
+                    usage();
+                }
+                break;
+            case 'l':
+                logPath = optarg;
+                break;
+            case 's':
+                controlPath = optarg;
+                if (strlen(controlPath) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+                    fprintf(stderr, "%s: control socket path too long!\n", name);
+                    usage();
+                }
+                break;
+            case 'w':
+                workerCount = strtol(optarg, &endpnt, 10);
+                if ((*endpnt != '\0') || (workerCount < 1) || (workerCount > 1024)) {
+                    fprintf(stderr, "%s: invalid number of workers!\n", name);
+                    usage();
+                }
+                break;
+            case 'j':
+                handlerThreads = strtol(optarg, &endpnt, 10);
+                if ((*endpnt != '\0') || (handlerThreads < 1) || (handlerThreads > 1024)) {
+                    fprintf(stderr, "%s: invalid number of handler threads!\n", name);
+                    usage();
+                }
+                break;
             default:
                 usage();
                 break;
@@ -145,9 +385,10 @@ void validateArgs(void) {
 }
 
 
+
 /**
  * @brief Connect to Server over Socket.
- * @details This function will create a socket, bind it, listen on it and start accepting connections.
+ * @details This function will create a non-blocking socket, bind it and listen on it.
  * @param void
  * @return void
  */
@@ -159,21 +400,22 @@ void createConnection(void) {
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE;
 
-    int res = getaddrinfo( NULL , port, &hints, &ai); 
+    int res = getaddrinfo( NULL , port, &hints, &ai);
     if (res != 0) {
         fprintf(stderr, "%s: Error getting address!\n", name);
-        freeaddrinfo(ai);
         cleanUp();
         exit(EXIT_FAILURE);
     }
 
-    sockfd = socket(ai->ai_family, ai->ai_socktype,ai->ai_protocol);
+    sockfd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
     if (sockfd < 0) {
         fprintf(stderr, "%s: Error creating socket!\n", name);
         freeaddrinfo(ai);
         cleanUp();
         exit(EXIT_FAILURE);
     }
+    int one = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
     if ( bind(sockfd, ai->ai_addr, ai->ai_addrlen) < 0) {
         fprintf(stderr, "%s: Error binding to socket!\n", name);
         freeaddrinfo(ai);
@@ -183,7 +425,7 @@ void createConnection(void) {
 
     freeaddrinfo(ai);
 
-    if (listen(sockfd, 1) < 0) {
+    if (listen(sockfd, LISTEN_BACKLOG) < 0) {
         fprintf(stderr, "%s: Error while listeing on socket!\n", name);
         cleanUp();
         exit(EXIT_FAILURE);
@@ -192,340 +434,1702 @@ void createConnection(void) {
 }
 
 /**
- * @brief Getline from Socket.
- * @details By reading character by character, this function builds up a whole line and then returns it.
- * The Memory needed is dynamically allocated.
- * @param con socket id.
- * @param pnt an empty pointer pointing to the resulting line.
- * @return size of the buffer created to store the line.
+ * @brief Current time in timer wheel ticks.
+ * @param void
+ * @return monotonic time divided by TICK_MS.
  */
-int fgetline(int con, char **pnt) {
-    int bufferSize = 0; 
-    int currentBufferSize = 0; 
-    int linelen;
-    char msg; 
-    char *buffer = NULL; 
-    char *newBuffer;
+uint64_t nowTicks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / TICK_MS;
+}
 
-    for(;;) {
-        linelen = read(con, &msg, 1);
-        if (linelen < 1) {
-            fprintf(stdout, "%s: unexpected client disconnect.\n", name);
-            return 0;
+/**
+ * @brief Current time in microseconds.
+ * @param void
+ * @return monotonic time in microseconds.
+ */
+uint64_t nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Decodes the percent-encoding of a request target.
+ * @details The decoded path must not leave the document root, so no segment of it may be "..", whether the
+ * dots or the slashes around them were escaped or not.
+ * @param dst receives the decoded bytes, at least len bytes large, not NUL terminated.
+ * @param src the encoded target.
+ * @param len number of bytes of src.
+ * @return number of decoded bytes, -1 if an escape is malformed, decodes to NUL or the path has a ".." segment.
+ */
+int decodePath(char *dst, const char *src, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        if (src[i] != '%') {
+            dst[n++] = src[i];
+            continue;
         }
-        if (msg == '\n')
-            break;
-        if ((bufferSize == 0) || (currentBufferSize == bufferSize)) { 
-            bufferSize += 64; 
-            newBuffer = realloc(buffer, bufferSize); 
-            if (!newBuffer) { 
-                fprintf(stderr, "%s: Error realloc memory!\n", name);	
-                free(buffer);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            } 
-            buffer = newBuffer; 
-        } 
-        buffer[currentBufferSize] = msg;
-        ++currentBufferSize;
-    } 
-
-    if ((currentBufferSize > 0) && (buffer[currentBufferSize-1] == '\r'))
-        --currentBufferSize;
-
-    // when an empty line is omitted... we need to recheck.
-    if ((bufferSize == 0) || (currentBufferSize == bufferSize)) { 
-        bufferSize += 64; 
-        newBuffer = realloc(buffer, bufferSize); 
-        if (!newBuffer) { 
-            fprintf(stderr, "%s: Error realloc memory!\n", name);	
-            free(buffer);
-            cleanUp();
-            exit(EXIT_FAILURE);
-        } 
-        buffer = newBuffer; 
-    } 
-
-    buffer[currentBufferSize] = '\0';
-    *pnt = buffer; 	
-    return currentBufferSize;
-
-}
-
-/**
- * @brief Validates the first line of a response header.
- * @details This function goes through the first line of a response Header and will check if it complies with requirements given for this task. 
- * @param pnt A pointer pointing to the first Line of a response Header.
- * @return 0 if header is ok, 1 if header does not conform
- */
-int checkFirstLine(char *line) {
+        int value = 0;
+        for (int k = 1; k <= 2; k++) {
+            char ch = (i + k < len) ? src[i+k] : '\0';
+            int digit = (ch >= '0' && ch <= '9') ? ch - '0' : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 :
+                        (ch >= 'A' && ch <= 'F') ? ch - 'A' + 10 : -1;
+            if (digit < 0)
+                return -1;
+            value = value * 16 + digit;
+        }
+        if (value == 0)
+            return -1;
+        dst[n++] = value;
+        i += 2;
+    }
+    for (int start = 0; start < n; start++) { // start of a segment, after a slash
+        if (dst[start] == '/')
+            continue;
+        int end = start;
+        while (end < n && dst[end] != '/')
+            end++;
+        if (end - start == 2 && dst[start] == '.' && dst[start+1] == '.')
+            return -1;
+        start = end;
+    }
+    return n;
+}
+
+/**
+ * @brief Validates the first line of a request header.
+ * @details This function goes through the first line of a request Header and will check if it complies with requirements given for this task.
+ * On success the request target is stored in req->url and the file system path of the requested file in req->path.
+ * Internal endpoints and targets of a dynamic handler have no path. A folder without index file is marked with req->isDir, one requested without
+ * the trailing slash is redirected (301).
+ * @param req The request being parsed.
+ * @param line A pointer pointing to the first Line of a request Header.
+ * @return 0 if header is ok, the HTTP status code to answer with otherwise
+ */
+int parseRequestLine(struct request *req, char *line) {
 
     int lineLen = strlen(line);
     // Check if begin of line equals "GET"
-    char get[5];
-    memcpy(get, &line[0], 4);
-    get[4] = '\0';
-    if((strcmp(get, "GET ")) != 0) {
-        resStatusCode = "501 ";
-        resMsg  = "(Not implemented)\r\n";
-        return -1;
-    }
+    if (strncmp(line, "GET ", 4) != 0)
+        return 501;
 
     // Check if reqestPath exists.
-    if((strncmp(line+4, "/", 1)) != 0) {
-        resStatusCode = "400 ";
-        resMsg  = "(Bad Request)\r\n";
-        return -1;
-    }
+    if ((lineLen < 14) || (line[4] != '/'))
+        return 400;
 
     // Check if end of line equals "HTTP/1.1"
-    char HTTPVersion[10];
-    memcpy(HTTPVersion, &line[lineLen-9], 9);
-    HTTPVersion[9] = '\0';
-    if((strcmp(HTTPVersion, " HTTP/1.1")) != 0) {
-        resStatusCode = "400 ";
-        resMsg  = "(Bad Request)\r\n";
-        return -1;
-    }
+    if (strcmp(&line[lineLen-9], " HTTP/1.1") != 0)
+        return 400;
+
+    char *reqUrl = line + 4;
+    int reqUrlLen = lineLen - 9 - 4;
+    reqUrl[reqUrlLen] = '\0';
+    req->url = reqUrl;
+    if (strcmp(reqUrl, STATS_PATH) == 0)
+        return 0;
+    req->handler = handlerLookup(reqUrl);
+    if (req->handler != NULL)
+        return 0;
 
-    reqUrl = strndup(line+4, lineLen-9-4);
-    if(reqUrl == NULL) {
+    int docRootLen = strlen(docRoot);
+    req->path = (char *)malloc(docRootLen + reqUrlLen + strlen(indexFileDefault) + 1);
+    if(req->path == NULL) {
         fprintf(stderr, "%s: Memory error!\n", name);
         cleanUp();
         exit(EXIT_FAILURE);
     }
+    memcpy(req->path, docRoot, docRootLen);
+    int pathLen = decodePath(req->path + docRootLen, reqUrl, reqUrlLen);
+    if (pathLen < 0)
+        return 400;
+    pathLen += docRootLen;
+    req->path[pathLen] = '\0';
 
-    int reqUrlLen = strlen(reqUrl);
-    int reqPathLen = strlen(docRoot); 
+    struct stat path_stat;
     if(reqUrl[reqUrlLen-1] == '/') { // /folder/
-        indexFile = indexFileDefault;
-        reqPathLen += reqUrlLen;
-        reqPathLen += strlen(indexFile);
-    } else { // /file
-        indexFile = reqUrl;
-        reqPathLen += reqUrlLen;
-    }
-    reqPath = (char *)malloc(reqPathLen+1);
-    if(reqPath == NULL) {
+        strcpy(req->path + pathLen, indexFileDefault);
+        if (access(req->path, R_OK) == 0 && stat(req->path, &path_stat) == 0 && !S_ISDIR(path_stat.st_mode))
+            return 0;
+        req->path[pathLen] = '\0'; // no index file, list the folder instead
+        if (access(req->path, R_OK | X_OK) == -1 || stat(req->path, &path_stat) < 0 || !S_ISDIR(path_stat.st_mode))
+            return 404;
+        req->isDir = 1;
+        return 0;
+    }
+
+    if (access(req->path, R_OK) == -1) // cannor read it
+        return 404;
+
+    if (stat(req->path, &path_stat) < 0)
+        return 404;
+    if (S_ISDIR(path_stat.st_mode)) // folder without trailing slash, relative links of a listing need it
+        return 301;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the value of a header line if it carries the given field.
+ * @details Field names are compared case insensitive, leading whitespace of the value is skipped.
+ * @param line A request header line without the line break.
+ * @param field The header field name without the colon.
+ * @return Pointer into line where the value starts, NULL if the line holds another field.
+ */
+char *headerValue(char *line, const char *field) {
+    size_t fieldLen = strlen(field);
+    if ((strncasecmp(line, field, fieldLen) != 0) || (line[fieldLen] != ':'))
+        return NULL;
+    line += fieldLen + 1;
+    while (*line == ' ' || *line == '\t')
+        line++;
+    return line;
+}
+
+
+/**
+ * @brief Remembers the request headers the server acts upon.
+ * @details Every header line after the first one is passed here. Unknown fields are ignored.
+ * @param req The request being parsed.
+ * @param line A request header line without the line break.
+ * @return void
+ */
+void parseHeaderLine(struct request *req, char *line) {
+    char *value;
+
+    if ((value = headerValue(line, "Range")) != NULL)
+        req->range = value;
+    else if ((value = headerValue(line, "If-Range")) != NULL)
+        req->ifRange = value;
+    else if ((value = headerValue(line, "If-None-Match")) != NULL)
+        req->ifNoneMatch = value;
+    else if ((value = headerValue(line, "If-Modified-Since")) != NULL)
+        req->ifModifiedSince = value;
+    else if ((value = headerValue(line, "Accept-Encoding")) != NULL)
+        req->acceptEncoding = value;
+    else if ((value = headerValue(line, "Connection")) != NULL && strcasecmp(value, "close") == 0)
+        req->keepAlive = 0;
+}
+
+/**
+ * @brief Formats a timestamp as IMF-fixdate.
+ * @param t The time to format.
+ * @param buf Destination buffer.
+ * @param bufLen Size of the destination buffer, 30 bytes are sufficient.
+ * @return void
+ */
+void httpDate(time_t t, char *buf, size_t bufLen) {
+    struct tm tm_info;
+    gmtime_r(&t, &tm_info);
+    strftime(buf, bufLen, "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+}
+
+/**
+ * @brief Parses an IMF-fixdate.
+ * @param s The date string sent by the client.
+ * @return The timestamp or -1 if the string is not a valid date.
+ */
+time_t parseHttpDate(const char *s) {
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    char *end = strptime(s, "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+    if (end == NULL || *end != '\0')
+        return -1;
+    return timegm(&tm_info);
+}
+
+/**
+ * @brief Builds the entity tag of a file.
+ * @details The tag is derived from inode, size and modification time, so it changes whenever the file is replaced or written.
+ * @param st stat result of the file.
+ * @param buf Destination buffer.
+ * @param bufLen Size of the destination buffer, 64 bytes are sufficient.
+ * @return void
+ */
+void buildETag(const struct stat *st, char *buf, size_t bufLen) {
+    unsigned long long mtime = (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec;
+    snprintf(buf, bufLen, "\"%llx-%llx-%llx\"", (unsigned long long)st->st_ino, (unsigned long long)st->st_size, mtime);
+}
+
+/**
+ * @brief Checks if an If-None-Match list contains the given entity tag.
+ * @details Uses the weak comparison, so "W/" prefixes are ignored. A "*" matches every existing file.
+ * @param list Value of the If-None-Match header.
+ * @param etag The current entity tag of the file.
+ * @return 1 if the tag is listed, 0 otherwise.
+ */
+int etagListMatches(const char *list, const char *etag) {
+    size_t etagLen = strlen(etag);
+    for (;;) {
+        while (*list == ' ' || *list == '\t' || *list == ',')
+            list++;
+        if (*list == '\0')
+            return 0;
+        if (*list == '*')
+            return 1;
+        if (strncmp(list, "W/", 2) == 0)
+            list += 2;
+        const char *end = list;
+        if (*end == '"') {
+            end = strchr(end + 1, '"');
+            if (end == NULL)
+                return 0;
+            end++;
+        } else {
+            while (*end != '\0' && *end != ',')
+                end++;
+        }
+        if ((size_t)(end - list) == etagLen && strncmp(list, etag, etagLen) == 0)
+            return 1;
+        list = end;
+    }
+}
+
+
+/**
+ * @brief Evaluates If-None-Match and If-Modified-Since.
+ * @details If-Modified-Since is only considered when no If-None-Match was sent.
+ * @param req The request.
+ * @param st stat result of the requested file.
+ * @param etag The current entity tag of the file.
+ * @return 1 if the client copy is still valid and 304 should be sent, 0 otherwise.
+ */
+int notModified(const struct request *req, const struct stat *st, const char *etag) {
+    if (req->ifNoneMatch != NULL)
+        return etagListMatches(req->ifNoneMatch, etag);
+    if (req->ifModifiedSince != NULL) {
+        time_t since = parseHttpDate(req->ifModifiedSince);
+        return (since != -1) && (st->st_mtime <= since);
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses the value of a Range header.
+ * @details Only the "bytes" unit is understood. Ranges that start behind the end of the file are dropped,
+ * the remaining ones are clipped to the file size. Suffix ranges ("-500") address the last bytes of the file.
+ * @param spec Value of the Range header.
+ * @param size Size of the requested file.
+ * @param ranges Array receiving at most MAX_RANGES ranges.
+ * @return Number of satisfiable ranges, 0 if the header has to be ignored, -1 if no range is satisfiable.
+ */
+int parseRange(const char *spec, off_t size, struct byteRange *ranges) {
+    int count = 0;
+    int specs = 0;
+
+    if (strncasecmp(spec, "bytes=", 6) != 0)
+        return 0;
+    spec += 6;
+
+    for (;;) {
+        char *end;
+        long long first = -1;
+        long long last = -1;
+
+        while (*spec == ' ' || *spec == '\t')
+            spec++;
+        if (*spec >= '0' && *spec <= '9') {
+            errno = 0;
+            first = strtoll(spec, &end, 10);
+            if (errno != 0)
+                return 0;
+            spec = end;
+        }
+        if (*spec++ != '-')
+            return 0;
+        if (*spec >= '0' && *spec <= '9') {
+            errno = 0;
+            last = strtoll(spec, &end, 10);
+            if (errno != 0)
+                return 0;
+            spec = end;
+        }
+        while (*spec == ' ' || *spec == '\t')
+            spec++;
+
+        if (first < 0 && last < 0)
+            return 0;
+        if (first >= 0 && last >= 0 && last < first)
+            return 0;
+        if (++specs > MAX_RANGES)
+            return 0;
+
+        if (first < 0) { // suffix range
+            if (last > 0 && size > 0) {
+                ranges[count].first = (last >= size) ? 0 : size - last;
+                ranges[count].last = size - 1;
+                count++;
+            }
+        } else if (first < size) {
+            ranges[count].first = first;
+            ranges[count].last = (last < 0 || last >= size) ? size - 1 : last;
+            count++;
+        }
+
+        if (*spec == '\0')
+            break;
+        if (*spec++ != ',')
+            return 0;
+    }
+
+    return (count == 0) ? -1 : count;
+}
+
+
+/**
+ * @brief Looks up the media type of a file by its extension.
+ * @param path path of the file.
+ * @return the table entry, NULL if the extension is unknown.
+ */
+const struct mimeType *lookupMimeType(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *dot = strrchr(path, '.');
+    if (dot == NULL || (slash != NULL && dot < slash))
+        return NULL;
+    for (const struct mimeType *m = mimeTypes; m->ext != NULL; m++) {
+        if (strcasecmp(dot + 1, m->ext) == 0)
+            return m;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads the quality values of the codings the server can produce from Accept-Encoding.
+ * @details Codings that are not listed get the quality of "*" if present, 0 otherwise.
+ * @param accept Value of the Accept-Encoding header.
+ * @param qGzip receives the quality of gzip in thousandths.
+ * @param qBr receives the quality of br in thousandths.
+ * @return void
+ */
+void parseAcceptEncoding(const char *accept, int *qGzip, int *qBr) {
+    int qStar = -1;
+    *qGzip = -1;
+    *qBr = -1;
+
+    while (*accept != '\0') {
+        while (*accept == ' ' || *accept == '\t' || *accept == ',')
+            accept++;
+        const char *token = accept;
+        while (*accept != '\0' && *accept != ',' && *accept != ';' && *accept != ' ' && *accept != '\t')
+            accept++;
+        size_t tokenLen = accept - token;
+        if (tokenLen == 0)
+            break;
+
+        int q = 1000;
+        while (*accept == ' ' || *accept == '\t')
+            accept++;
+        if (*accept == ';') {
+            accept++;
+            while (*accept == ' ' || *accept == '\t')
+                accept++;
+            if (strncasecmp(accept, "q=", 2) == 0)
+                q = (int)(strtod(accept + 2, NULL) * 1000 + 0.5);
+            while (*accept != '\0' && *accept != ',')
+                accept++;
+        }
+
+        if (tokenLen == 4 && (strncasecmp(token, "gzip", 4) == 0))
+            *qGzip = q;
+        else if (tokenLen == 6 && (strncasecmp(token, "x-gzip", 6) == 0))
+            *qGzip = q;
+        else if (tokenLen == 2 && (strncasecmp(token, "br", 2) == 0))
+            *qBr = q;
+        else if (tokenLen == 1 && token[0] == '*')
+            qStar = q;
+    }
+
+    if (*qGzip < 0)
+        *qGzip = (qStar < 0) ? 0 : qStar;
+    if (*qBr < 0)
+        *qBr = (qStar < 0) ? 0 : qStar;
+}
+
+/**
+ * @brief Opens the pre-compressed sibling of a file (e.g. "style.css.br").
+ * @details The sibling is ignored if it is older than the file, it is most likely stale then.
+ * @param path path of the uncompressed file.
+ * @param st stat result of the uncompressed file.
+ * @param encoding ENC_GZIP or ENC_BR.
+ * @param sst receives the stat result of the sibling.
+ * @return descriptor of the sibling or -1 if there is no usable one.
+ */
+int openSibling(const char *path, const struct stat *st, int encoding, struct stat *sst) {
+    const char *suffix = encodingSuffix(encoding);
+    size_t pathLen = strlen(path);
+    char siblingPath[pathLen + strlen(suffix) + 1];
+    memcpy(siblingPath, path, pathLen);
+    strcpy(siblingPath + pathLen, suffix);
+
+    int fd = open(siblingPath, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, sst) < 0 || !S_ISREG(sst->st_mode) ||
+        (sst->st_mtim.tv_sec < st->st_mtim.tv_sec) ||
+        (sst->st_mtim.tv_sec == st->st_mtim.tv_sec && sst->st_mtim.tv_nsec < st->st_mtim.tv_nsec)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/**
+ * @brief Reason phrase of a status code.
+ * @param status HTTP status code.
+ * @return the status line text following the code.
+ */
+const char *statusText(int status) {
+    switch (status) {
+        case 200:
+            return "OK";
+        case 301:
+            return "Moved Permanently";
+        case 206:
+            return "Partial Content";
+        case 304:
+            return "Not Modified";
+        case 400:
+            return "(Bad Request)";
+        case 404:
+            return "(Not Found)";
+        case 416:
+            return "Range Not Satisfiable";
+        case 431:
+            return "Request Header Fields Too Large";
+        case 501:
+            return "(Not implemented)";
+        case 503:
+            return "Service Unavailable";
+        default:
+            return "(Internal Server Error)";
+    }
+}
+
+/**
+ * @brief Appends a memory segment to the response of a connection.
+ * @param c the connection.
+ * @param data bytes to send.
+ * @param len number of bytes.
+ * @param copy 1 to copy the bytes, 0 if they stay valid until the response is finished.
+ * @return void
+ */
+void queueData(struct connection *c, const char *data, size_t len, int copy) {
+    struct segment *s = malloc(sizeof(struct segment) + (copy ? len : 0));
+    if (s == NULL) {
         fprintf(stderr, "%s: Memory error!\n", name);
-        free(reqUrl);
-        reqUrl = NULL;
         cleanUp();
         exit(EXIT_FAILURE);
     }
-    memset(reqPath, 0, reqPathLen+1);
-    memcpy(reqPath, docRoot, strlen(docRoot));
-    if(reqUrl[reqUrlLen-1] == '/') {
-        memcpy(reqPath+strlen(docRoot), reqUrl, reqUrlLen);
-        memcpy(reqPath+strlen(docRoot)+reqUrlLen, indexFile, strlen(indexFile));
-    } else {
-        memcpy(reqPath+strlen(docRoot), indexFile, strlen(indexFile));
+    if (copy) {
+        memcpy(s->buf, data, len);
+        data = s->buf;
     }
+    s->next = NULL;
+    s->data = data;
+    s->fd = -1;
+    s->off = 0;
+    s->len = len;
+    if (c->outTail != NULL)
+        c->outTail->next = s;
+    else
+        c->out = s;
+    c->outTail = s;
+}
 
-    free(reqUrl);
+/**
+ * @brief Appends a file range to the response of a connection.
+ * @param c the connection.
+ * @param fd file to send, has to stay open until the response is finished.
+ * @param offset offset of the first byte to send.
+ * @param len number of bytes to send.
+ * @return void
+ */
+void queueFile(struct connection *c, int fd, off_t offset, off_t len) {
+    queueData(c, NULL, 0, 0);
+    c->outTail->data = NULL;
+    c->outTail->fd = fd;
+    c->outTail->off = offset;
+    c->outTail->len = len;
+}
 
-    if (access(reqPath, R_OK) == -1) { // cannor read it
-        resStatusCode = "404 ";
-        resMsg = "(Not Found)\r\n";
-        return -1;
+/**
+ * @brief Appends a part of the selected representation to the response.
+ * @param c the connection.
+ * @param body the representation.
+ * @param offset offset of the first byte to send.
+ * @param len number of bytes to send.
+ * @return void
+ */
+void queueBodyRange(struct connection *c, const struct responseBody *body, off_t offset, off_t len) {
+    if (body->data != NULL)
+        queueData(c, (const char *)body->data + offset, len, 0);
+    else
+        queueFile(c, body->fd, offset, len);
+}
+
+/**
+ * @brief Appends the response header.
+ * @details The status line is built from the status code, a Date and, if the connection is closed afterwards, the Connection header are added.
+ * @param c the connection.
+ * @param status HTTP status code.
+ * @param fields Additional header fields, each terminated by CRLF.
+ * @return void
+ */
+void queueHeader(struct connection *c, int status, const char *fields) {
+    c->status = status;
+    char date[32];
+    httpDate(time(NULL), date, sizeof(date));
+    const char *conClose = c->keepAlive ? "" : "Connection: Close\r\n";
+
+    int resHeaderLen = snprintf(NULL, 0, "HTTP/1.1 %d %s\r\nDate: %s\r\n%s%s\r\n", status, statusText(status), date, fields, conClose);
+    char resHeader[resHeaderLen + 1];
+    snprintf(resHeader, resHeaderLen+1, "HTTP/1.1 %d %s\r\nDate: %s\r\n%s%s\r\n", status, statusText(status), date, fields, conClose);
+    queueData(c, resHeader, resHeaderLen, 1);
+}
+
+/**
+ * @brief Builds the response listing a directory.
+ * @details A cached listing is sent directly, otherwise it is rendered chunk by chunk by flushConnection().
+ * @param c the connection.
+ * @param req the parsed request.
+ * @return void
+ */
+void queueDirResponse(struct connection *c, const struct request *req) {
+    struct stat st;
+    if (stat(req->path, &st) == 0) {
+        c->listing = dirCacheGet(req->path, &st);
+        if (c->listing == NULL)
+            c->dirStream = dirStreamOpen(req->path, req->url, &st);
+    }
+    if (c->listing == NULL && c->dirStream == NULL) {
+        fprintf(stderr, "%s: Error reading directory!\n", name);
+        c->keepAlive = 0;
+        queueHeader(c, 500, "Content-Length: 0\r\n");
+        return;
     }
+    queueHeader(c, 200, "Content-Type: text/html; charset=utf-8\r\nTransfer-Encoding: chunked\r\n");
+    if (c->listing != NULL)
+        queueData(c, c->listing->data, c->listing->len, 0);
+}
 
-    struct stat path_stat;
-    stat(reqPath, &path_stat);
-    if(S_ISDIR(path_stat.st_mode)) { // can read it but is a folder
-        resStatusCode = "404 ";
-        resMsg = "(Not Found)\r\n";
-        return -1;
+/**
+ * @brief Builds the response for the requested file.
+ * @details The representation is chosen by Accept-Encoding: a pre-compressed ".br" or ".gz" sibling is preferred,
+ * compressible text is otherwise compressed once into the file cache in the background and sent as is until then,
+ * everything else is sent as is.
+ * If the client copy is still valid only 304 is sent. Otherwise, depending on the Range and If-Range
+ * headers the whole representation (200), a single range (206), several ranges as multipart/byteranges (206)
+ * or an unsatisfiable range error (416) is sent. The body is sent later by flushConnection().
+ * @param c the connection.
+ * @param req the parsed request.
+ * @return void
+ */
+void queueFileResponse(struct connection *c, const struct request *req) {
+    // Not a 404 because we allready check existance and accesability in in parseRequestLine
+    int fd = open(req->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: Error reading file!\n", name);
+        if (fd >= 0)
+            close(fd);
+        c->keepAlive = 0;
+        queueHeader(c, 500, "Content-Length: 0\r\n");
+        return;
+    }
+    c->fileFd = fd;
+
+    const struct mimeType *mime = lookupMimeType(req->path);
+    const char *type = (mime != NULL) ? mime->type : "application/octet-stream";
+    int compressible = (mime != NULL) && mime->compressible;
+
+    // select the representation
+    struct responseBody body = { fd, NULL, st.st_size, ENC_IDENTITY };
+    int qGzip = 0;
+    int qBr = 0;
+    if (req->acceptEncoding != NULL)
+        parseAcceptEncoding(req->acceptEncoding, &qGzip, &qBr);
+    int preferred[2] = { ENC_BR, ENC_GZIP };
+    if (qGzip > qBr) {
+        preferred[0] = ENC_GZIP;
+        preferred[1] = ENC_BR;
+    }
+    for (int i = 0; i < 2 && body.encoding == ENC_IDENTITY; i++) {
+        int enc = preferred[i];
+        if (((enc == ENC_BR) ? qBr : qGzip) <= 0)
+            continue;
+        struct stat sst;
+        if ((c->siblingFd = openSibling(req->path, &st, enc, &sst)) >= 0) {
+            body.fd = c->siblingFd;
+            body.size = sst.st_size;
+            body.encoding = enc;
+        } else if (compressible && (c->cached = cacheGetCompressed(req->path, &st, enc)) != NULL) {
+            body.data = c->cached->data;
+            body.size = c->cached->len;
+            body.encoding = enc;
+        }
+    }
+    off_t size = body.size;
+
+    char etag[64];
+    char lastModified[32];
+    char validators[256];
+    buildETag(&st, etag, sizeof(etag));
+    if (body.encoding != ENC_IDENTITY) // every representation needs its own tag
+        snprintf(etag + strlen(etag) - 1, sizeof(etag) - strlen(etag) + 1, "-%s\"", encodingName(body.encoding));
+    httpDate(st.st_mtime, lastModified, sizeof(lastModified));
+    snprintf(validators, sizeof(validators), "ETag: %s\r\nLast-Modified: %s\r\n%s", etag, lastModified,
+            compressible || body.encoding != ENC_IDENTITY ? "Vary: Accept-Encoding\r\n" : "");
+
+    char representation[160];
+    if (body.encoding != ENC_IDENTITY)
+        snprintf(representation, sizeof(representation), "Content-Type: %s\r\nContent-Encoding: %s\r\n", type, encodingName(body.encoding));
+    else
+        snprintf(representation, sizeof(representation), "Content-Type: %s\r\n", type);
+
+    struct byteRange ranges[MAX_RANGES];
+    int rangeCount = 0;
+    if (req->range != NULL) {
+        // a stale If-Range validator means the client wants the whole new file
+        if (req->ifRange == NULL || strcmp(req->ifRange, etag) == 0 || strcmp(req->ifRange, lastModified) == 0)
+            rangeCount = parseRange(req->range, size, ranges);
     }
 
+    char fields[1024];
+
+    if (notModified(req, &st, etag)) {
+        queueHeader(c, 304, validators);
+    } else if (rangeCount < 0) {
+        snprintf(fields, sizeof(fields), "Content-Range: bytes */%lld\r\nContent-Length: 0\r\n", (long long)size);
+        queueHeader(c, 416, fields);
+    } else if (rangeCount == 1) {
+        snprintf(fields, sizeof(fields), "%s%sAccept-Ranges: bytes\r\nContent-Range: bytes %lld-%lld/%lld\r\nContent-Length: %lld\r\n",
+                validators, representation, (long long)ranges[0].first, (long long)ranges[0].last, (long long)size,
+                (long long)(ranges[0].last - ranges[0].first + 1));
+        queueHeader(c, 206, fields);
+        queueBodyRange(c, &body, ranges[0].first, ranges[0].last - ranges[0].first + 1);
+    } else if (rangeCount > 1) {
+        char partHeader[MAX_RANGES][192];
+        int partHeaderLen[MAX_RANGES];
+        const char *closing = "\r\n--" BOUNDARY "--\r\n";
+        long long contentLen = strlen(closing);
+        for (int i = 0; i < rangeCount; i++) {
+            partHeaderLen[i] = snprintf(partHeader[i], sizeof(partHeader[i]),
+                    "\r\n--" BOUNDARY "\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                    type, (long long)ranges[i].first, (long long)ranges[i].last, (long long)size);
+            contentLen += partHeaderLen[i] + (ranges[i].last - ranges[i].first + 1);
+        }
+
+        snprintf(fields, sizeof(fields), "%s%sAccept-Ranges: bytes\r\nContent-Type: multipart/byteranges; boundary=" BOUNDARY "\r\nContent-Length: %lld\r\n",
+                validators, (body.encoding != ENC_IDENTITY) ? strstr(representation, "Content-Encoding") : "", contentLen);
+        queueHeader(c, 206, fields);
+        for (int i = 0; i < rangeCount; i++) {
+            queueData(c, partHeader[i], partHeaderLen[i], 1);
+            queueBodyRange(c, &body, ranges[i].first, ranges[i].last - ranges[i].first + 1);
+        }
+        queueData(c, closing, strlen(closing), 0);
+    } else {
+        snprintf(fields, sizeof(fields), "%s%sAccept-Ranges: bytes\r\nContent-Length: %lld\r\n", validators, representation, (long long)size);
+        queueHeader(c, 200, fields);
+        queueBodyRange(c, &body, 0, size);
+    }
+}
+
+/**
+ * @brief Checks if a connection comes from the local host.
+ * @param c the connection.
+ * @return 1 for loopback clients, 0 otherwise.
+ */
+int isLoopback(const struct connection *c) {
+    if (c->peer.ss_family == AF_INET) {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)&c->peer;
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (c->peer.ss_family == AF_INET6) {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)&c->peer;
+        return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+    }
     return 0;
 }
 
 /**
- * Program entry point.
- * @brief Program starts here.
- * @details The Program will first handle and validate all arguments and will then start offering its service.
- * The server can be stopped by SIGINT, SIGTERM.
- * @param argc The argument counter.
- * @param argv The argument vector.
- * @return Returns EXIT_SUCCESS.
+ * @brief Builds the response of the internal statistics endpoint.
+ * @details Only local clients may read the statistics, everybody else gets 404.
+ * @param c the connection.
+ * @return void
  */
-int main (int argc, char **argv) {
-    int con;
-    name = argv[0];
+void queueStatsResponse(struct connection *c) {
+    if (!isLoopback(c)) {
+        queueHeader(c, 404, "Content-Length: 0\r\n");
+        return;
+    }
 
-    readArgs(argc, argv);
-    validateArgs();
-    createConnection();
+    struct statsBlock *blocks[workerCount];
+    for (int i = 0; i < workerCount; i++)
+        blocks[i] = &workers[i].stats;
+    size_t len = 0;
+    char *text = statsRender(blocks, workerCount, &len);
+    if (text == NULL) {
+        fprintf(stderr, "%s: Memory error!\n", name);
+        queueHeader(c, 500, "Content-Length: 0\r\n");
+        return;
+    }
 
-    struct sigaction action;
-    memset(&action, 0, sizeof(struct sigaction));
-    action.sa_handler = term;
-    sigaction(SIGTERM, &action, NULL);
+    char fields[160];
+    snprintf(fields, sizeof(fields), "Content-Type: text/plain; version=0.0.4\r\nCache-Control: no-store\r\nContent-Length: %zu\r\n", len);
+    queueHeader(c, 200, fields);
+    queueData(c, text, len, 1);
+    free(text);
+}
 
-    while(!done) {
-        cleanUp();
-        con = accept(sockfd, NULL, NULL);
+/**
+ * @brief Changes the epoll events a connection is registered for.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @param events EPOLLIN or EPOLLOUT.
+ * @return void
+ */
+void setInterest(struct worker *w, struct connection *c, uint32_t events) {
+    if (c->events == events)
+        return;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
 
-        if(con < 0) {
-            fprintf(stderr,"%s: Error starting network service!\n", name);
-            cleanUp();
-            exit(EXIT_FAILURE);
-        }
+/**
+ * @brief Frees the segments and descriptors of the current response.
+ * @param c the connection.
+ * @return void
+ */
+void releaseResponse(struct connection *c) {
+    while (c->out != NULL) {
+        struct segment *s = c->out;
+        c->out = s->next;
+        free(s);
+    }
+    c->outTail = NULL;
+    cacheRelease(c->cached);
+    c->cached = NULL;
+    dirCacheRelease(c->listing);
+    c->listing = NULL;
+    dirStreamClose(c->dirStream);
+    c->dirStream = NULL;
+    if (c->job != NULL && c->state == CONN_HANDLER)
+        c->job->conn = NULL; // still on the pool, freed when it comes back
+    else
+        handlerJobFree(c->job);
+    c->job = NULL;
+    if (c->siblingFd >= 0)
+        close(c->siblingFd);
+    c->siblingFd = -1;
+    if (c->fileFd >= 0)
+        close(c->fileFd);
+    c->fileFd = -1;
+}
 
-        char *line = NULL;
-        int linelen = 0;
-        int firstLine = 0;
-        int headerError = 0;
+/**
+ * @brief Hands the current response to the access log.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @param aborted 1 if the response could not be sent completely.
+ * @return void
+ */
+void logResponse(struct worker *w, struct connection *c, int aborted) {
+    if (w->log == NULL)
+        return;
+    struct logRecord rec;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec.timeUs = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    rec.latencyUs = nowUs() - c->reqStart;
+    rec.bytes = c->bytesSent;
+    rec.peer = c->peer;
+    rec.status = c->status;
+    rec.aborted = aborted;
+    rec.worker = w->index;
+    memcpy(rec.method, c->method, sizeof(rec.method));
+    memcpy(rec.url, c->url, sizeof(rec.url));
+    accessLogWrite(w->log, &rec);
+}
 
-        for(;;) { // Read Request
-            if ((linelen = fgetline(con, &line)) < 1) {
-                break;
+/**
+ * @brief Closes a connection and frees all its resources.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return void
+ */
+void closeConnection(struct worker *w, struct connection *c) {
+    if (c->state == CONN_SEND || c->state == CONN_HANDLER) {
+        STATS_ADD(w->stats.responsesAborted, 1);
+        logResponse(w, c, 1);
+    }
+    STATS_ADD(w->stats.connectionsOpen, -1);
+    wheelDel(&w->wheel, &c->timer);
+    releaseResponse(c);
+    if (c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        w->conns = c->next;
+    if (c->next != NULL)
+        c->next->prev = c->prev;
+    close(c->fd); // also removes it from epoll
+    free(c->in);
+    free(c);
+}
+
+/**
+ * @brief Sends as much of the pending response as the socket accepts.
+ * @details Consecutive memory segments are sent with one writev(), file segments with sendfile().
+ * A directory listing is rendered one chunk at a time whenever the queue ran empty.
+ * Every progress pushes the send deadline further.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return 0 if the response is complete, 1 if the socket is full, -1 on error.
+ */
+int flushConnection(struct worker *w, struct connection *c) {
+    int progress = 0;
+    int ret = 0;
+
+    while (c->out != NULL || c->dirStream != NULL) {
+        if (c->out == NULL) { // render the next chunk of a listing once the previous one is sent
+            struct segment *chunk = malloc(sizeof(struct segment) + DIR_CHUNK_MAX);
+            ssize_t len = (chunk != NULL) ? dirStreamRead(c->dirStream, chunk->buf) : -1;
+            if (len <= 0) {
+                free(chunk);
+                dirStreamClose(c->dirStream);
+                c->dirStream = NULL;
+                if (len < 0) {
+                    ret = -1;
+                    break;
+                }
+                continue;
             }
-            if (firstLine == 0) {
-                headerError = checkFirstLine(line);
-                firstLine = 1;
+            chunk->next = NULL;
+            chunk->data = chunk->buf;
+            chunk->fd = -1;
+            chunk->off = 0;
+            chunk->len = len;
+            c->out = c->outTail = chunk;
+        }
+        struct segment *s = c->out;
+        ssize_t n;
+
+        if (s->data != NULL) {
+            struct iovec iov[MAX_IOV];
+            int iovcnt = 0;
+            for (struct segment *i = s; i != NULL && i->data != NULL && iovcnt < MAX_IOV; i = i->next) {
+                iov[iovcnt].iov_base = (char *)i->data + i->off;
+                iov[iovcnt].iov_len = i->len;
+                iovcnt++;
             }
-            free(line);
-            line = NULL;
-        }
-        free(line);
-
-        if(headerError == -1) {
-
-            time_t t = time(NULL);
-            struct tm* tm_info;
-            int tBufLen = 40;
-            char date[tBufLen];
-            memset(date, 0, tBufLen+1);
-            tm_info = gmtime(&t);
-            strftime(date, 38, "Date: %a, %d %b %y %H:%M:%S GMT\r\n", tm_info);
-
-            char *HTTPVersion = "HTTP/1.1 ";
-            char *conClose = "Connection: Close\r\n\r\n";
-            int resHeaderLen = strlen(HTTPVersion) + strlen(resStatusCode) + strlen(resMsg) + strlen(date) + strlen(conClose);
-
-            resHeader = (char *)malloc(resHeaderLen+1);
-            if(resHeader == NULL) {
-                fprintf(stderr, "%s: Memory error!", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
+            n = writev(c->fd, iov, iovcnt);
+        } else {
+            n = sendfile(c->fd, s->fd, &s->off, s->len);
+            if (n == 0) { // file got shorter
+                ret = -1;
+                break;
             }
-            memset(resHeader, 0, resHeaderLen+1);
-            snprintf(resHeader, resHeaderLen+1, "%s%s%s%s%s", HTTPVersion, resStatusCode, resMsg, date, conClose);
-
-            //SEND HEADER
-            if (write(con, resHeader, strlen(resHeader)) != strlen(resHeader)) {
-                fprintf(stderr, "%s: Error while sending request.\n", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
+            if (n > 0) {
+                s->len -= n;
+                c->bytesSent += n;
+                n = 0; // already accounted
             }
+        }
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+            break;
+        }
+        progress = 1;
+        c->bytesSent += n;
+
+        // drop everything that has been sent
+        while (c->out != NULL && (n > 0 || c->out->len == 0)) {
+            s = c->out;
+            off_t take = (n < s->len) ? n : s->len;
+            s->off += (s->data != NULL) ? take : 0;
+            s->len -= take;
+            n -= take;
+            if (s->len > 0)
+                break;
+            c->out = s->next;
+            free(s);
+        }
+        if (c->out == NULL)
+            c->outTail = NULL;
+    }
 
-        } else {
-            //DATE
-            time_t t = time(NULL);
-            struct tm* tm_info;
-            int tBufLen = 40;
-            char date[tBufLen];
-            memset(date, 0, tBufLen+1);
-            tm_info = gmtime(&t);
-            strftime(date, 38, "Date: %a, %d %b %y %H:%M:%S GMT\r\n", tm_info);
-
-            //CONTENT LENGTH
-            // Not a 404 because we allready check existance and accesability in in checkFirstLine
-            FILE *f = fopen(reqPath, "rb");
-            if (f == NULL) {
-                fprintf(stderr, "%s: Error reading file!\n", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            }
+    if (progress && ret == 1)
+        wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)sendTimeout * 1000 / TICK_MS);
+    return ret;
+}
 
-            fseek( f, 0L, SEEK_END );
-            long contentLen = ftell(f); //should always be > 0 because checkFirstLine()
-            rewind(f);
-
-            int contentLenInt = snprintf( NULL, 0, "%ld", contentLen); // Assuming file is not larger then 3.2 MB
-            char resContentSize[(14 + contentLenInt + 3)];
-            memset(resContentSize, 0, 14 + contentLenInt + 3);
-            snprintf(resContentSize, (14 + contentLenInt + 3), "Content-Size: %ld\r\n", contentLen);
-
-            // OTHER
-            resStatusCode = "200 ";
-            resMsg = "OK\r\n";
-            char *HTTPVersion = "HTTP/1.1 ";
-            char *conClose = "Connection: Close\r\n\r\n";
-
-            // Build Header
-            int resHeaderLen = strlen(HTTPVersion) + strlen(resStatusCode) + strlen(resMsg) + strlen(date) + strlen(resContentSize) + strlen(conClose);
-            resHeader = (char *)malloc(resHeaderLen+1);
-            if(resHeader == NULL) {
-                fprintf(stderr, "%s: Memory error!", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            }
-            memset(resHeader, 0, resHeaderLen+1);
-            snprintf(resHeader, resHeaderLen+1, "%s%s%s%s%s%s", HTTPVersion, resStatusCode, resMsg, date, resContentSize, conClose);
-
-            //SEND HEADER
-            if (write(con, resHeader, strlen(resHeader)) != strlen(resHeader)) {
-                fprintf(stderr, "%s: Error while sending request.\n", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
+/**
+ * @brief Searches the received bytes for the end of the request header.
+ * @param c the connection.
+ * @return number of bytes of the header including the empty line, 0 if it is incomplete.
+ */
+size_t findHeaderEnd(struct connection *c) {
+    size_t i = (c->scanned > 2) ? c->scanned - 2 : 0;
+    for (; i < c->inLen; i++) {
+        if (c->in[i] != '\n')
+            continue;
+        if (i + 1 < c->inLen && c->in[i+1] == '\n')
+            return i + 2;
+        if (i + 2 < c->inLen && c->in[i+1] == '\r' && c->in[i+2] == '\n')
+            return i + 3;
+    }
+    c->scanned = c->inLen;
+    return 0;
+}
+
+/**
+ * @brief Parses a complete request header and queues the response.
+ * @details The header is split into lines in place. Empty lines in front of the request line are ignored.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @param headerLen length of the header in c->in.
+ * @return void
+ */
+void handleRequest(struct worker *w, struct connection *c, size_t headerLen) {
+    c->reqStart = nowUs();
+    c->bytesSent = 0;
+
+    struct request req;
+    memset(&req, 0, sizeof(req));
+    req.keepAlive = 1;
+
+    char *line = c->in;
+    char *end = c->in + headerLen;
+    int firstLine = 0;
+    int status = 0;
+    while (line < end) {
+        char *nl = memchr(line, '\n', end - line);
+        char *next = nl + 1;
+        if (nl > line && nl[-1] == '\r')
+            nl--;
+        *nl = '\0';
+        if (firstLine == 0) {
+            if (*line != '\0') {
+                if (w->log != NULL) {
+                    size_t methodLen = strcspn(line, " ");
+                    if (methodLen >= LOG_METHOD_MAX)
+                        methodLen = LOG_METHOD_MAX - 1;
+                    memcpy(c->method, line, methodLen);
+                    c->method[methodLen] = '\0';
+                }
+                status = parseRequestLine(&req, line);
+                firstLine = 1;
             }
+        } else if (*line != '\0') {
+            parseHeaderLine(&req, line);
+        }
+        line = next;
+    }
 
-            //READ FILE
-            char *resBody;
-            size_t n = 0;
-            int ch;
+    if (w->log != NULL) {
+        strncpy(c->url, (req.url != NULL) ? req.url : "-", LOG_URL_MAX - 1);
+        c->url[LOG_URL_MAX - 1] = '\0';
+    }
 
-            resBody = malloc(contentLen+1);
-            if(resBody == NULL) {
-                fprintf(stderr, "%s: Memory error!\n", name);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            }
+    c->keepAlive = req.keepAlive && !draining;
+    if (status == 0 && req.handler != NULL) {
+        c->job = handlerSubmit(req.handler, req.url, isLoopback(c), &w->completions);
+        if (c->job != NULL) {
+            c->job->conn = c;
+            c->state = CONN_HANDLER;
+        } else {
+            queueHeader(c, 503, "Retry-After: 1\r\nContent-Length: 0\r\n");
+        }
+    } else if (status == 0 && req.path == NULL) {
+        queueStatsResponse(c);
+    } else if (status == 0 && req.isDir) {
+        queueDirResponse(c, &req);
+    } else if (status == 0) {
+        queueFileResponse(c, &req);
+    } else if (status == 301) {
+        int fieldsLen = snprintf(NULL, 0, "Location: %s/\r\nContent-Length: 0\r\n", req.url);
+        char fields[fieldsLen + 1];
+        snprintf(fields, fieldsLen + 1, "Location: %s/\r\nContent-Length: 0\r\n", req.url);
+        queueHeader(c, status, fields);
+    } else {
+        if (status != 404) // the rest of the stream can not be trusted
+            c->keepAlive = 0;
+        queueHeader(c, status, "Content-Length: 0\r\n");
+    }
+    free(req.path);
+}
 
-            while((ch = fgetc(f)) != EOF) {
-                if(ch < 0) {
-                    fprintf(stderr,"%s: Error reading file!\n", name);
-                    free(resBody);
-                    cleanUp();
-                    exit(EXIT_FAILURE);
-                }
-                resBody[n++]  = (char)ch;
+/**
+ * @brief Completes a response and prepares the connection for the next request.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return 0 if the connection stays open, -1 if it has been closed.
+ */
+int finishResponse(struct worker *w, struct connection *c) {
+    statsRecordResponse(&w->stats, c->status, c->bytesSent, nowUs() - c->reqStart);
+    logResponse(w, c, 0);
+    releaseResponse(c);
+    c->state = CONN_IDLE;
+    if (!c->keepAlive || done) {
+        shutdown(c->fd, SHUT_WR);
+        closeConnection(w, c);
+        return -1;
+    }
+    if (c->inLen > 0) { // pipelined request, its header deadline starts now
+        c->state = CONN_READ_HEADER;
+        wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)headerTimeout * 1000 / TICK_MS);
+    } else if (draining) { // keep-alive was promised before the drain, give the client a chance to notice
+        c->state = CONN_IDLE;
+        wheelAdd(&w->wheel, &c->timer, nowTicks() + (DRAIN_GRACE_MS + TICK_MS - 1) / TICK_MS);
+    } else {
+        c->state = CONN_IDLE;
+        wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)idleTimeout * 1000 / TICK_MS);
+    }
+    setInterest(w, c, EPOLLIN);
+    return 0;
+}
+
+/**
+ * @brief Sends a queued response as far as the socket allows.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return 0 if the connection stays open, -1 if it has been closed.
+ */
+int startSending(struct worker *w, struct connection *c) {
+    c->state = CONN_SEND;
+    wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)sendTimeout * 1000 / TICK_MS);
+    int ret = flushConnection(w, c);
+    if (ret < 0) {
+        closeConnection(w, c);
+        return -1;
+    }
+    if (ret > 0) {
+        setInterest(w, c, EPOLLOUT);
+        return 0;
+    }
+    return finishResponse(w, c);
+}
+
+/**
+ * @brief Starts the next request of a connection if one is buffered, otherwise waits for one.
+ * @details Pipelined requests are served in order, one response at a time. While a dynamic handler runs
+ * the connection is not read from, its send deadline bounds the time the handler may take.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return 0 if the connection stays open, -1 if it has been closed.
+ */
+int processInput(struct worker *w, struct connection *c) {
+    while (c->state != CONN_SEND && c->state != CONN_HANDLER) {
+        size_t headerLen = findHeaderEnd(c);
+        if (headerLen == 0) {
+            if (c->inLen >= MAX_HEADER_SIZE) {
+                c->keepAlive = 0;
+                queueHeader(c, 431, "Content-Length: 0\r\n");
+                c->inLen = 0;
+            } else {
+                return 0;
             }
-            resBody[n]  = '\0';
-            fclose(f);
-
-            //SEND FILE
-            char* resBodyPnt = resBody;
-            ssize_t ret;
-            size_t toWrite = contentLen;
-            while(toWrite > 0) {
-                do {
-                    ret = write(con, resBodyPnt, toWrite);
-                } while ((ret < 0) && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK));
-                if(ret < 0) {
-                    fprintf(stderr,"%s: Error transmitting data!\n", name);
-                    free(resBody);
-                    cleanUp();
-                    exit(EXIT_FAILURE);
-                }
-                toWrite -= ret;
-                resBodyPnt += ret;
+        } else {
+            handleRequest(w, c, headerLen);
+            memmove(c->in, c->in + headerLen, c->inLen - headerLen);
+            c->inLen -= headerLen;
+        }
+        c->scanned = 0;
+
+        if (c->state == CONN_HANDLER) {
+            wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)sendTimeout * 1000 / TICK_MS);
+            setInterest(w, c, 0);
+            return 0;
+        }
+        if (startSending(w, c) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sends the responses of all dynamic handlers that finished for this worker.
+ * @details Jobs whose connection has been closed meanwhile are dropped. Sending may close a connection, so this runs
+ * after the events of a batch, none of which may refer to a freed connection.
+ * @param w the worker.
+ * @return void
+ */
+void completeHandlers(struct worker *w) {
+    struct handlerJob *next;
+    for (struct handlerJob *job = completionTake(&w->completions); job != NULL; job = next) {
+        next = job->next;
+        struct connection *c = job->conn;
+        if (c == NULL) {
+            handlerJobFree(job);
+            continue;
+        }
+        int fieldsLen = snprintf(NULL, 0, "Content-Type: %s\r\nCache-Control: no-store\r\nContent-Length: %zu\r\n",
+                                 job->result.contentType, job->result.len);
+        char fields[fieldsLen + 1];
+        snprintf(fields, fieldsLen + 1, "Content-Type: %s\r\nCache-Control: no-store\r\nContent-Length: %zu\r\n",
+                 job->result.contentType, job->result.len);
+        queueHeader(c, job->result.status, fields);
+        if (job->result.len > 0)
+            queueData(c, job->result.body, job->result.len, 0); // freed with the job by releaseResponse()
+        if (startSending(w, c) == 0 && c->state != CONN_SEND)
+            processInput(w, c);
+    }
+}
+
+/**
+ * @brief Reads request bytes and serves complete requests.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return void
+ */
+void onReadable(struct worker *w, struct connection *c) {
+    for (;;) {
+        if (c->inLen == c->inCap) {
+            if (c->inCap >= MAX_HEADER_SIZE)
+                break;
+            size_t newCap = (c->inCap == 0) ? 1024 : c->inCap * 2;
+            char *newIn = realloc(c->in, newCap);
+            if (newIn == NULL) {
+                fprintf(stderr, "%s: Error realloc memory!\n", name);
+                closeConnection(w, c);
+                return;
             }
+            c->in = newIn;
+            c->inCap = newCap;
+        }
+        ssize_t n = read(c->fd, c->in + c->inLen, c->inCap - c->inLen);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            closeConnection(w, c);
+            return;
+        }
+        if (n == 0) { // client closed the connection
+            closeConnection(w, c);
+            return;
+        }
+        if (c->state == CONN_IDLE) { // the header deadline starts with the first byte
+            c->state = CONN_READ_HEADER;
+            wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)headerTimeout * 1000 / TICK_MS);
+        }
+        c->inLen += n;
+    }
+    processInput(w, c);
+}
+
+/**
+ * @brief Continues sending a response once the socket has room again.
+ * @param w the worker of the connection.
+ * @param c the connection.
+ * @return void
+ */
+void onWritable(struct worker *w, struct connection *c) {
+    int ret = flushConnection(w, c);
+    if (ret < 0) {
+        closeConnection(w, c);
+    } else if (ret == 0) {
+        if (finishResponse(w, c) == 0)
+            processInput(w, c);
+    }
+}
+
+/**
+ * @brief Timer wheel callback, drops a connection that missed its deadline.
+ * @param t the timer of the connection.
+ * @param arg the worker.
+ * @return void
+ */
+void expireConnection(struct timer *t, void *arg) {
+    struct connection *c = (struct connection *)((char *)t - offsetof(struct connection, timer));
+    struct worker *w = arg;
+    STATS_ADD(w->stats.connectionsTimedOut, 1);
+    closeConnection(w, c);
+}
+
+/**
+ * @brief Accepts all pending connections.
+ * @param w the worker.
+ * @return void
+ */
+void acceptConnections(struct worker *w) {
+    for (;;) {
+        struct sockaddr_storage peer;
+        socklen_t peerLen = sizeof(peer);
+        int con = accept4(sockfd, (struct sockaddr *)&peer, &peerLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (con < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                fprintf(stderr,"%s: Error accepting connection: %s\n", name, strerror(errno));
+            return;
+        }
+
+        struct connection *c = calloc(1, sizeof(struct connection));
+        if (c == NULL) {
+            fprintf(stderr, "%s: Memory error!\n", name);
+            close(con);
+            return;
+        }
+        // the header and the sendfile() body are separate writes, Nagle would hold the body back for the delayed ACK
+        int one = 1;
+        setsockopt(con, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        c->fd = con;
+        c->peer = peer;
+        c->fileFd = -1;
+        c->siblingFd = -1;
+        c->state = CONN_READ_HEADER;
+        c->events = EPOLLIN;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, con, &ev) < 0) {
+            fprintf(stderr, "%s: Error registering connection!\n", name);
+            close(con);
+            free(c);
+            continue;
+        }
+        c->next = w->conns;
+        if (w->conns != NULL)
+            w->conns->prev = c;
+        w->conns = c;
+        STATS_ADD(w->stats.connectionsAccepted, 1);
+        STATS_ADD(w->stats.connectionsOpen, 1);
+        wheelAdd(&w->wheel, &c->timer, nowTicks() + (uint64_t)headerTimeout * 1000 / TICK_MS);
+    }
+}
+
+/**
+ * @brief Stops accepting connections after the listener has been handed to a new process.
+ * @details Responses in progress are completed and then the connections are closed. Idle keep-alive connections get
+ * DRAIN_GRACE_MS to send one last request, which is answered with "Connection: Close".
+ * @param w the worker.
+ * @return void
+ */
+void drainWorker(struct worker *w) {
+    w->draining = 1;
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, sockfd, NULL);
+
+    // wakeFd stays readable, edge triggered it only wakes us again when the shutdown writes to it
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &wakeTag;
+    epoll_ctl(w->epfd, EPOLL_CTL_MOD, wakeFd, &ev);
+
+    uint64_t grace = nowTicks() + (DRAIN_GRACE_MS + TICK_MS - 1) / TICK_MS;
+    for (struct connection *c = w->conns; c != NULL; c = c->next) {
+        if (c->state == CONN_IDLE && c->timer.expires > grace)
+            wheelAdd(&w->wheel, &c->timer, grace);
+    }
+}
 
-            shutdown(con, SHUT_WR);
-            free(resBody);
+/**
+ * @brief Runs the event loop until done is set or a drain is complete.
+ * @param arg the worker.
+ * @return NULL
+ */
+void *runWorker(void *arg) {
+    struct worker *w = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!done && !(w->draining && w->conns == NULL)) {
+        long ticks = wheelTicksUntilNext(&w->wheel);
+        int timeout = (ticks < 0) ? -1 : (int)(ticks * TICK_MS);
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "%s: Error waiting for events!\n", name);
+            break;
+        }
 
+        int completed = 0;
+        for (int i = 0; i < n; i++) {
+            struct connection *c = events[i].data.ptr;
+            if (events[i].data.ptr == &listenTag) {
+                acceptConnections(w);
+            } else if (events[i].data.ptr == &wakeTag) {
+                if (draining && !w->draining)
+                    drainWorker(w);
+            } else if (events[i].data.ptr == &w->completions) {
+                completed = 1;
+            } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(w, c);
+            } else if (c->state == CONN_SEND) {
+                onWritable(w, c);
+            } else {
+                onReadable(w, c);
+            }
         }
-        shutdown(con, SHUT_RDWR);
+
+        // after the events, so no event refers to a connection closed here
+        if (completed)
+            completeHandlers(w);
+        wheelAdvance(&w->wheel, nowTicks(), expireConnection, w);
+    }
+
+    while (w->conns != NULL)
+        closeConnection(w, w->conns);
+    __atomic_sub_fetch(&runningWorkers, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief Sets up the epoll instance of a worker.
+ * @details The listening socket is registered exclusively, so a new connection wakes only one worker.
+ * The completion queue of dynamic handlers is registered with the queue itself as tag.
+ * @param w the worker.
+ * @return 0 on success, -1 on error.
+ */
+int initWorker(struct worker *w, int index) {
+    memset(w, 0, sizeof(*w));
+    w->completions.fd = -1;
+    w->index = index;
+    w->log = accessLogRing(index);
+    wheelInit(&w->wheel, nowTicks());
+    w->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w->epfd < 0)
+        return -1;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &listenTag;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0)
+        return -1;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &wakeTag;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, wakeFd, &ev) < 0)
+        return -1;
+    if (completionInit(&w->completions) < 0)
+        return -1;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &w->completions;
+    if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->completions.fd, &ev) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Dynamic handler of /_time, the current time of the server as JSON.
+ * @param call the request.
+ * @param res the response.
+ * @return void
+ */
+void handleTime(const struct handlerCall *call, struct handlerResult *res) {
+    (void)call;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    char date[32];
+    httpDate(now.tv_sec, date, sizeof(date));
+    int len = snprintf(NULL, 0, "{\"unix\":%lld.%09ld,\"date\":\"%s\"}\n", (long long)now.tv_sec, now.tv_nsec, date);
+    res->body = malloc(len + 1);
+    if (res->body == NULL)
+        return;
+    snprintf(res->body, len + 1, "{\"unix\":%lld.%09ld,\"date\":\"%s\"}\n", (long long)now.tv_sec, now.tv_nsec, date);
+    res->len = len;
+    res->status = 200;
+    res->contentType = "application/json";
+}
+
+/**
+ * @brief Dynamic handler of /_sleep?ms=N, answers after N (at most 10000) milliseconds.
+ * @details Only for the local host, it simulates a slow handler when testing the server.
+ * @param call the request.
+ * @param res the response.
+ * @return void
+ */
+void handleSleep(const struct handlerCall *call, struct handlerResult *res) {
+    if (!call->loopback) {
+        res->status = 404;
+        return;
+    }
+    long ms = (strncmp(call->query, "ms=", 3) == 0) ? strtol(call->query + 3, NULL, 10) : 0;
+    if (ms < 0 || ms > 10000)
+        ms = 10000;
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000 };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+    res->status = 200;
+}
+
+/**
+ * @brief Creates the control socket a new process connects to for taking over the listener.
+ * @details A socket file left behind by a previous process is replaced.
+ * @param void
+ * @return 0 on success, -1 on error.
+ */
+int createControlSocket(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, controlPath, sizeof(addr.sun_path) - 1);
+
+    controlFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (controlFd < 0)
+        return -1;
+    unlink(controlPath);
+    if (bind(controlFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(controlFd, 4) < 0) {
+        close(controlFd);
+        controlFd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Asks a running server for its listening socket.
+ * @details The socket arrives as SCM_RIGHTS ancillary data. The running server keeps accepting until
+ * completeTakeOver() tells it that our workers are up, so no connection is refused in between.
+ * @param void
+ * @return the connection to the running server, -1 if there is none or it did not hand over.
+ */
+int takeOverListener(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, controlPath, sizeof(addr.sun_path) - 1);
+
+    int con = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (con < 0)
+        return -1;
+    struct timeval timeout = { HANDOFF_TIMEOUT, 0 };
+    setsockopt(con, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(con, (struct sockaddr *)&addr, sizeof(addr)) < 0 || write(con, "T", 1) != 1) {
+        close(con);
+        return -1;
+    }
+
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(con, &msg, MSG_CMSG_CLOEXEC) != 1 || byte != 'L') {
+        close(con);
+        return -1;
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        close(con);
+        return -1;
+    }
+    memcpy(&sockfd, CMSG_DATA(cmsg), sizeof(int));
+    return con;
+}
+
+/**
+ * @brief Tells the previous server that our workers accept connections now.
+ * @details Waits until it has closed its control socket, so ours can take over the path.
+ * @param con the connection returned by takeOverListener().
+ * @return void
+ */
+void completeTakeOver(int con) {
+    char byte;
+    if (write(con, "R", 1) != 1 || read(con, &byte, 1) != 0)
+        fprintf(stderr, "%s: previous server did not confirm the hand over!\n", name);
+    close(con);
+}
+
+/**
+ * @brief Serves a connection to the control socket by handing the listener to a new process.
+ * @param void
+ * @return 1 if the new process took over and we have to drain, 0 otherwise.
+ */
+int handOverListener(void) {
+    int con = accept4(controlFd, NULL, NULL, SOCK_CLOEXEC);
+    if (con < 0)
+        return 0;
+    struct timeval timeout = { HANDOFF_TIMEOUT, 0 };
+    setsockopt(con, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char byte;
+    if (read(con, &byte, 1) != 1 || byte != 'T') {
         close(con);
+        return 0;
+    }
 
+    struct iovec iov = { "L", 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &sockfd, sizeof(int));
+
+    // keep serving if the new process fails before its workers are running
+    if (sendmsg(con, &msg, MSG_NOSIGNAL) != 1 || read(con, &byte, 1) != 1 || byte != 'R') {
+        fprintf(stderr, "%s: hand over failed, continuing to serve!\n", name);
+        close(con);
+        return 0;
     }
-    shutdown(con, SHUT_RDWR);
+    close(controlFd);
+    controlFd = -1;
     close(con);
-    cleanUp();
+    return 1;
+}
 
+/**
+ * @brief Starts a new instance of the server with the same arguments, it takes over through the control socket.
+ * @param void
+ * @return void
+ */
+void restartSelf(void) {
+    if (controlFd < 0) {
+        fprintf(stderr, "%s: reload needs a control socket (-s)!\n", name);
+        return;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", savedArgv);
+        _exit(EXIT_FAILURE);
+    }
+    if (pid < 0)
+        fprintf(stderr, "%s: Error starting new server: %s\n", name, strerror(errno));
 }
 
+/**
+ * Program entry point.
+ * @brief Program starts here.
+ * @details The Program will first handle and validate all arguments and will then start offering its service.
+ * The server can be stopped by SIGINT, SIGTERM. With a control socket (-s) a new server started with the same
+ * socket takes over the listener of the running one, which then finishes its responses and exits. SIGHUP starts
+ * such a new server with the same arguments.
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return Returns EXIT_SUCCESS.
+ */
+int main (int argc, char **argv) {
+    name = argv[0];
+    savedArgv = argv;
+
+    readArgs(argc, argv);
+    validateArgs();
+    int handoff = (controlPath != NULL) ? takeOverListener() : -1;
+    if (handoff < 0)
+        createConnection();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(struct sigaction));
+    action.sa_handler = SIG_IGN; // a client closing early must not kill the server
+    sigaction(SIGPIPE, &action, NULL);
+    sigaction(SIGCHLD, &action, NULL); // servers started by SIGHUP are reaped automatically
+
+    // the signals are only received through signalFd below, the workers never see them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    int signalFd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+    if (workerCount == 0)
+        workerCount = (sysconf(_SC_NPROCESSORS_ONLN) > 0) ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (signalFd < 0 || wakeFd < 0 || posix_memalign((void **)&workers, 64, workerCount * sizeof(struct worker)) != 0) {
+        workers = NULL;
+        fprintf(stderr,"%s: Error starting network service!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+    memset(workers, 0, workerCount * sizeof(struct worker));
+    for (int i = 0; i < workerCount; i++)
+        workers[i].completions.fd = -1;
+    handlerRegister("/_time", handleTime);
+    handlerRegister("/_sleep", handleSleep);
+    if (handlerPoolStart(handlerThreads) < 0) {
+        fprintf(stderr,"%s: Error starting handler threads!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+    if (logPath != NULL && accessLogOpen(logPath, workerCount) < 0) {
+        fprintf(stderr,"%s: Error opening access log!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+
+    int started = 0;
+    for (; started < workerCount; started++) {
+        __atomic_add_fetch(&runningWorkers, 1, __ATOMIC_RELAXED);
+        if (initWorker(&workers[started], started) < 0 ||
+            pthread_create(&workers[started].thread, NULL, runWorker, &workers[started]) != 0) {
+            __atomic_sub_fetch(&runningWorkers, 1, __ATOMIC_RELAXED);
+            fprintf(stderr,"%s: Error starting network service!\n", name);
+            done = 1;
+            break;
+        }
+    }
+
+    if (!done && handoff >= 0)
+        completeTakeOver(handoff);
+    else if (handoff >= 0)
+        close(handoff); // the previous server keeps serving
+    if (!done && controlPath != NULL && createControlSocket() < 0)
+        fprintf(stderr,"%s: Error creating control socket, reload disabled!\n", name);
+
+    uint64_t one = 1;
+    while (!done && !(draining && __atomic_load_n(&runningWorkers, __ATOMIC_ACQUIRE) == 0)) {
+        struct pollfd fds[2] = { { signalFd, POLLIN, 0 }, { controlFd, POLLIN, 0 } };
+        if (poll(fds, (controlFd >= 0) ? 2 : 1, draining ? TICK_MS : -1) < 0)
+            continue;
+        if (fds[0].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGHUP)
+                    restartSelf();
+                else
+                    done = 1;
+            }
+        }
+        if (controlFd >= 0 && (fds[1].revents & POLLIN) && handOverListener()) {
+            draining = 1;
+            if (write(wakeFd, &one, sizeof(one)) != sizeof(one))
+                fprintf(stderr,"%s: Error draining workers!\n", name);
+        }
+    }
+
+    if (write(wakeFd, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr,"%s: Error stopping workers!\n", name);
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+    handlerPoolStop();
+    accessLogClose();
+    for (int i = 0; i < workerCount; i++) {
+        if (workers[i].epfd > 0)
+            close(workers[i].epfd);
+        completionDestroy(&workers[i].completions);
+    }
+
+    close(signalFd);
+    if (controlFd >= 0)
+        unlink(controlPath);
+    cleanUp();
+    exit(started == workerCount ? EXIT_SUCCESS : EXIT_FAILURE);
+}
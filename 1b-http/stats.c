@@ -0,0 +1,243 @@
+/**
+ * @file stats.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Per-worker request counters and latency histograms.
+ *
+ * The histograms use fixed bucket bounds, recording a response is a handful of stores.
+ * The rendered output follows the Prometheus text exposition format.
+ **/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stats.h"
+
+static const int statusCodes[STATS_STATUS_SLOTS - 1] = { 200, 206, 301, 304, 400, 404, 416, 431, 500, 501, 503 }; /*!< the statuses the server sends */
+
+/*! upper bounds of the latency buckets in microseconds, the last bucket is +Inf */
+static const uint64_t latencyBounds[STATS_LATENCY_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 10000000
+};
+
+/*! upper bounds of the response size buckets in bytes, the last bucket is +Inf */
+static const uint64_t sizeBounds[STATS_SIZE_BUCKETS - 1] = {
+    256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304, 16777216, 67108864, 268435456
+};
+
+/**
+ * @brief Index of the status slot of a status code.
+ */
+static int statusSlot(int status) {
+    for (int i = 0; i < STATS_STATUS_SLOTS - 1; i++) {
+        if (statusCodes[i] == status)
+            return i;
+    }
+    return STATS_STATUS_SLOTS - 1;
+}
+
+/**
+ * @brief Index of the first bucket whose bound is not below value.
+ */
+static int bucket(const uint64_t *bounds, int count, uint64_t value) {
+    int i = 0;
+    while (i < count - 1 && value > bounds[i])
+        i++;
+    return i;
+}
+
+/**
+ * @brief Records a completed response.
+ * @details Must only be called by the worker owning s.
+ * @param s statistics of the calling worker.
+ * @param status HTTP status code of the response.
+ * @param bytes bytes sent for the response including the header.
+ * @param latencyUs time from the complete request header to the last byte sent.
+ * @return void
+ */
+void statsRecordResponse(struct statsBlock *s, int status, uint64_t bytes, uint64_t latencyUs) {
+    int slot = statusSlot(status);
+    int lb = bucket(latencyBounds, STATS_LATENCY_BUCKETS, latencyUs);
+    int sb = bucket(sizeBounds, STATS_SIZE_BUCKETS, bytes);
+
+    STATS_ADD(s->requests[slot], 1);
+    STATS_ADD(s->bytesSent[slot], bytes);
+    STATS_ADD(s->latencySumUs[slot], latencyUs);
+    STATS_ADD(s->latency[slot][lb], 1);
+    STATS_ADD(s->size[slot][sb], 1);
+    STATS_ADD(s->latencySumUsBySize[sb], latencyUs);
+    STATS_ADD(s->latencyBySize[sb][lb], 1);
+}
+
+/**
+ * @brief Growing output buffer for statsRender().
+ */
+struct textBuf {
+    char *data;                                 /*!< rendered text */
+    size_t len;                                 /*!< used bytes */
+    size_t cap;                                 /*!< allocated bytes */
+    int failed;                                 /*!< set when an allocation failed */
+};
+
+/**
+ * @brief printf into a textBuf.
+ */
+static void append(struct textBuf *b, const char *fmt, ...) {
+    va_list ap;
+    if (b->failed)
+        return;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            b->failed = 1;
+            return;
+        }
+        if ((size_t)n < b->cap - b->len) {
+            b->len += n;
+            return;
+        }
+        size_t newCap = (b->cap + n + 1) * 2;
+        char *newData = realloc(b->data, newCap);
+        if (newData == NULL) {
+            b->failed = 1;
+            return;
+        }
+        b->data = newData;
+        b->cap = newCap;
+    }
+}
+
+/**
+ * @brief Sums the counter at the given offset over all workers.
+ */
+static uint64_t sum(struct statsBlock *const *blocks, int count, size_t offset) {
+    uint64_t total = 0;
+    for (int w = 0; w < count; w++)
+        total += __atomic_load_n((uint64_t *)((char *)blocks[w] + offset), __ATOMIC_RELAXED);
+    return total;
+}
+
+/**
+ * @brief Sums a counter over all workers.
+ */
+#define SUM(field) sum(blocks, count, (size_t)((char *)&blocks[0]->field - (char *)blocks[0]))
+
+/**
+ * @brief Label value of a status slot.
+ */
+static void statusLabel(char *buf, size_t len, int slot) {
+    if (slot < STATS_STATUS_SLOTS - 1)
+        snprintf(buf, len, "%d", statusCodes[slot]);
+    else
+        snprintf(buf, len, "other");
+}
+
+/**
+ * @brief Formats a bucket bound, latencies are exposed in seconds.
+ */
+static void formatBound(char *buf, size_t len, const uint64_t *bounds, int i, int count, double scale) {
+    if (i == count - 1)
+        snprintf(buf, len, "+Inf");
+    else if (scale == 1)
+        snprintf(buf, len, "%llu", (unsigned long long)bounds[i]);
+    else
+        snprintf(buf, len, "%g", bounds[i] * scale);
+}
+
+/**
+ * @brief Renders the summed statistics of all workers.
+ * @param blocks statistics of all workers.
+ * @param count number of workers.
+ * @param len receives the length of the text.
+ * @return the text, to be freed by the caller, or NULL if memory ran out.
+ */
+char *statsRender(struct statsBlock *const *blocks, int count, size_t *len) {
+    struct textBuf b = { NULL, 0, 0, 0 };
+    char le[32];
+    char code[8];
+
+    append(&b, "# HELP http_connections_accepted_total Accepted connections.\n"
+               "# TYPE http_connections_accepted_total counter\n"
+               "http_connections_accepted_total %llu\n", (unsigned long long)SUM(connectionsAccepted));
+    append(&b, "# HELP http_connections_open Currently open connections.\n"
+               "# TYPE http_connections_open gauge\n"
+               "http_connections_open %llu\n", (unsigned long long)SUM(connectionsOpen));
+    append(&b, "# HELP http_connections_timed_out_total Connections dropped because a deadline passed.\n"
+               "# TYPE http_connections_timed_out_total counter\n"
+               "http_connections_timed_out_total %llu\n", (unsigned long long)SUM(connectionsTimedOut));
+    append(&b, "# HELP http_responses_aborted_total Responses that could not be sent completely.\n"
+               "# TYPE http_responses_aborted_total counter\n"
+               "http_responses_aborted_total %llu\n", (unsigned long long)SUM(responsesAborted));
+
+    append(&b, "# HELP http_response_bytes_total Bytes sent including headers.\n"
+               "# TYPE http_response_bytes_total counter\n");
+    for (int s = 0; s < STATS_STATUS_SLOTS; s++) {
+        statusLabel(code, sizeof(code), s);
+        if (SUM(requests[s]) > 0)
+            append(&b, "http_response_bytes_total{code=\"%s\"} %llu\n", code, (unsigned long long)SUM(bytesSent[s]));
+    }
+
+    append(&b, "# HELP http_request_duration_seconds Time from the complete request header to the last byte sent.\n"
+               "# TYPE http_request_duration_seconds histogram\n");
+    for (int s = 0; s < STATS_STATUS_SLOTS; s++) {
+        uint64_t total = SUM(requests[s]);
+        if (total == 0)
+            continue;
+        statusLabel(code, sizeof(code), s);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+            cumulative += SUM(latency[s][i]);
+            formatBound(le, sizeof(le), latencyBounds, i, STATS_LATENCY_BUCKETS, 1e-6);
+            append(&b, "http_request_duration_seconds_bucket{code=\"%s\",le=\"%s\"} %llu\n", code, le, (unsigned long long)cumulative);
+        }
+        append(&b, "http_request_duration_seconds_sum{code=\"%s\"} %.6f\n", code, SUM(latencySumUs[s]) * 1e-6);
+        append(&b, "http_request_duration_seconds_count{code=\"%s\"} %llu\n", code, (unsigned long long)total);
+    }
+
+    append(&b, "# HELP http_response_size_bytes Bytes sent per response including the header.\n"
+               "# TYPE http_response_size_bytes histogram\n");
+    for (int s = 0; s < STATS_STATUS_SLOTS; s++) {
+        uint64_t total = SUM(requests[s]);
+        if (total == 0)
+            continue;
+        statusLabel(code, sizeof(code), s);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < STATS_SIZE_BUCKETS; i++) {
+            cumulative += SUM(size[s][i]);
+            formatBound(le, sizeof(le), sizeBounds, i, STATS_SIZE_BUCKETS, 1);
+            append(&b, "http_response_size_bytes_bucket{code=\"%s\",le=\"%s\"} %llu\n", code, le, (unsigned long long)cumulative);
+        }
+        append(&b, "http_response_size_bytes_sum{code=\"%s\"} %llu\n", code, (unsigned long long)SUM(bytesSent[s]));
+        append(&b, "http_response_size_bytes_count{code=\"%s\"} %llu\n", code, (unsigned long long)total);
+    }
+
+    append(&b, "# HELP http_request_duration_by_size_seconds Request duration by the size class of the response.\n"
+               "# TYPE http_request_duration_by_size_seconds histogram\n");
+    for (int sb = 0; sb < STATS_SIZE_BUCKETS; sb++) {
+        uint64_t total = 0;
+        for (int i = 0; i < STATS_LATENCY_BUCKETS; i++)
+            total += SUM(latencyBySize[sb][i]);
+        if (total == 0)
+            continue;
+        char sizeLe[32];
+        formatBound(sizeLe, sizeof(sizeLe), sizeBounds, sb, STATS_SIZE_BUCKETS, 1);
+        uint64_t cumulative = 0;
+        for (int i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+            cumulative += SUM(latencyBySize[sb][i]);
+            formatBound(le, sizeof(le), latencyBounds, i, STATS_LATENCY_BUCKETS, 1e-6);
+            append(&b, "http_request_duration_by_size_seconds_bucket{size_le=\"%s\",le=\"%s\"} %llu\n", sizeLe, le, (unsigned long long)cumulative);
+        }
+        append(&b, "http_request_duration_by_size_seconds_sum{size_le=\"%s\"} %.6f\n", sizeLe, SUM(latencySumUsBySize[sb]) * 1e-6);
+        append(&b, "http_request_duration_by_size_seconds_count{size_le=\"%s\"} %llu\n", sizeLe, (unsigned long long)total);
+    }
+
+    if (b.failed) {
+        free(b.data);
+        return NULL;
+    }
+    *len = b.len;
+    return b.data;
+}
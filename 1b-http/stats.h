@@ -0,0 +1,47 @@
+/**
+ * @file stats.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Per-worker request counters and latency histograms.
+ *
+ * Every worker owns one statsBlock and is its only writer, so updates are plain relaxed
+ * stores without locks or read-modify-write instructions. Readers sum all blocks.
+ **/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_PATH "/_stats"                    /*!< internal endpoint exposing the metrics */
+#define STATS_STATUS_SLOTS 12                   /*!< tracked status codes, the last slot collects the rest */
+#define STATS_LATENCY_BUCKETS 17                /*!< latency buckets including +Inf */
+#define STATS_SIZE_BUCKETS 12                   /*!< response size buckets including +Inf */
+
+/**
+ * @brief Counters of one worker, aligned so two workers never share a cache line.
+ */
+struct statsBlock {
+    uint64_t connectionsAccepted;                                        /*!< accepted connections */
+    uint64_t connectionsOpen;                                            /*!< currently open connections */
+    uint64_t connectionsTimedOut;                                        /*!< connections dropped by a deadline */
+    uint64_t responsesAborted;                                           /*!< responses not completely sent */
+    uint64_t requests[STATS_STATUS_SLOTS];                               /*!< completed responses by status */
+    uint64_t bytesSent[STATS_STATUS_SLOTS];                              /*!< bytes sent by status */
+    uint64_t latencySumUs[STATS_STATUS_SLOTS];                           /*!< summed latency by status */
+    uint64_t latency[STATS_STATUS_SLOTS][STATS_LATENCY_BUCKETS];         /*!< latency histogram by status */
+    uint64_t size[STATS_STATUS_SLOTS][STATS_SIZE_BUCKETS];               /*!< response size histogram by status */
+    uint64_t latencySumUsBySize[STATS_SIZE_BUCKETS];                     /*!< summed latency by response size */
+    uint64_t latencyBySize[STATS_SIZE_BUCKETS][STATS_LATENCY_BUCKETS];   /*!< latency histogram by response size */
+} __attribute__((aligned(64)));
+
+/**
+ * @brief Increments a counter owned by the calling worker.
+ */
+#define STATS_ADD(counter, n) __atomic_store_n(&(counter), __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+
+void statsRecordResponse(struct statsBlock *s, int status, uint64_t bytes, uint64_t latencyUs);
+char *statsRender(struct statsBlock *const *blocks, int count, size_t *len);
+
+#endif
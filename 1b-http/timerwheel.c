@@ -0,0 +1,165 @@
+/**
+ * @file timerwheel.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Hierarchical timer wheel.
+ *
+ * Level 0 holds the timers of the next WHEEL_SLOTS ticks with one slot per tick. Every slot of
+ * level n covers WHEEL_SLOTS^n ticks and is redistributed to the lower levels (cascaded) when
+ * the level below wraps around.
+ **/
+#include <stddef.h>
+#include "timerwheel.h"
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_DELTA ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+/**
+ * @brief Initializes an empty wheel.
+ * @param wheel the wheel.
+ * @param now the current tick.
+ * @return void
+ */
+void wheelInit(struct timerWheel *wheel, uint64_t now) {
+    wheel->now = now;
+    wheel->count = 0;
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        for (int s = 0; s < WHEEL_SLOTS; s++) {
+            wheel->slots[l][s].next = &wheel->slots[l][s];
+            wheel->slots[l][s].prev = &wheel->slots[l][s];
+        }
+    }
+}
+
+/**
+ * @brief Links a timer into the slot matching its expiry, relative to wheel->now.
+ */
+static void place(struct timerWheel *wheel, struct timer *t) {
+    uint64_t delta = t->expires - wheel->now;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+        level++;
+
+    struct timer *head = &wheel->slots[level][(t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+/**
+ * @brief Unlinks a timer from its slot.
+ */
+static void unlinkTimer(struct timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+}
+
+/**
+ * @brief Arms a timer, a pending timer is moved to the new expiry.
+ * @details Expiries in the past fire with the next tick, expiries beyond the range of the wheel are clamped.
+ * @param wheel the wheel.
+ * @param t the timer.
+ * @param expires tick at which the timer should fire.
+ * @return void
+ */
+void wheelAdd(struct timerWheel *wheel, struct timer *t, uint64_t expires) {
+    if (wheelPending(t))
+        wheelDel(wheel, t);
+    if (expires <= wheel->now)
+        expires = wheel->now + 1;
+    if (expires - wheel->now > WHEEL_MAX_DELTA)
+        expires = wheel->now + WHEEL_MAX_DELTA;
+    t->expires = expires;
+    place(wheel, t);
+    wheel->count++;
+}
+
+/**
+ * @brief Disarms a timer, disarming an idle timer does nothing.
+ * @param wheel the wheel.
+ * @param t the timer.
+ * @return void
+ */
+void wheelDel(struct timerWheel *wheel, struct timer *t) {
+    if (!wheelPending(t))
+        return;
+    unlinkTimer(t);
+    wheel->count--;
+}
+
+/**
+ * @brief Checks if a timer is armed.
+ * @param t the timer, has to be zero initialized before its first use.
+ * @return 1 if armed, 0 otherwise.
+ */
+int wheelPending(const struct timer *t) {
+    return t->next != NULL;
+}
+
+/**
+ * @brief Moves all timers of one slot of a higher level down to the lower levels.
+ */
+static void cascade(struct timerWheel *wheel, int level, int slot) {
+    struct timer *head = &wheel->slots[level][slot];
+    struct timer *t = head->next;
+    head->next = head;
+    head->prev = head;
+    while (t != head) {
+        struct timer *next = t->next;
+        place(wheel, t);
+        t = next;
+    }
+}
+
+/**
+ * @brief Processes all ticks up to now and fires the expired timers.
+ * @details Timers are disarmed before expire is called, so the callback may re-arm or free them.
+ * @param wheel the wheel.
+ * @param now the current tick.
+ * @param expire callback for every expired timer.
+ * @param arg passed through to expire.
+ * @return void
+ */
+void wheelAdvance(struct timerWheel *wheel, uint64_t now, void (*expire)(struct timer *t, void *arg), void *arg) {
+    while (wheel->now < now) {
+        if (wheel->count == 0) {
+            wheel->now = now;
+            return;
+        }
+        uint64_t tick = ++wheel->now;
+
+        for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+            if ((tick & ((1ULL << (WHEEL_BITS * level)) - 1)) == 0)
+                cascade(wheel, level, (tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        }
+
+        struct timer *head = &wheel->slots[0][tick & WHEEL_MASK];
+        while (head->next != head) {
+            struct timer *t = head->next;
+            unlinkTimer(t);
+            wheel->count--;
+            expire(t, arg);
+        }
+    }
+}
+
+/**
+ * @brief Number of ticks until the wheel has to be advanced again.
+ * @details Exact for timers on level 0, otherwise the next cascade point is returned.
+ * @param wheel the wheel.
+ * @return the number of ticks, -1 if no timer is armed.
+ */
+long wheelTicksUntilNext(const struct timerWheel *wheel) {
+    if (wheel->count == 0)
+        return -1;
+    long ticks = 1;
+    for (uint64_t tick = wheel->now + 1;; tick++, ticks++) {
+        const struct timer *head = &wheel->slots[0][tick & WHEEL_MASK];
+        if (head->next != head || (tick & WHEEL_MASK) == 0)
+            return ticks;
+    }
+}
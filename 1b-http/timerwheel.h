@@ -0,0 +1,45 @@
+/**
+ * @file timerwheel.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Hierarchical timer wheel.
+ *
+ * Timers are kept in WHEEL_LEVELS wheels of WHEEL_SLOTS slots each. Adding, removing and
+ * expiring a timer is O(1), timers far in the future cascade down one level at a time.
+ **/
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+
+#define WHEEL_BITS 6                            /*!< log2 of the slots per level */
+#define WHEEL_SLOTS (1 << WHEEL_BITS)           /*!< slots per level */
+#define WHEEL_LEVELS 4                          /*!< levels, covers WHEEL_SLOTS^WHEEL_LEVELS ticks */
+
+/**
+ * @brief A timer, to be embedded in the structure it belongs to.
+ */
+struct timer {
+    struct timer *next;                         /*!< next timer in the same slot */
+    struct timer *prev;                         /*!< previous timer in the same slot */
+    uint64_t expires;                           /*!< tick at which the timer fires */
+};
+
+/**
+ * @brief The wheel itself, every slot is a circular list with a dummy head.
+ */
+struct timerWheel {
+    uint64_t now;                               /*!< last processed tick */
+    unsigned int count;                         /*!< number of pending timers */
+    struct timer slots[WHEEL_LEVELS][WHEEL_SLOTS]; /*!< list heads */
+};
+
+void wheelInit(struct timerWheel *wheel, uint64_t now);
+void wheelAdd(struct timerWheel *wheel, struct timer *t, uint64_t expires);
+void wheelDel(struct timerWheel *wheel, struct timer *t);
+int wheelPending(const struct timer *t);
+void wheelAdvance(struct timerWheel *wheel, uint64_t now, void (*expire)(struct timer *t, void *arg), void *arg);
+long wheelTicksUntilNext(const struct timerWheel *wheel);
+
+#endif
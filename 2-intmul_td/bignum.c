@@ -0,0 +1,1144 @@
+/**
+ * @file bignum.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Non-negative big integers as arrays of 64-bit limbs.
+ *
+ * Hex digits are handled as eight bytes in one 64-bit word: the range checks of all eight
+ * characters, the mapping to nibble values and the packing into 32 bits each take a few word
+ * operations instead of a branch per digit.
+ *
+ * Karatsuba splits both factors of n limbs at h = n / 2 into a = Ah * B^h + Al and b = Bh * B^h + Bl,
+ * B = 2^64. With z0 = Al * Bl, z2 = Ah * Bh and z1 = (Ah + Al) * (Bh + Bl) - z0 - z2 the product is
+ * z2 * B^2h + z1 * B^h + z0, three products of about half the size instead of four. For odd n the high
+ * halves are one limb longer, the sums keep their carry as an extra limb.
+ *
+ * Toom-3 splits into three parts of k = ceil(n / 3) limbs, the top one shorter, and treats them as the
+ * coefficients of polynomials in x = B^k. Their product has five coefficients c0..c4, the five products
+ * of the values at 0, 1, -1, 2 and infinity determine them. Only the value at -1 can be negative, its
+ * sign is kept apart and the interpolation is ordered so that every intermediate value is non-negative.
+ *
+ * The transform multiplies modulo three primes p = c * 2^40 + 1 below 2^62 in Montgomery form, each
+ * coefficient of the product is below n * 2^128 and so is recovered from its three residues by the
+ * Chinese remainder theorem. The forward transform (decimation in frequency) leaves the values in bit
+ * reversed order, which is exactly what the inverse transform (decimation in time) expects.
+ **/
+#include <string.h>
+#include "bignum.h"
+#include "pool.h"
+
+#define ONES 0x0101010101010101ULL              /*!< 1 in every byte */
+#define NTT_PRIMES 3                            /*!< primes the transform is computed modulo */
+#define NTT_LOG_MAX 40                          /*!< 2^NTT_LOG_MAX divides p - 1 of every prime */
+#define INV3 0xAAAAAAAAAAAAAAABULL              /*!< inverse of 3 modulo 2^64 */
+#define HIGHS (ONES * 0x80)                     /*!< the top bit of every byte */
+
+static const uint64_t nttPrimes[NTT_PRIMES] = {          /*!< descending, each below twice the next */
+    0x3FFFC00000000001ULL, 0x3FFFBE0000000001ULL, 0x3FFF840000000001ULL
+};
+static const uint64_t nttGenerators[NTT_PRIMES] = {11, 3, 19}; /*!< a primitive root of each prime */
+
+/**
+ * @brief A prime modulus with its Montgomery constants, R = 2^64.
+ */
+struct montgomery {
+    uint64_t p;                                 /*!< the prime, below 2^62 */
+    uint64_t pinv;                              /*!< -p^-1 modulo R */
+    uint64_t r2;                                /*!< R^2 modulo p */
+};
+
+/**
+ * @brief Marks the bytes of a word that lie within a range.
+ * @details Only valid for bytes below 0x80, the sums then never carry into the next byte.
+ * @param x eight characters.
+ * @param lo smallest character of the range.
+ * @param hi largest character of the range.
+ * @return 0x80 in every byte within [lo, hi], 0 in the others.
+ */
+static uint64_t between(uint64_t x, unsigned lo, unsigned hi)
+{
+    return (x + ONES * (0x80 - lo)) & ~(x + ONES * (0x7F - hi)) & HIGHS;
+}
+
+/**
+ * @brief Converts eight hex digits into their 32-bit value.
+ * @param p the digits, most significant first.
+ * @param v receives the value.
+ * @return 0 on success, -1 if one of the characters is not a hex digit.
+ */
+static int decode8(const char *p, uint32_t *v)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x); // the first digit is expected in the lowest byte
+#endif
+    if ((x & HIGHS) != 0 || (between(x, '0', '9') | between(x, 'a', 'f') | between(x, 'A', 'F')) != HIGHS)
+        return -1;
+    x = (x & ONES * 0x0F) + ((x >> 6) & ONES) * 9;                          // '0'-'9' keep their low nibble, letters get 9 added
+    x = ((x & 0x00FF00FF00FF00FFULL) << 4) | ((x >> 8) & 0x00FF00FF00FF00FFULL); // two digits per 16 bits
+    x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;                             // four digits per 32 bits
+    x = (x | (x >> 16)) & 0xFFFFFFFFULL;                                   // eight digits, first pair in the lowest byte
+    *v = __builtin_bswap32((uint32_t)x);
+    return 0;
+}
+
+/**
+ * @brief Converts a 32-bit value into eight hex digits.
+ * @param v the value.
+ * @param p receives the digits, most significant first.
+ */
+static void encode8(uint32_t v, char *p)
+{
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;                             // nibble k in byte k
+    x += ONES * '0' + (((x + ONES * 6) >> 4) & ONES) * ('a' - '0' - 10);     // values from 10 on become letters
+    x = __builtin_bswap64(x);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    memcpy(p, &x, 8);
+}
+
+/**
+ * @brief Converts one hex digit.
+ * @return the value, -1 if c is not a hex digit.
+ */
+static int digitValue(char c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    if ('a' <= c && c <= 'f')
+        return 10 + c - 'a';
+    if ('A' <= c && c <= 'F')
+        return 10 + c - 'A';
+    return -1;
+}
+
+/**
+ * @brief Converts a hexadecimal string into limbs.
+ * @param str the digits, most significant first.
+ * @param len number of digits.
+ * @param limbs receives the number, (len + LIMB_DIGITS - 1) / LIMB_DIGITS limbs.
+ * @return 0 on success, -1 if str contains a character that is not a hex digit.
+ */
+int hexToLimbs(const char *str, size_t len, limb_t *limbs)
+{
+    size_t full = len / LIMB_DIGITS;
+    size_t head = len % LIMB_DIGITS;
+    for (size_t i = 0; i < full; i++)
+    {
+        const char *p = str + len - (i + 1) * LIMB_DIGITS;
+        uint32_t hi, lo;
+        if (decode8(p, &hi) < 0 || decode8(p + 8, &lo) < 0)
+            return -1;
+        limbs[i] = ((limb_t)hi << 32) | lo;
+    }
+    if (head > 0)
+    {
+        limb_t top = 0;
+        for (size_t i = 0; i < head; i++)
+        {
+            int d = digitValue(str[i]);
+            if (d < 0)
+                return -1;
+            top = (top << 4) | d;
+        }
+        limbs[full] = top;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts limbs into a hexadecimal string without leading zeros.
+ * @param limbs the number.
+ * @param n number of limbs.
+ * @param str receives the digits and a terminating 0, needs n * LIMB_DIGITS + 2 bytes.
+ * @return number of digits, at least 1.
+ */
+size_t limbsToHex(const limb_t *limbs, size_t n, char *str)
+{
+    while (n > 0 && limbs[n - 1] == 0)
+        n--;
+    if (n == 0)
+    {
+        strcpy(str, "0");
+        return 1;
+    }
+    char top[LIMB_DIGITS];
+    encode8(limbs[n - 1] >> 32, top);
+    encode8((uint32_t)limbs[n - 1], top + 8);
+    size_t skip = 0;
+    while (top[skip] == '0')
+        skip++;
+    size_t len = LIMB_DIGITS - skip;
+    memcpy(str, top + skip, len);
+    for (size_t i = n - 1; i-- > 0; len += LIMB_DIGITS)
+    {
+        encode8(limbs[i] >> 32, str + len);
+        encode8((uint32_t)limbs[i], str + len + 8);
+    }
+    str[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Adds two numbers.
+ * @param r receives a + b without the carry, na limbs, may be a.
+ * @param a first summand.
+ * @param na number of limbs of a.
+ * @param b second summand.
+ * @param nb number of limbs of b, nb <= na.
+ * @return the carry out of r.
+ */
+limb_t addN(limb_t *r, const limb_t *a, size_t na, const limb_t *b, size_t nb)
+{
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i < nb; i++)
+    {
+        dlimb_t t = (dlimb_t)a[i] + b[i] + carry;
+        r[i] = (limb_t)t;
+        carry = (limb_t)(t >> 64);
+    }
+    for (; i < na; i++)
+    {
+        r[i] = a[i] + carry;
+        carry = (r[i] < carry);
+    }
+    return carry;
+}
+
+/**
+ * @brief Adds a number shifted by whole limbs.
+ * @details r += x * 2^(64 * offset), the carry runs through the rest of r.
+ * @param r the sum, rn limbs.
+ * @param rn number of limbs of r.
+ * @param x the addend.
+ * @param xn number of limbs of x, offset + xn <= rn.
+ * @param offset shift of x in limbs.
+ * @return the carry out of r.
+ */
+limb_t addShifted(limb_t *r, size_t rn, const limb_t *x, size_t xn, size_t offset)
+{
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i < xn; i++)
+    {
+        dlimb_t t = (dlimb_t)r[offset + i] + x[i] + carry;
+        r[offset + i] = (limb_t)t;
+        carry = (limb_t)(t >> 64);
+    }
+    for (i += offset; carry != 0 && i < rn; i++)
+        carry = (++r[i] == 0);
+    return carry;
+}
+
+/**
+ * @brief Subtracts a number.
+ * @details r -= x, the borrow runs through the rest of r.
+ * @param r the difference, rn limbs.
+ * @param rn number of limbs of r.
+ * @param x the subtrahend.
+ * @param xn number of limbs of x, xn <= rn.
+ * @return the borrow out of r, 0 if x <= r.
+ */
+limb_t subInPlace(limb_t *r, size_t rn, const limb_t *x, size_t xn)
+{
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i < xn; i++)
+    {
+        limb_t d = r[i] - x[i];
+        limb_t b = (d > r[i]);
+        r[i] = d - borrow;
+        borrow = b | (r[i] > d);
+    }
+    for (; borrow != 0 && i < rn; i++)
+        borrow = (r[i]-- == 0);
+    return borrow;
+}
+
+/**
+ * @brief Multiplies two numbers by the schoolbook method.
+ * @details Every limb of a is multiplied with all limbs of b and added into the result row by row,
+ * the carry of a row is the top limb of that row.
+ * @param a first factor.
+ * @param na number of limbs of a.
+ * @param b second factor.
+ * @param nb number of limbs of b.
+ * @param r receives the product, na + nb limbs, must not overlap a or b.
+ */
+void mulSchoolbook(const limb_t *a, size_t na, const limb_t *b, size_t nb, limb_t *r)
+{
+    memset(r, 0, (na + nb) * sizeof(limb_t));
+    for (size_t i = 0; i < na; i++)
+    {
+        limb_t carry = 0;
+        for (size_t j = 0; j < nb; j++)
+        {
+            dlimb_t t = (dlimb_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> 64);
+        }
+        r[i + nb] = carry;
+    }
+}
+
+/**
+ * @brief One product of a split, run directly or as a task.
+ */
+struct product {
+    struct task task;                           /*!< run by the pool */
+    const limb_t *a;                            /*!< first factor */
+    const limb_t *b;                            /*!< second factor */
+    size_t n;                                   /*!< number of limbs of a and b */
+    limb_t *r;                                  /*!< receives the product, 2 * n limbs */
+    limb_t *scratch;                            /*!< temporary space of this product */
+    struct pool *pool;                          /*!< pool for its own subproducts */
+};
+
+/**
+ * @brief Runs a product of a split.
+ */
+static void runProduct(struct task *t)
+{
+    struct product *p = (struct product *)t;
+    mulEqual(p->a, p->b, p->n, p->r, p->scratch, p->pool);
+}
+
+/**
+ * @brief Computes the products of a split.
+ * @details Without a pool or below MUL_GRAIN limbs the products run one after the other and share the
+ * scratch space. Otherwise each gets its own part of it, all but the last are spawned and the last
+ * runs on the calling thread.
+ * @param p the products, their result slices must not overlap.
+ * @param count number of products.
+ * @param n number of limbs of the factors that were split.
+ * @param scratch mulScratch() of the products, see splitScratch().
+ * @param pool the pool or NULL.
+ */
+static void mulProducts(struct product *p, int count, size_t n, limb_t *scratch, struct pool *pool)
+{
+    if (pool == NULL || n < MUL_GRAIN)
+    {
+        for (int i = 0; i < count; i++)
+            mulEqual(p[i].a, p[i].b, p[i].n, p[i].r, scratch, NULL);
+        return;
+    }
+    int pending = 0;
+    for (int i = 0; i < count; i++)
+    {
+        p[i].task.run = runProduct;
+        p[i].scratch = scratch;
+        p[i].pool = pool;
+        scratch += mulScratch(p[i].n, 1);
+        if (i < count - 1)
+            poolSpawn(pool, &p[i].task, &pending);
+    }
+    runProduct(&p[count - 1].task);
+    poolWait(pool, &pending);
+}
+
+/**
+ * @brief Subtracts two numbers.
+ * @param r receives a - b without the borrow, na limbs, may be a or b.
+ * @param a the minuend.
+ * @param na number of limbs of a.
+ * @param b the subtrahend.
+ * @param nb number of limbs of b, nb <= na.
+ * @return the borrow out of r.
+ */
+static limb_t subN(limb_t *r, const limb_t *a, size_t na, const limb_t *b, size_t nb)
+{
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i < nb; i++)
+    {
+        limb_t d = a[i] - b[i];
+        limb_t c = (d > a[i]);
+        r[i] = d - borrow;
+        borrow = c | (r[i] > d);
+    }
+    for (; i < na; i++)
+    {
+        r[i] = a[i] - borrow;
+        borrow = (a[i] < borrow);
+    }
+    return borrow;
+}
+
+/**
+ * @brief Strips leading zero limbs.
+ * @return the number of limbs without leading zeros.
+ */
+static size_t trimmed(const limb_t *x, size_t n)
+{
+    while (n > 0 && x[n - 1] == 0)
+        n--;
+    return n;
+}
+
+/**
+ * @brief Combines the three Karatsuba products.
+ * @param r holds z0 in its low 2 * (n / 2) limbs and z2 in the rest, receives the product, 2 * n limbs.
+ * @param n number of limbs of each factor.
+ * @param z1 (Ah + Al) * (Bh + Bl), 2 * (n - n / 2 + 1) limbs, it is overwritten.
+ */
+static void karatsubaCombine(limb_t *r, size_t n, limb_t *z1)
+{
+    size_t h = n / 2;
+    size_t m = n - h;
+    size_t zn = 2 * m + 2;
+    subInPlace(z1, zn, r, 2 * h);
+    subInPlace(z1, zn, r + 2 * h, 2 * m);
+    addShifted(r, 2 * n, z1, trimmed(z1, zn), h); // Ah * Bl + Al * Bh is shorter than the product of the sums
+}
+
+/**
+ * @brief Multiplies two numbers of equal length by the Karatsuba method.
+ * @param a first factor.
+ * @param b second factor.
+ * @param n number of limbs of a and b, at least 2.
+ * @param r receives the product, 2 * n limbs, must not overlap a, b or scratch.
+ * @param scratch mulScratch(n) limbs of temporary space.
+ * @param pool pool for the three products, NULL to compute them on the calling thread.
+ */
+void mulKaratsuba(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool)
+{
+    size_t h = n / 2;
+    size_t m = n - h;
+    limb_t *t = scratch;
+    limb_t *u = t + m + 1;
+    limb_t *z1 = u + m + 1;
+    limb_t *next = z1 + 2 * (m + 1);
+
+    t[m] = addN(t, a + h, m, a, h);
+    u[m] = addN(u, b + h, m, b, h);
+    struct product p[3] = {
+        {.a = a, .b = b, .n = h, .r = r},
+        {.a = a + h, .b = b + h, .n = m, .r = r + 2 * h},
+        {.a = t, .b = u, .n = m + 1, .r = z1},
+    };
+    mulProducts(p, 3, n, next, pool);
+    karatsubaCombine(r, n, z1);
+}
+
+/**
+ * @brief Halves a number, which has to be even.
+ */
+static void halve(limb_t *x, size_t n)
+{
+    for (size_t i = 0; i + 1 < n; i++)
+        x[i] = (x[i] >> 1) | (x[i + 1] << 63);
+    x[n - 1] >>= 1;
+}
+
+/**
+ * @brief Divides a multiple of 3 by 3.
+ * @details Each limb of the quotient is the difference times the inverse of 3 modulo 2^64, the high
+ * limb of three times it is what the next limb has to give up.
+ */
+static void divideBy3(limb_t *x, size_t n)
+{
+    limb_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        limb_t c = (x[i] < borrow);
+        limb_t q = (x[i] - borrow) * INV3;
+        x[i] = q;
+        borrow = (limb_t)(((dlimb_t)q * 3) >> 64) + c;
+    }
+}
+
+/**
+ * @brief Evaluates the three parts of a Toom-3 factor at 1.
+ * @param p receives x0 + x1 + x2, k + 1 limbs.
+ * @param x the factor, x0 and x1 have k limbs, x2 has n2 <= k limbs.
+ */
+static void evalPlus1(limb_t *p, const limb_t *x, size_t k, size_t n2)
+{
+    limb_t carry = 0;
+    for (size_t i = 0; i < k; i++)
+    {
+        dlimb_t t = (dlimb_t)x[i] + x[k + i] + (i < n2 ? x[2 * k + i] : 0) + carry;
+        p[i] = (limb_t)t;
+        carry = (limb_t)(t >> 64);
+    }
+    p[k] = carry;
+}
+
+/**
+ * @brief Evaluates the three parts of a Toom-3 factor at 2.
+ * @param p receives x0 + 2 * x1 + 4 * x2, k + 1 limbs.
+ * @param x the factor, see evalPlus1().
+ */
+static void evalPlus2(limb_t *p, const limb_t *x, size_t k, size_t n2)
+{
+    limb_t carry = 0;
+    for (size_t i = 0; i < k; i++)
+    {
+        dlimb_t t = (dlimb_t)x[i] + ((dlimb_t)x[k + i] << 1) + (i < n2 ? (dlimb_t)x[2 * k + i] << 2 : 0) + carry;
+        p[i] = (limb_t)t;
+        carry = (limb_t)(t >> 64);
+    }
+    p[k] = carry;
+}
+
+/**
+ * @brief Evaluates the three parts of a Toom-3 factor at -1.
+ * @param p receives |x0 - x1 + x2|, k + 1 limbs.
+ * @param x the factor, see evalPlus1().
+ * @return 1 if x0 - x1 + x2 is negative, 0 otherwise.
+ */
+static int evalMinus1(limb_t *p, const limb_t *x, size_t k, size_t n2)
+{
+    const limb_t *x1 = x + k;
+    p[k] = addN(p, x, k, x + 2 * k, n2);
+    size_t i = k;
+    while (p[k] == 0 && i > 0 && p[i - 1] == x1[i - 1])
+        i--;
+    if (p[k] != 0 || i == 0 || p[i - 1] > x1[i - 1])
+    {
+        subInPlace(p, k + 1, x1, k);
+        return 0;
+    }
+    subN(p, x1, k, p, k);
+    return 1;
+}
+
+/**
+ * @brief Multiplies two numbers of equal length by the Toom-3 method.
+ * @details Interpolation of the values v0, v1, vm1, v2 and vinf at 0, 1, -1, 2 and infinity:
+ * v2 = (v2 - vm1) / 3, vm1 = (v1 - vm1) / 2, v1 = v1 - v0, v2 = (v2 - v1) / 2, v1 = v1 - vm1 - vinf,
+ * v2 = v2 - 2 * vinf, vm1 = vm1 - v2 leaves c1 in vm1, c2 in v1 and c3 in v2. c0 = v0 and c4 = vinf are
+ * computed in their place in r.
+ * @param a first factor.
+ * @param b second factor.
+ * @param n number of limbs of a and b, at least 5.
+ * @param r receives the product, 2 * n limbs, must not overlap a, b or scratch.
+ * @param scratch mulScratch(n) limbs of temporary space.
+ * @param pool pool for the five products, NULL to compute them on the calling thread.
+ */
+void mulToom3(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool)
+{
+    size_t k = (n + 2) / 3;
+    size_t n2 = n - 2 * k;
+    size_t l = 2 * k + 2;
+    limb_t *pa = scratch;                       // a at 1, -1 and 2, k + 1 limbs each
+    limb_t *pb = pa + 3 * (k + 1);              // b at 1, -1 and 2
+    limb_t *v1 = pb + 3 * (k + 1);
+    limb_t *vm1 = v1 + l;
+    limb_t *v2 = vm1 + l;
+    limb_t *next = v2 + l;
+    limb_t *vinf = r + 4 * k;
+
+    evalPlus1(pa, a, k, n2);
+    evalPlus1(pb, b, k, n2);
+    int negative = evalMinus1(pa + k + 1, a, k, n2) ^ evalMinus1(pb + k + 1, b, k, n2);
+    evalPlus2(pa + 2 * (k + 1), a, k, n2);
+    evalPlus2(pb + 2 * (k + 1), b, k, n2);
+    memset(r + 2 * k, 0, 2 * k * sizeof(limb_t));
+    struct product p[5] = {
+        {.a = a, .b = b, .n = k, .r = r},
+        {.a = a + 2 * k, .b = b + 2 * k, .n = n2, .r = vinf},
+        {.a = pa, .b = pb, .n = k + 1, .r = v1},
+        {.a = pa + k + 1, .b = pb + k + 1, .n = k + 1, .r = vm1},
+        {.a = pa + 2 * (k + 1), .b = pb + 2 * (k + 1), .n = k + 1, .r = v2},
+    };
+    mulProducts(p, 5, n, next, pool);
+
+    if (negative)
+        addN(v2, v2, l, vm1, l);
+    else
+        subInPlace(v2, l, vm1, l);
+    divideBy3(v2, l);
+    if (negative)
+        addN(vm1, v1, l, vm1, l);
+    else
+        subN(vm1, v1, l, vm1, l);
+    halve(vm1, l);
+    subInPlace(v1, l, r, 2 * k);
+    subInPlace(v2, l, v1, l);
+    halve(v2, l);
+    subInPlace(v1, l, vm1, l);
+    subInPlace(v1, l, vinf, 2 * n2);
+    subInPlace(v2, l, vinf, 2 * n2);
+    subInPlace(v2, l, vinf, 2 * n2);
+    subInPlace(vm1, l, v2, l);
+
+    addShifted(r, 2 * n, vm1, trimmed(vm1, l), k);
+    addShifted(r, 2 * n, v1, trimmed(v1, l), 2 * k);
+    addShifted(r, 2 * n, v2, trimmed(v2, l), 3 * k);
+}
+
+/**
+ * @brief Computes the Montgomery constants of a prime.
+ */
+static void montInit(struct montgomery *m, uint64_t p)
+{
+    uint64_t inv = p; // correct in the lowest 3 bits, every Newton step doubles them
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - p * inv;
+    uint64_t r = (uint64_t)((((dlimb_t)1) << 64) % p);
+    m->p = p;
+    m->pinv = -inv;
+    m->r2 = (uint64_t)((dlimb_t)r * r % p);
+}
+
+/**
+ * @brief Montgomery product a * b / R modulo p.
+ * @param m the modulus.
+ * @param a any 64-bit value.
+ * @param b below p.
+ * @return the product, below p.
+ */
+static inline uint64_t montMul(const struct montgomery *m, uint64_t a, uint64_t b)
+{
+    dlimb_t t = (dlimb_t)a * b;
+    uint64_t q = (uint64_t)t * m->pinv;
+    uint64_t u = (uint64_t)((t + (dlimb_t)q * m->p) >> 64);
+    return (u >= m->p) ? u - m->p : u;
+}
+
+/**
+ * @brief Raises a number in Montgomery form to a power.
+ * @return x^e in Montgomery form.
+ */
+static uint64_t montPow(const struct montgomery *m, uint64_t x, uint64_t e)
+{
+    uint64_t y = montMul(m, 1, m->r2);
+    for (; e > 0; e >>= 1)
+    {
+        if (e & 1)
+            y = montMul(m, y, x);
+        x = montMul(m, x, x);
+    }
+    return y;
+}
+
+static inline uint64_t addMod(uint64_t x, uint64_t y, uint64_t p)
+{
+    x += y;
+    return (x >= p) ? x - p : x;
+}
+
+static inline uint64_t subMod(uint64_t x, uint64_t y, uint64_t p)
+{
+    return (x >= y) ? x - y : x + p - y;
+}
+
+/**
+ * @brief A loop over a range of a transform, split into tasks of at most NTT_GRAIN iterations.
+ */
+struct nttLoop {
+    void (*body)(const struct nttLoop *l, size_t lo, size_t hi); /*!< runs the iterations lo to hi - 1 */
+    const struct montgomery *m;                 /*!< the modulus */
+    uint64_t *x;                                /*!< the values worked on */
+    uint64_t *y;                                /*!< second operand or destination */
+    const uint64_t *w;                          /*!< table of roots */
+    const limb_t *src;                          /*!< limbs to load */
+    size_t srcN;                                /*!< number of limbs of src */
+    size_t half;                                /*!< half length of the butterflies */
+    uint64_t c;                                 /*!< a constant of the body */
+    struct pool *pool;                          /*!< the pool or NULL */
+};
+
+/**
+ * @brief Part of a loop spawned as a task.
+ */
+struct loopTask {
+    struct task task;                           /*!< run by the pool */
+    const struct nttLoop *loop;                 /*!< the loop */
+    size_t lo;                                  /*!< first iteration */
+    size_t hi;                                  /*!< one after the last iteration */
+};
+
+static void loopRange(const struct nttLoop *l, size_t lo, size_t hi);
+
+static void runLoopTask(struct task *t)
+{
+    struct loopTask *lt = (struct loopTask *)t;
+    loopRange(lt->loop, lt->lo, lt->hi);
+}
+
+/**
+ * @brief Runs the iterations lo to hi - 1 of a loop, halving the range into tasks.
+ */
+static void loopRange(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    if (l->pool == NULL || hi - lo <= NTT_GRAIN)
+    {
+        l->body(l, lo, hi);
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    struct loopTask right = {{runLoopTask, NULL}, l, mid, hi};
+    int pending = 0;
+    poolSpawn(l->pool, &right.task, &pending);
+    loopRange(l, lo, mid);
+    poolWait(l->pool, &pending);
+}
+
+/**
+ * @brief Loads limbs into Montgomery form, zero after src.
+ */
+static void loadBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    for (size_t j = lo; j < hi; j++)
+        l->x[j] = (j < l->srcN) ? montMul(l->m, l->src[j], l->m->r2) : 0;
+}
+
+/**
+ * @brief Fills the top stage of the table of roots, powers of the root c.
+ */
+static void rootsBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    uint64_t power = montPow(l->m, l->c, lo);
+    for (size_t j = lo; j < hi; j++)
+    {
+        l->x[l->half + j] = power;
+        power = montMul(l->m, power, l->c);
+    }
+}
+
+/**
+ * @brief Butterflies of a forward stage.
+ */
+static void forwardBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    uint64_t p = l->m->p;
+    uint64_t *x = l->x;
+    size_t half = l->half;
+    for (size_t j = lo; j < hi; j++)
+    {
+        uint64_t u = x[j];
+        uint64_t v = x[j + half];
+        x[j] = addMod(u, v, p);
+        x[j + half] = montMul(l->m, subMod(u, v, p), l->w[half + j]);
+    }
+}
+
+/**
+ * @brief Butterflies of an inverse stage.
+ */
+static void inverseBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    uint64_t p = l->m->p;
+    uint64_t *x = l->x;
+    size_t half = l->half;
+    for (size_t j = lo; j < hi; j++)
+    {
+        uint64_t u = x[j];
+        uint64_t v = montMul(l->m, x[j + half], l->w[half + j]);
+        x[j] = addMod(u, v, p);
+        x[j + half] = subMod(u, v, p);
+    }
+}
+
+/**
+ * @brief Multiplies two transforms value by value.
+ */
+static void pointwiseBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    for (size_t j = lo; j < hi; j++)
+        l->x[j] = montMul(l->m, l->x[j], l->y[j]);
+}
+
+/**
+ * @brief Multiplies by the constant c into y.
+ */
+static void scaleBody(const struct nttLoop *l, size_t lo, size_t hi)
+{
+    for (size_t j = lo; j < hi; j++)
+        l->y[j] = montMul(l->m, l->x[j], l->c);
+}
+
+/**
+ * @brief Fills the table of roots of unity of a transform.
+ * @details w[len + j] = w_2len^j for every stage of half length len, w[0] is unused. The stages below
+ * the top one take every second root of the stage above.
+ * @param m the modulus.
+ * @param w receives n roots in Montgomery form.
+ * @param n length of the transform, a power of 2.
+ * @param root a primitive n-th root of unity in Montgomery form.
+ * @param pool the pool or NULL.
+ */
+static void nttRoots(const struct montgomery *m, uint64_t *w, size_t n, uint64_t root, struct pool *pool)
+{
+    if (n < 2)
+        return;
+    struct nttLoop l = {.body = rootsBody, .m = m, .x = w, .half = n / 2, .c = root, .pool = pool};
+    loopRange(&l, 0, n / 2);
+    for (size_t len = n / 4; len >= 1; len /= 2)
+        for (size_t j = 0; j < len; j++)
+            w[len + j] = w[2 * len + 2 * j];
+}
+
+/**
+ * @brief Transforms in place, natural order in, bit reversed order out.
+ * @details Each stage on blocks of 2 * len values uses the roots w[len] to w[2 * len - 1], a block can be
+ * transformed on its own once the stages above it are done.
+ */
+static void nttForward(const struct montgomery *m, uint64_t *x, size_t n, const uint64_t *w)
+{
+    for (size_t len = n / 2; len >= 1; len /= 2)
+        for (size_t s = 0; s < n; s += 2 * len)
+            for (size_t j = 0; j < len; j++)
+            {
+                uint64_t u = x[s + j];
+                uint64_t v = x[s + j + len];
+                x[s + j] = addMod(u, v, m->p);
+                x[s + j + len] = montMul(m, subMod(u, v, m->p), w[len + j]);
+            }
+}
+
+/**
+ * @brief Transforms back in place without the division by n, bit reversed order in, natural order out.
+ * @param w table of the inverse roots.
+ */
+static void nttInverse(const struct montgomery *m, uint64_t *x, size_t n, const uint64_t *w)
+{
+    for (size_t len = 1; len < n; len *= 2)
+        for (size_t s = 0; s < n; s += 2 * len)
+            for (size_t j = 0; j < len; j++)
+            {
+                uint64_t u = x[s + j];
+                uint64_t v = montMul(m, x[s + j + len], w[len + j]);
+                x[s + j] = addMod(u, v, m->p);
+                x[s + j + len] = subMod(u, v, m->p);
+            }
+}
+
+/**
+ * @brief A transform of one block, run directly or as a task.
+ */
+struct nttBlock {
+    struct task task;                           /*!< run by the pool */
+    const struct montgomery *m;                 /*!< the modulus */
+    uint64_t *x;                                /*!< the block */
+    size_t n;                                   /*!< length of the block */
+    const uint64_t *w;                          /*!< table of roots */
+    int inverse;                                /*!< transform back */
+    struct pool *pool;                          /*!< the pool or NULL */
+};
+
+/**
+ * @brief Transforms a block.
+ * @details Up to NTT_GRAIN values, or without a pool, the block is transformed by the loops above.
+ * Otherwise the outer stage runs as a parallel loop and the two halves as separate tasks, the forward
+ * transform does the stage first, the inverse one last.
+ */
+static void runBlock(struct task *t)
+{
+    struct nttBlock *b = (struct nttBlock *)t;
+    if (b->pool == NULL || b->n <= NTT_GRAIN)
+    {
+        if (b->inverse)
+            nttInverse(b->m, b->x, b->n, b->w);
+        else
+            nttForward(b->m, b->x, b->n, b->w);
+        return;
+    }
+    size_t half = b->n / 2;
+    struct nttLoop stage = {.body = b->inverse ? inverseBody : forwardBody, .m = b->m, .x = b->x, .w = b->w,
+                            .half = half, .pool = b->pool};
+    struct nttBlock low = *b;
+    struct nttBlock high = *b;
+    low.n = high.n = half;
+    high.x += half;
+    int pending = 0;
+
+    if (!b->inverse)
+        loopRange(&stage, 0, half);
+    poolSpawn(b->pool, &high.task, &pending);
+    runBlock(&low.task);
+    poolWait(b->pool, &pending);
+    if (b->inverse)
+        loopRange(&stage, 0, half);
+}
+
+/**
+ * @brief Computes the length of the transform for a product.
+ * @return the smallest power of 2 not below rn.
+ */
+static size_t nttLength(size_t rn)
+{
+    size_t n = 1;
+    while (n < rn)
+        n *= 2;
+    return n;
+}
+
+/**
+ * @brief Computes the scratch space mulNtt() needs.
+ * @details The residues take 3 * rn limbs. The root table and both transforms of a prime take three
+ * times the transform length, once per prime when they run in parallel.
+ * @param rn number of limbs of the product.
+ * @param parallel the primes run as tasks.
+ * @return number of limbs.
+ */
+size_t nttScratch(size_t rn, int parallel)
+{
+    return NTT_PRIMES * rn + (parallel ? NTT_PRIMES : 1) * 3 * nttLength(rn);
+}
+
+/**
+ * @brief The product modulo one prime, run directly or as a task.
+ */
+struct nttPrime {
+    struct task task;                           /*!< run by the pool */
+    const struct montgomery *m;                 /*!< the prime */
+    uint64_t generator;                         /*!< a primitive root of the prime */
+    const limb_t *a;                            /*!< first factor */
+    size_t na;                                  /*!< number of limbs of a */
+    const limb_t *b;                            /*!< second factor */
+    size_t nb;                                  /*!< number of limbs of b */
+    uint64_t *x;                                /*!< receives the na + nb coefficients modulo the prime */
+    uint64_t *work;                             /*!< three times the transform length */
+    struct pool *pool;                          /*!< the pool or NULL */
+};
+
+/**
+ * @brief Computes the coefficients of a product modulo one prime.
+ */
+static void runPrime(struct task *t)
+{
+    struct nttPrime *q = (struct nttPrime *)t;
+    const struct montgomery *m = q->m;
+    size_t rn = q->na + q->nb;
+    size_t n = nttLength(rn);
+    uint64_t *w = q->work;
+    uint64_t *fa = w + n;
+    uint64_t *fb = fa + n;
+    uint64_t root = montPow(m, montMul(m, q->generator, m->r2), (m->p - 1) / n);
+    struct nttLoop l = {.m = m, .pool = q->pool};
+    struct nttBlock ta = {{runBlock, NULL}, m, fa, n, w, 0, q->pool};
+    struct nttBlock tb = {{runBlock, NULL}, m, fb, n, w, 0, q->pool};
+    int pending = 0;
+
+    l.body = loadBody;
+    l.x = fa;
+    l.src = q->a;
+    l.srcN = q->na;
+    loopRange(&l, 0, n);
+    l.x = fb;
+    l.src = q->b;
+    l.srcN = q->nb;
+    loopRange(&l, 0, n);
+    nttRoots(m, w, n, root, q->pool);
+    if (q->pool != NULL)
+        poolSpawn(q->pool, &tb.task, &pending);
+    else
+        runBlock(&tb.task);
+    runBlock(&ta.task);
+    if (q->pool != NULL)
+        poolWait(q->pool, &pending);
+
+    l.body = pointwiseBody;
+    l.x = fa;
+    l.y = fb;
+    loopRange(&l, 0, n);
+    nttRoots(m, w, n, montPow(m, root, n - 1), q->pool);
+    ta.inverse = 1;
+    runBlock(&ta.task);
+    l.body = scaleBody;
+    l.y = q->x;
+    l.c = m->p - (m->p - 1) / n; // 1 / n, taking fa out of Montgomery form at the same time
+    loopRange(&l, 0, rn);
+}
+
+/**
+ * @brief Constants of the Chinese remainder theorem for the three primes.
+ */
+struct crt {
+    struct montgomery m[NTT_PRIMES];            /*!< the primes */
+    uint64_t inv01;                             /*!< 1 / p0 modulo p1 in Montgomery form */
+    uint64_t inv02;                             /*!< 1 / p0 modulo p2 in Montgomery form */
+    uint64_t inv12;                             /*!< 1 / p1 modulo p2 in Montgomery form */
+};
+
+/**
+ * @brief Recovery of a range of coefficients, run directly or as a task.
+ */
+struct crtRange {
+    struct task task;                           /*!< run by the pool */
+    const struct crt *c;                        /*!< the constants */
+    const uint64_t *x;                          /*!< residues modulo the three primes, rn each */
+    size_t rn;                                  /*!< number of coefficients */
+    limb_t *r;                                  /*!< receives the product */
+    size_t lo;                                  /*!< first coefficient */
+    size_t hi;                                  /*!< one after the last coefficient */
+    limb_t carry[2];                            /*!< receives what is carried out of r[hi - 1] */
+    struct pool *pool;                          /*!< the pool or NULL */
+};
+
+/**
+ * @brief Recovers a range of coefficients of the product from their residues.
+ * @details Garner's method: c = v0 + v1 * p0 + v2 * p0 * p1 with v0 = x0, v1 = (x1 - v0) / p0 modulo p1
+ * and v2 = ((x2 - v0) / p0 - v1) / p1 modulo p2. The coefficients are added up into r[lo] to r[hi - 1]
+ * with their carry. A larger range is halved into tasks, the carry of the lower half is then added
+ * to the upper one.
+ */
+static void runCrt(struct task *t)
+{
+    struct crtRange *q = (struct crtRange *)t;
+    if (q->pool != NULL && q->hi - q->lo > NTT_GRAIN)
+    {
+        size_t mid = q->lo + (q->hi - q->lo) / 2;
+        size_t hi = q->hi;
+        struct crtRange upper = *q;
+        upper.lo = mid;
+        int pending = 0;
+        poolSpawn(q->pool, &upper.task, &pending);
+        q->hi = mid;
+        runCrt(&q->task);
+        poolWait(q->pool, &pending);
+        limb_t over = addShifted(q->r + mid, hi - mid, q->carry, 2, 0);
+        q->carry[0] = upper.carry[0] + over;
+        q->carry[1] = upper.carry[1] + (q->carry[0] < over);
+        q->hi = hi;
+        return;
+    }
+
+    const struct montgomery *m = q->c->m;
+    uint64_t p0 = m[0].p, p1 = m[1].p, p2 = m[2].p;
+    dlimb_t p01 = (dlimb_t)p0 * p1;
+    const uint64_t *x0 = q->x, *x1 = x0 + q->rn, *x2 = x1 + q->rn;
+    limb_t acc0 = 0, acc1 = 0; // carry into the next coefficient
+    for (size_t i = q->lo; i < q->hi; i++)
+    {
+        uint64_t v0 = x0[i];
+        uint64_t v1 = montMul(&m[1], subMod(x1[i], (v0 >= p1) ? v0 - p1 : v0, p1), q->c->inv01);
+        uint64_t v2 = montMul(&m[2], subMod(x2[i], (v0 >= p2) ? v0 - p2 : v0, p2), q->c->inv02);
+        v2 = montMul(&m[2], subMod(v2, (v1 >= p2) ? v1 - p2 : v1, p2), q->c->inv12);
+
+        dlimb_t lo = (dlimb_t)v2 * (uint64_t)p01;
+        dlimb_t hi = (dlimb_t)v2 * (uint64_t)(p01 >> 64) + (limb_t)(lo >> 64);
+        dlimb_t c = (dlimb_t)v1 * p0 + v0 + (limb_t)lo; // the coefficient is c + (hi << 64)
+        dlimb_t s = (dlimb_t)acc0 + (limb_t)c;
+        q->r[i] = (limb_t)s;
+        s = (s >> 64) + acc1 + (limb_t)(c >> 64) + (limb_t)hi;
+        acc0 = (limb_t)s;
+        acc1 = (limb_t)(s >> 64) + (limb_t)(hi >> 64);
+    }
+    q->carry[0] = acc0;
+    q->carry[1] = acc1;
+}
+
+/**
+ * @brief Multiplies two numbers by number-theoretic transforms.
+ * @details With a pool the three primes, both forward transforms of a prime, the halves of every
+ * transform and all loops over the values run as tasks.
+ * @param a first factor.
+ * @param na number of limbs of a.
+ * @param b second factor.
+ * @param nb number of limbs of b.
+ * @param r receives the product, na + nb limbs, must not overlap a, b or scratch.
+ * @param scratch nttScratch(na + nb, pool != NULL) limbs of temporary space.
+ * @param pool the pool or NULL.
+ */
+void mulNtt(const limb_t *a, size_t na, const limb_t *b, size_t nb, limb_t *r, limb_t *scratch, struct pool *pool)
+{
+    size_t rn = na + nb;
+    size_t work = 3 * nttLength(rn);
+    struct crt c;
+    struct nttPrime q[NTT_PRIMES];
+    int pending = 0;
+
+    for (int i = 0; i < NTT_PRIMES; i++)
+    {
+        montInit(&c.m[i], nttPrimes[i]);
+        q[i] = (struct nttPrime){{runPrime, NULL}, &c.m[i], nttGenerators[i], a, na, b, nb, scratch + i * rn,
+                                 scratch + NTT_PRIMES * rn + (pool != NULL ? i * work : 0), pool};
+        if (pool != NULL && i < NTT_PRIMES - 1)
+            poolSpawn(pool, &q[i].task, &pending);
+        else if (pool == NULL)
+            runPrime(&q[i].task);
+    }
+    if (pool != NULL)
+    {
+        runPrime(&q[NTT_PRIMES - 1].task);
+        poolWait(pool, &pending);
+    }
+
+    const struct montgomery *m = c.m;
+    c.inv01 = montPow(&m[1], montMul(&m[1], m[0].p - m[1].p, m[1].r2), m[1].p - 2);
+    c.inv02 = montPow(&m[2], montMul(&m[2], m[0].p - m[2].p, m[2].r2), m[2].p - 2);
+    c.inv12 = montPow(&m[2], montMul(&m[2], m[1].p - m[2].p, m[2].r2), m[2].p - 2);
+    struct crtRange all = {{runCrt, NULL}, &c, scratch, rn, r, 0, rn, {0, 0}, pool};
+    runCrt(&all.task);
+}
+
+/**
+ * @brief Computes the scratch space mulEqual() needs.
+ * @details Karatsuba and Toom-3 keep their sums or values and the products that do not go straight
+ * into the result. Their subproducts share the rest one after the other, in parallel each one gets its
+ * own part.
+ * @param n number of limbs of each factor.
+ * @param parallel mulEqual() is called with a pool.
+ * @return number of limbs.
+ */
+size_t mulScratch(size_t n, int parallel)
+{
+    parallel = parallel && n >= MUL_GRAIN;
+    if (n < KARATSUBA_THRESHOLD)
+        return 0;
+    if (n >= NTT_THRESHOLD)
+        return nttScratch(2 * n, parallel);
+
+    size_t own, sizes[5];
+    int count;
+    if (n < TOOM3_THRESHOLD)
+    {
+        size_t m = n - n / 2;
+        own = 4 * (m + 1);
+        count = 3;
+        sizes[0] = n / 2;
+        sizes[1] = m;
+        sizes[2] = m + 1;
+    }
+    else
+    {
+        size_t k = (n + 2) / 3;
+        own = 12 * (k + 1);
+        count = 5;
+        sizes[0] = k;
+        sizes[1] = n - 2 * k;
+        sizes[2] = sizes[3] = sizes[4] = k + 1;
+    }
+    size_t sub = 0;
+    for (int i = 0; i < count; i++)
+    {
+        size_t s = mulScratch(sizes[i], parallel);
+        if (parallel)
+            sub += s;
+        else if (s > sub)
+            sub = s;
+    }
+    return own + sub;
+}
+
+/**
+ * @brief Multiplies two numbers of equal length by the fastest method for their length.
+ * @param a first factor.
+ * @param b second factor.
+ * @param n number of limbs of a and b.
+ * @param r receives the product, 2 * n limbs, must not overlap a, b or scratch.
+ * @param scratch mulScratch(n, pool != NULL) limbs of temporary space.
+ * @param pool pool for the subproducts, NULL to multiply on the calling thread.
+ */
+void mulEqual(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool)
+{
+    if (n < KARATSUBA_THRESHOLD)
+        mulSchoolbook(a, n, b, n, r);
+    else if (n < TOOM3_THRESHOLD)
+        mulKaratsuba(a, b, n, r, scratch, pool);
+    else if (n < NTT_THRESHOLD)
+        mulToom3(a, b, n, r, scratch, pool);
+    else
+        mulNtt(a, n, b, n, r, scratch, (n >= MUL_GRAIN) ? pool : NULL);
+}
@@ -0,0 +1,75 @@
+/**
+ * @file bignum.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Non-negative big integers as arrays of 64-bit limbs.
+ *
+ * A number is a limb array stored least significant limb first together with its length, the same
+ * number may carry leading zero limbs. Hexadecimal text is converted eight digits per step within a
+ * 64-bit word (SWAR), all arithmetic works on whole limbs.
+ *
+ * Products of equal length go through mulEqual(), which picks one of four tiers by the length: the
+ * schoolbook method, Karatsuba, Toom-3 and a number-theoretic transform. The thresholds between them
+ * come from "make bench-tiers". Given a thread pool, the subproducts of a split and the parts of a
+ * transform run as tasks down to a grain size, each with its own slice of the scratch space.
+ **/
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LIMB_DIGITS 16                          /*!< hex digits per limb */
+#ifndef KARATSUBA_THRESHOLD
+#define KARATSUBA_THRESHOLD 32                  /*!< mulKaratsuba() multiplies fewer limbs by the schoolbook method */
+#endif
+#ifndef TOOM3_THRESHOLD
+#define TOOM3_THRESHOLD 128                     /*!< mulEqual() multiplies fewer limbs by the Karatsuba method */
+#endif
+#ifndef NTT_THRESHOLD
+#define NTT_THRESHOLD 2048                      /*!< mulEqual() multiplies fewer limbs by the Toom-3 method */
+#endif
+#ifndef MUL_GRAIN
+#define MUL_GRAIN 512                           /*!< products of fewer limbs do not split into tasks */
+#endif
+#ifndef NTT_GRAIN
+#define NTT_GRAIN 16384                         /*!< values a transform task works on at least */
+#endif
+#if KARATSUBA_THRESHOLD < 4
+#error "KARATSUBA_THRESHOLD has to be at least 4, the halves of smaller numbers do not get shorter"
+#endif
+#if TOOM3_THRESHOLD < 5
+#error "TOOM3_THRESHOLD has to be at least 5, smaller numbers do not have three parts"
+#endif
+#if NTT_GRAIN < 4
+#error "NTT_GRAIN has to be at least 4, a half of a range has to hold a carry of two limbs"
+#endif
+
+struct pool;
+
+typedef uint64_t limb_t;                        /*!< one digit of base 2^64 */
+__extension__ typedef unsigned __int128 dlimb_t; /*!< holds the product of two limbs */
+
+/**
+ * @brief A number owning its limbs.
+ */
+struct bignum {
+    limb_t *limb;                               /*!< the limbs, least significant first */
+    size_t n;                                   /*!< number of limbs */
+};
+
+int hexToLimbs(const char *str, size_t len, limb_t *limbs);
+size_t limbsToHex(const limb_t *limbs, size_t n, char *str);
+limb_t addN(limb_t *r, const limb_t *a, size_t na, const limb_t *b, size_t nb);
+limb_t addShifted(limb_t *r, size_t rn, const limb_t *x, size_t xn, size_t offset);
+limb_t subInPlace(limb_t *r, size_t rn, const limb_t *x, size_t xn);
+void mulSchoolbook(const limb_t *a, size_t na, const limb_t *b, size_t nb, limb_t *r);
+void mulKaratsuba(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool);
+void mulToom3(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool);
+size_t nttScratch(size_t rn, int parallel);
+void mulNtt(const limb_t *a, size_t na, const limb_t *b, size_t nb, limb_t *r, limb_t *scratch, struct pool *pool);
+size_t mulScratch(size_t n, int parallel);
+void mulEqual(const limb_t *a, const limb_t *b, size_t n, limb_t *r, limb_t *scratch, struct pool *pool);
+
+#endif
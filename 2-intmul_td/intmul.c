@@ -3,39 +3,59 @@
  * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
  * @date 26.05.2019
  * 
- * @brief Large Integer Multiplikation by fork
+ * @brief Large Integer Multiplikation by threads
  * 
- * @detail: allows to multiply large hexadecimal numbers of length that is within the power of two.
+ * @detail: allows to multiply large hexadecimal numbers of equal length. The input is read in large
+ * blocks into one growing buffer, its digits are checked and converted into 64-bit limbs in a single
+ * pass and multiplied by mulEqual(), which picks schoolbook, Karatsuba, Toom-3 or a
+ * number-theoretic transform by their length. With -4 the numbers are split into four products down to
+ * LEAF_LIMBS limbs instead, below which the schoolbook method is used. The subproducts run as tasks of
+ * a work-stealing thread pool with -t threads, by default one per processor. Once both operands are
+ * read, one arena sized from their length holds the factors, the product, the scratch space of the
+ * whole recursion and the hex output, so nothing is allocated while multiplying. Only the final
+ * product is converted back to hex, -m prints the memory used to stderr.
  **/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
-#include <sys/wait.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/resource.h>
+#include "bignum.h"
+#include "pool.h"
 
-#define CHILD_NUM 4 /*!< maximum child number */
-#define BUF_SIZE 4  /*!< standard buf size */
-
-#define PIPE_R 0
-#define PIPE_W 1
-#define PIPE_TO_C 0
-#define PIPE_FROM_C 1
-static int pipes[CHILD_NUM][2][2]; /*!< proc,pipe-{from|to}-c,{read|write} */
+#define SPLIT_NUM 4 /*!< products of the four-way split */
+#define READ_SIZE 65536 /*!< initial input buffer, it doubles whenever it is full */
+#ifndef LEAF_LIMBS
+#define LEAF_LIMBS 2048 /*!< with -4 operands of at most this many limbs are not split, see "make bench-leaf" */
+#endif
 
 static char *name = NULL;                                   /*!< program name */
-static char *strNum1 = NULL;                                /*!< first Number as string */
-static char *strNum2 = NULL;                                /*!< second Numer as string */
-static int inputLength = 0;                                 /*!< input Length of strNum1 and strNum2 */
-static char *Al = NULL;                                     /*!< number Al */
-static char *Ah = NULL;                                     /*!< number Ah */
-static char *Bl = NULL;                                     /*!< Number Bl */
-static char *Bh = NULL;                                     /*!< Number Bh */
-static char *results[CHILD_NUM] = {NULL, NULL, NULL, NULL}; /*!< results of multiplicaiton Ah * Bh * 100 ; Ah * Bl * 10 : Al * Bh * 10 ; Ab * Bh */
-static size_t chars[CHILD_NUM];                             /*!< length of chars in results */
+static char *input = NULL;                                  /*!< the input lines */
+static int fourWay = 0;                                     /*!< set by `-4`: split into four products instead of mulEqual() */
+static int threads = 0;                                     /*!< set by `-t`: threads of the pool, 0 for one per processor */
+static int memoryReport = 0;                                /*!< set by `-m`: print the memory used to stderr */
+
+/**
+ * @brief One block of memory handed out front to back, sized before anything is taken from it.
+ */
+struct arena {
+    limb_t *base;                               /*!< the block */
+    size_t size;                                /*!< limbs in the block */
+    size_t used;                                /*!< limbs handed out so far */
+};
+
+static struct arena arena = {NULL, 0, 0};                   /*!< all memory of the multiplication */
+static struct bignum num1 = {NULL, 0};                      /*!< first factor, in the arena */
+static struct bignum num2 = {NULL, 0};                      /*!< second factor, in the arena */
+static struct bignum product = {NULL, 0};                   /*!< num1 * num2, in the arena */
+static struct bignum scratch = {NULL, 0};                   /*!< temporary space of the multiplication, in the arena */
+static char *hex = NULL;                                    /*!< the product as text, in the arena */
+static struct pool pool;                                    /*!< the thread pool, started if threads > 1 */
+static int poolStarted = 0;                                 /*!< pool has to be stopped */
 
 /**
  * @brief clean up function.
@@ -45,25 +65,30 @@ static size_t chars[CHILD_NUM];                             /*!< length of chars
  */
 void cleanUp(void)
 {
-    free(strNum1);
-    free(strNum2);
+    if (poolStarted)
+        poolStop(&pool);
+    poolStarted = 0;
+    free(input);
+    input = NULL;
+    free(arena.base);
+    arena.base = NULL;
 }
 
 /**
- * @brief clean up results function.
- * @details This function will clean up all remaining allocations of the results array.
- * @return void
+ * @brief Prints the usage and exits.
  * @param void
+ * @return void
  */
-void cleanUpResults(void)
+void usage(void)
 {
-    for (int i = 0; i < CHILD_NUM; i++)
-        free(results[i]);
+    fprintf(stderr, "Usage: %s [-4] [-m] [-t threads]\n",
+            name);
+    exit(EXIT_FAILURE);
 }
 
 /**
  * @brief Reads in all arguments and parses them.
- * @details Assures that no flags and arguments have been supplied. 
+ * @details Assures that no arguments and no flags but `-4`, `-m` and `-t` with 1 to POOL_MAX_THREADS threads have been supplied.
  * @param argc Number of arguments..
  * @param argv Argument Vector.
  * @return void
@@ -72,152 +97,288 @@ void getArgs(int argc, char **argv)
 {
     name = argv[0];
     int opt;
-    while ((opt = getopt(argc, argv, "")) != -1)
+    while ((opt = getopt(argc, argv, "4mt:")) != -1)
     {
+        char *end;
         switch (opt)
         {
+        case '4':
+            fourWay = 1;
+            break;
+        case 'm':
+            memoryReport = 1;
+            break;
+        case 't':
+            threads = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || threads < 1 || threads > POOL_MAX_THREADS)
+                usage();
+            break;
         default: /* '?' */
-            fprintf(stderr, "Usage: %s\n",
-                    argv[0]);
-            exit(EXIT_FAILURE);
+            usage();
         }
     }
     if (argc - optind != 0)
+        usage();
+    if (threads == 0)
     {
-        fprintf(stderr, "Usage: %s\n",
-                argv[0]);
-        exit(EXIT_FAILURE);
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus < 1) ? 1 : (cpus > POOL_MAX_THREADS) ? POOL_MAX_THREADS : cpus;
     }
 }
 
 /**
- * @brief Reads in one line of characters from stdin
- * @details Dynamically allocated buffer that can read one very long line from stdin. It does not assure that the input is usable as hexadecimal number.
- * @param void
- * @return (char *) pointing to the beginning of the memory wher the line is stored.
+ * @brief Reads the first two lines of stdin.
+ * @details The buffer grows geometrically and is filled by read() calls as large as its free space, so reading
+ * is linear in the length of the input. Reading stops after the second newline or at the end of the input. It
+ * does not assure that the lines are usable as hexadecimal numbers.
+ * @param len receives the number of bytes read.
+ * @return (char *) pointing to the bytes read, NULL on read or memory error.
  */
-char *readString(void)
+char *readInput(size_t *len)
 {
-    char buf[BUF_SIZE];
-    char *str;
-    size_t strSize = 1; // including the 0 after the following malloc
-    str = malloc(sizeof(char) * BUF_SIZE);
-    if (str == NULL)
+    size_t size = READ_SIZE;
+    size_t used = 0;
+    int newlines = 0;
+    char *buf = malloc(size);
+    if (buf == NULL)
     {
         fprintf(stderr, "%s, ERROR: could not allocate enough memory!\n", name);
-        exit(EXIT_FAILURE);
+        return NULL;
     }
-    str[0] = '\0';
-    while (fgets(buf, BUF_SIZE, stdin))
+    while (newlines < 2)
     {
-        char *from = str;
-        strSize += strlen(buf);
-        str = realloc(str, strSize);
-        if (str == NULL)
+        if (used == size)
+        {
+            char *grown = realloc(buf, 2 * size);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "%s, ERROR: could not allocate enough memory!\n", name);
+                free(buf);
+                return NULL;
+            }
+            buf = grown;
+            size *= 2;
+        }
+        ssize_t got = read(STDIN_FILENO, buf + used, size - used);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
         {
-            free(from);
+            fprintf(stderr, "%s, ERROR: could not read input: %s\n", name, strerror(errno));
+            free(buf);
             return NULL;
         }
-        strcat(str, buf);
-        char *pos;
-        if ((pos = strchr(buf, '\n')) != NULL)
+        if (got == 0)
             break;
+        for (char *nl = buf + used; newlines < 2 && (nl = memchr(nl, '\n', buf + used + got - nl)) != NULL; nl++)
+            newlines++;
+        used += got;
     }
-    if (ferror(stdin))
-    {
-        free(str);
-        return NULL;
-    }
-    return str;
+    *len = used;
+    return buf;
 }
 
 /**
- * @brief parses a char (hex) to an int (dec)
- * @details Gets a char, interprets it as a hexadecimal value and returns its decimal value as an unsigned integer
- * @param char c char that should get converted
- * @return unsigned int value in decimal of the hexadecimal interpretation of char
+ * @brief Finds the end of a line.
+ * @param str the line.
+ * @param len bytes left in the input.
+ * @return number of bytes before the newline, len if there is none.
  */
-unsigned int parseChar(char c)
+size_t lineLength(const char *str, size_t len)
 {
-    if ('0' <= c && c <= '9')
-        return c - '0';
-    if ('a' <= c && c <= 'f')
-        return 10 + c - 'a';
-    if ('A' <= c && c <= 'F')
-        return 10 + c - 'A';
-    cleanUp();
-    cleanUpResults();
-    exit(EXIT_FAILURE);
+    const char *nl = memchr(str, '\n', len);
+    return (nl == NULL) ? len : (size_t)(nl - str);
+}
+
+/**
+ * @brief Allocates the arena.
+ * @details Exits on memory error.
+ * @param limbs size of the arena.
+ * @return void
+ */
+void arenaInit(size_t limbs)
+{
+    arena.base = malloc((limbs > 0 ? limbs : 1) * sizeof(limb_t));
+    arena.size = limbs;
+    arena.used = 0;
+    if (arena.base == NULL)
+    {
+        fprintf(stderr, "%s, ERROR: could not allocate enough memory!\n", name);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
- * @brief parses a int (dec) to an char (hex)
- * @details Gets a integer, interprets converts it the hexadecimal represenation stored as a char
- * @param  unsigned int that should get converted
- * @return char c value in hexadecimal of the decimal interpretation of int
+ * @brief Takes the next limbs of the arena.
+ * @details The arena is sized for everything taken from it, running out of it is a bug.
+ * @param limbs number of limbs.
+ * @return the limbs.
  */
-char parseInt(int c)
+limb_t *arenaTake(size_t limbs)
 {
-    switch (c)
+    if (limbs > arena.size - arena.used)
     {
-    case 0:
-        return '0';
-    case 1:
-        return '1';
-    case 2:
-        return '2';
-    case 3:
-        return '3';
-    case 4:
-        return '4';
-    case 5:
-        return '5';
-    case 6:
-        return '6';
-    case 7:
-        return '7';
-    case 8:
-        return '8';
-    case 9:
-        return '9';
-    case 10:
-        return 'a';
-    case 11:
-        return 'b';
-    case 12:
-        return 'c';
-    case 13:
-        return 'd';
-    case 14:
-        return 'e';
-    case 15:
-        return 'f';
-    default:
+        fprintf(stderr, "%s, ERROR: arena of %zu limbs exhausted!\n", name, arena.size);
         cleanUp();
-        cleanUpResults();
         exit(EXIT_FAILURE);
     }
+    limb_t *taken = arena.base + arena.used;
+    arena.used += limbs;
+    return taken;
+}
+
+/**
+ * @brief Computes the limbs needed for the hex output of a product.
+ * @param n number of limbs of the product.
+ * @return number of limbs holding the n * LIMB_DIGITS + 2 bytes limbsToHex() needs.
+ */
+size_t hexLimbs(size_t n)
+{
+    return (n * LIMB_DIGITS + 2 + sizeof(limb_t) - 1) / sizeof(limb_t);
+}
+
+/**
+ * @brief Prints the memory used to stderr.
+ * @details The parts of the arena are computed from the number of limbs of the factors, the peak is the
+ * largest resident set of the process, which includes the input lines and the stacks of the threads.
+ * @param n number of limbs of each factor.
+ * @return void
+ */
+void printMemory(size_t n)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0)
+        usage.ru_maxrss = 0;
+    fprintf(stderr, "arena %zu bytes: factors %zu, product %zu, scratch %zu, output %zu; peak resident %ld KiB\n",
+            arena.size * sizeof(limb_t), 2 * n * sizeof(limb_t), product.n * sizeof(limb_t),
+            scratch.n * sizeof(limb_t), hexLimbs(product.n) * sizeof(limb_t), (long)usage.ru_maxrss);
+}
+
+/**
+ * @brief One product of the four-way split, run directly or as a task.
+ */
+struct fourWayProduct {
+    struct task task;                           /*!< run by the pool */
+    const limb_t *a;                            /*!< first factor */
+    size_t na;                                  /*!< number of limbs of a */
+    const limb_t *b;                            /*!< second factor */
+    size_t nb;                                  /*!< number of limbs of b */
+    limb_t *r;                                  /*!< receives the product, na + nb limbs */
+    limb_t *scratch;                            /*!< temporary space of this product */
+    int levels;                                 /*!< levels of the split that still spawn tasks */
+};
+
+/**
+ * @brief Computes the scratch space of the four-way split.
+ * @details Every factor of a split of numbers of at most n limbs has at most n - n / 2 limbs. Each split
+ * keeps three products of at most twice that, the fourth goes straight into the result. Below the
+ * levels that spawn tasks the four products share the rest one after the other.
+ * @param n the larger number of limbs of the factors.
+ * @param levels levels of the split that spawn tasks.
+ * @return number of limbs.
+ */
+size_t fourWayScratch(size_t n, int levels)
+{
+    if (n <= LEAF_LIMBS)
+        return 0;
+    size_t half = n - n / 2;
+    return 3 * 2 * half + (levels > 0 ? SPLIT_NUM : 1) * fourWayScratch(half, levels - 1);
+}
+
+void runFourWay(struct task *t);
+
+/**
+ * @brief multiplies by the four-way split.
+ * @details Both factors are split at h limbs. With a = Ah * 2^64h + Al and b = Bh * 2^64h + Bl the product is
+ * (Ah * Bh) * 2^128h + (Ah * Bl + Al * Bh) * 2^64h + Al * Bl. Al * Bl is computed in place, the other three
+ * products into slices of the scratch space and added into r at their offset afterwards. Numbers of up to
+ * LEAF_LIMBS limbs are multiplied by the schoolbook method.
+ * @param p the factors, the result and the scratch space of fourWayScratch().
+ * @return void
+ */
+void multiplyFourWay(struct fourWayProduct *p)
+{
+    size_t na = p->na, nb = p->nb;
+    if (na == 0 || nb == 0)
+    {
+        memset(p->r, 0, (na + nb) * sizeof(limb_t));
+        return;
+    }
+    if (na <= LEAF_LIMBS && nb <= LEAF_LIMBS)
+    {
+        mulSchoolbook(p->a, na, p->b, nb, p->r);
+        return;
+    }
+    size_t n = (na > nb) ? na : nb;
+    size_t h = n / 2;
+    size_t half = n - h;
+    size_t al = (na < h) ? na : h;
+    size_t bl = (nb < h) ? nb : h;
+    int parallel = (p->levels > 0);
+    size_t sub = fourWayScratch(half, p->levels - 1);
+    limb_t *slices = p->scratch;
+    limb_t *next = slices + 3 * 2 * half;
+    struct fourWayProduct parts[SPLIT_NUM] = {
+        {.a = p->a + al, .na = na - al, .b = p->b + bl, .nb = nb - bl, .r = slices},                // Ah * Bh
+        {.a = p->a + al, .na = na - al, .b = p->b, .nb = bl, .r = slices + 2 * half},              // Ah * Bl
+        {.a = p->a, .na = al, .b = p->b + bl, .nb = nb - bl, .r = slices + 4 * half},              // Al * Bh
+        {.a = p->a, .na = al, .b = p->b, .nb = bl, .r = p->r},                                      // Al * Bl
+    };
+    size_t offset[SPLIT_NUM] = {2 * h, h, h, 0};
+    int pending = 0;
+
+    for (int i = 0; i < SPLIT_NUM; i++)
+    {
+        parts[i].task.run = runFourWay;
+        parts[i].scratch = parallel ? next + i * sub : next;
+        parts[i].levels = p->levels - 1;
+        if (parallel && i < SPLIT_NUM - 1)
+            poolSpawn(&pool, &parts[i].task, &pending);
+        else if (!parallel)
+            multiplyFourWay(&parts[i]);
+    }
+    if (parallel)
+    {
+        multiplyFourWay(&parts[SPLIT_NUM - 1]);
+        poolWait(&pool, &pending);
+    }
+    memset(p->r + al + bl, 0, (na + nb - al - bl) * sizeof(limb_t));
+    for (int i = 0; i < SPLIT_NUM - 1; i++)
+        addShifted(p->r, na + nb, parts[i].r, parts[i].na + parts[i].nb, offset[i]);
 }
 
 /**
- * @brief sets pointers for the Arithmetic operations.
- * @details Ah, Al, Bh, Bl will allways be accesed through [0]. So it actually just points to the values that we want to work with.
- * @param  void
+ * @brief Runs a product of the four-way split as a task.
+ * @param t the product.
  * @return void
  */
-void generatePointers(void)
+void runFourWay(struct task *t)
+{
+    multiplyFourWay((struct fourWayProduct *)t);
+}
+
+/**
+ * @brief Counts the levels of the four-way split that spawn tasks.
+ * @details Tasks are spawned until there are at least four for every thread.
+ * @param void
+ * @return number of levels, 0 without a pool.
+ */
+int fourWayLevels(void)
 {
-    Ah = strNum1;
-    Al = strNum1 + ((inputLength - 1) / 2);
-    Bh = strNum2;
-    Bl = strNum2 + ((inputLength - 1) / 2);
+    int levels = 0;
+    for (long tasks = 1; poolStarted && tasks < 4L * threads; tasks *= SPLIT_NUM)
+        levels++;
+    return levels;
 }
 
 /**
  * Program entry point.
- * Formula (Ah * Bh * 100) + (Ah * Bl * 10) + (Al * Bh * 10) + (Al * Bl)
+ * Formula (Ah * Bh * 2^128h) + (Ah * Bl * 2^64h) + (Al * Bh * 2^64h) + (Al * Bl)
  * @brief Calculates the multiplicaiton of two hexadecimal numbers A * B
- * @details Program first reads two large numbers, then splits them up to calculate them by the formula shown above by forkig itself until no forthuer split is possible.
+ * @details Program first reads two large numbers, then multiplies them with mulEqual() or, with -4, by splitting
+ * them up by the formula shown above until the parts are small enough for the schoolbook method. All memory of the
+ * multiplication is one arena allocated before it starts.
  * @param argc The argument counter.
  * @param argv The argument vector.
  * @return Returns EXIT_SUCCESS.
@@ -227,302 +388,74 @@ int main(int argc, char **argv)
     // Handle getopt
     getArgs(argc, argv);
 
-    // Read into dynamic buffers
-    strNum1 = readString();
-    if (strNum1 == NULL)
-    {
-        exit(EXIT_FAILURE);
-    }
-    strNum2 = readString();
-    if (strNum2 == NULL)
+    // Read both lines at once
+    size_t inputLen;
+    input = readInput(&inputLen);
+    if (input == NULL)
     {
-        free(strNum1);
         exit(EXIT_FAILURE);
     }
+    const char *strNum1 = input;
+    size_t len = lineLength(strNum1, inputLen);
+    const char *strNum2 = input + len + (len < inputLen);
+    size_t len2 = lineLength(strNum2, input + inputLen - strNum2);
 
-    //TODO: check equal length
-    if (strlen(strNum1) != strlen(strNum2))
+    // both numbers have to be of equal length
+    if (len == 0 || len2 != len)
     {
         cleanUp();
         exit(EXIT_FAILURE);
     }
-    inputLength = strlen(strNum1);
 
-    if (strlen(strNum1) < 2 || strlen(strNum2) < 2)
+    if (threads > 1)
     {
-        cleanUp();
-        exit(EXIT_FAILURE);
-    }
-
-    // check length is one and multiply
-    if (strlen(strNum1) == 2 && strlen(strNum2) == 2)
-    {
-        fprintf(stdout, "%1x", parseChar(strNum1[0]) * parseChar(strNum2[0]));
-        cleanUp();
-        exit(EXIT_SUCCESS);
-    }
-
-    //TODO: Fork work to childs
-    pid_t procs[CHILD_NUM] = {-1, -1, -1, -1};
-    int childs = 0;
-    int status[CHILD_NUM];
-
-    for (int i = 0; i < CHILD_NUM; i++)
-    {
-        if (pipe(pipes[i][PIPE_TO_C]) == -1)
-        {
-            cleanUp();
-            exit(EXIT_FAILURE);
-        }
-        if (pipe(pipes[i][PIPE_FROM_C]) == -1)
+        if (poolStart(&pool, threads) < 0)
         {
+            fprintf(stderr, "%s, ERROR: could not start %d threads!\n", name, threads);
             cleanUp();
             exit(EXIT_FAILURE);
         }
+        poolStarted = 1;
     }
 
-    do
+    // everything from here on lives in one arena sized by the length
+    size_t n = (len + LIMB_DIGITS - 1) / LIMB_DIGITS;
+    int levels = fourWayLevels();
+    num1.n = num2.n = n;
+    product.n = 2 * n;
+    scratch.n = fourWay ? fourWayScratch(n, levels) : mulScratch(n, poolStarted);
+    arenaInit(2 * n + product.n + scratch.n + hexLimbs(product.n));
+    num1.limb = arenaTake(n);
+    num2.limb = arenaTake(n);
+    product.limb = arenaTake(product.n);
+    scratch.limb = arenaTake(scratch.n);
+    hex = (char *)arenaTake(hexLimbs(product.n));
+
+    // converted to limbs once
+    if (hexToLimbs(strNum1, len, num1.limb) < 0 || hexToLimbs(strNum2, len, num2.limb) < 0)
     {
-        procs[childs] = fork();
-        if (procs[childs] == -1)
-        {
-            cleanUp();
-            exit(EXIT_FAILURE);
-        }
-        if (procs[childs] == 0)
-            break;
-        childs++;
-    } while (childs < CHILD_NUM);
-    if (childs == 4)
-        childs--;
-
-    if (procs[childs] == 0)
-    { // child
-        // close own pipes
-        close(pipes[childs][PIPE_FROM_C][PIPE_R]);
-        close(pipes[childs][PIPE_TO_C][PIPE_W]);
-
-        // close pipes to other childs
-        for (int i = 0; i < CHILD_NUM; i++)
-        {
-            if (i == childs)
-            {
-                continue;
-            }
-            else
-            {
-                close(pipes[i][PIPE_FROM_C][PIPE_R]);
-                close(pipes[i][PIPE_FROM_C][PIPE_W]);
-                close(pipes[i][PIPE_TO_C][PIPE_R]);
-                close(pipes[i][PIPE_TO_C][PIPE_W]);
-            }
-        }
-
-        // route pipes
-        dup2(pipes[childs][PIPE_FROM_C][PIPE_W], STDOUT_FILENO);
-        dup2(pipes[childs][PIPE_TO_C][PIPE_R], STDIN_FILENO);
+        cleanUp();
+        exit(EXIT_FAILURE);
+    }
+    free(input);
+    input = NULL;
 
-        execlp(name, name, NULL);
-        fflush(stdout);
-        close(pipes[childs][PIPE_FROM_C][PIPE_W]);
-        close(pipes[childs][PIPE_TO_C][PIPE_R]);
+    if (fourWay)
+    {
+        struct fourWayProduct all = {.a = num1.limb, .na = n, .b = num2.limb, .nb = n, .r = product.limb,
+                                     .scratch = scratch.limb, .levels = levels};
+        multiplyFourWay(&all);
     }
     else
-    { // parent
-
-        // close pipes to other childs
-        for (int i = 0; i < CHILD_NUM; i++)
-        {
-            close(pipes[i][PIPE_FROM_C][PIPE_W]);
-            close(pipes[i][PIPE_TO_C][PIPE_R]);
-        }
-
-        // Child 0: Ah * Bh
-        generatePointers();
-        while (Ah != Al)
-        {
-            dprintf(pipes[0][PIPE_TO_C][PIPE_W], "%c", Ah[0]);
-            Ah++;
-        }
-        dprintf(pipes[0][PIPE_TO_C][PIPE_W], "\n");
-        while (Bh != Bl)
-        {
-            dprintf(pipes[0][PIPE_TO_C][PIPE_W], "%c", Bh[0]);
-            Bh++;
-        }
-        dprintf(pipes[0][PIPE_TO_C][PIPE_W], "\n");
-        close(pipes[0][PIPE_TO_C][PIPE_W]);
-
-        // Child 1: Ah * Bl
-        generatePointers();
-        while (Ah != Al)
-        {
-            dprintf(pipes[1][PIPE_TO_C][PIPE_W], "%c", Ah[0]);
-            Ah++;
-        }
-        dprintf(pipes[1][PIPE_TO_C][PIPE_W], "\n");
-        dprintf(pipes[1][PIPE_TO_C][PIPE_W], "%s", Bl);
-        close(pipes[1][PIPE_TO_C][PIPE_W]);
-
-        // Child 2: Al * Bh
-        generatePointers();
-        dprintf(pipes[2][PIPE_TO_C][PIPE_W], "%s", Al);
-        while (Bh != Bl)
-        {
-            dprintf(pipes[2][PIPE_TO_C][PIPE_W], "%c", Bh[0]++);
-            Bh++;
-        }
-        dprintf(pipes[2][PIPE_TO_C][PIPE_W], "\n");
-        close(pipes[2][PIPE_TO_C][PIPE_W]);
-
-        // Child 3: Al * Bl
-        generatePointers();
-        dprintf(pipes[3][PIPE_TO_C][PIPE_W], "%s", Al);
-        dprintf(pipes[3][PIPE_TO_C][PIPE_W], "%s", Bl);
-        close(pipes[3][PIPE_TO_C][PIPE_W]);
-
-        //read from pipes
-        for (int i = 0; i < CHILD_NUM; i++)
-        {
-            FILE *fd = fdopen(pipes[i][PIPE_FROM_C][PIPE_R], "r");
-            if (fd == NULL)
-            {
-                cleanUp();
-                exit(EXIT_FAILURE);
-            }
-            if (getline(&results[i], &chars[i], fd) == -1)
-            {
-                fclose(fd);
-                while (i > 0)
-                {
-                    close(pipes[i][PIPE_FROM_C][PIPE_R]);
-                    free(results[i]);
-                    i--;
-                }
-                free(results[i]);
-                for (int i = 0; i < CHILD_NUM; i++)
-                    close(pipes[i][PIPE_FROM_C][PIPE_R]);
-                cleanUp();
-                exit(EXIT_FAILURE);
-            }
-            fclose(fd);
-            close(pipes[i][PIPE_FROM_C][PIPE_R]);
-        }
-
-        // wait for child to finish
-        for (int i = 0; i < CHILD_NUM; i++)
-        {
-            waitpid(procs[i], &status[i], 0);
-        }
-
-        // exit if there was an error within a child
-        for (int i = 0; i < CHILD_NUM; i++)
-        {
-            if (status[i] != 0)
-            {
-                cleanUp();
-                cleanUpResults();
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        // handle the result
-        chars[0] = strlen(results[0]);
-        chars[1] = strlen(results[1]);
-        chars[2] = strlen(results[2]);
-        chars[3] = strlen(results[3]);
-        int offset = inputLength - 1;
-        int offsetHalf = (inputLength - 1) / 2;
-        unsigned int c3_val = 0;
-        unsigned int c2_val = 0;
-        unsigned int c1_val = 0;
-        unsigned int c0_val = 0;
-        unsigned int retval = 0;
-        unsigned int overflow = 0;
-        char buf[(2 * inputLength) + 1];
-        memset(buf, 0, (2 * inputLength) + 1);
-        char *bufPnt = buf;
-        while (chars[0] > 0 || chars[1] > 0 || chars[2] > 0 || chars[3] > 0)
-        {
-            if (offset > 0)
-            {
-                offset--;
-                c0_val = 0;
-            }
-            else
-            {
-                if (chars[0] > 0)
-                {
-                    c0_val = parseChar(results[0][chars[0] - 1]);
-                    chars[0]--;
-                }
-                else
-                {
-                    c0_val = 0;
-                }
-            }
-            if (offsetHalf > 0)
-            {
-                offsetHalf--;
-                c1_val = 0;
-                c2_val = 0;
-            }
-            else
-            {
-                if (chars[1] > 0)
-                {
-                    c1_val = parseChar(results[1][chars[1] - 1]);
-                    chars[1]--;
-                }
-                else
-                {
-                    c1_val = 0;
-                }
-                if (chars[2] > 0)
-                {
-                    c2_val = parseChar(results[2][chars[2] - 1]);
-                    chars[2]--;
-                }
-                else
-                {
-                    c2_val = 0;
-                }
-            }
-            if (chars[3] > 0)
-            {
-                c3_val = parseChar(results[3][chars[3] - 1]);
-                chars[3]--;
-            }
-            else
-            {
-                c3_val = 0;
-            }
-
-            retval = c3_val + c2_val + c1_val + c0_val + overflow;
-            overflow = retval / 16;
-            sprintf(bufPnt, "%c", parseInt(retval % 16));
-            bufPnt++;
-        }
-        if (overflow != 0)
-            sprintf(bufPnt, "%c", parseInt(overflow % 16));
-        else
-            bufPnt--;
-
-        // print the result
-        int h = 1;
-        while (bufPnt != buf)
-        {
-            if (bufPnt[0] != '0' || h == 0)
-            {
-                fprintf(stdout, "%c", bufPnt[0]);
-                h = 0;
-            }
-            bufPnt--;
-        }
-        fprintf(stdout, "%c", bufPnt[0]);
+    {
+        mulEqual(num1.limb, num2.limb, n, product.limb, scratch.limb, poolStarted ? &pool : NULL);
     }
+
+    // print the result
+    fwrite(hex, 1, limbsToHex(product.limb, product.n, hex), stdout);
     fflush(stdout);
+    if (memoryReport)
+        printMemory(n);
     cleanUp();
-    cleanUpResults();
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,190 @@
+/**
+ * @file pool.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Work-stealing thread pool for fork-join recursion.
+ *
+ * Each deque has its own lock, the owner and the thieves of a deque rarely meet since they work at
+ * opposite ends and tasks are coarse. Threads without work sleep on the condition variable of the
+ * pool until a task is queued, a waiting spawner instead yields while its stolen tasks still run.
+ **/
+#include <sched.h>
+#include <string.h>
+#include "pool.h"
+
+static __thread int self = 0;                   /*!< index of the calling thread in its pool */
+
+/**
+ * @brief Takes the newest task of the own deque.
+ * @return the task, NULL if the deque is empty.
+ */
+static struct task *popBottom(struct pool *p)
+{
+    struct deque *d = &p->deques[self];
+    struct task *t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bottom != d->top)
+        t = d->tasks[--d->bottom % POOL_DEQUE];
+    pthread_mutex_unlock(&d->lock);
+    if (t != NULL)
+        __atomic_sub_fetch(&p->queued, 1, __ATOMIC_RELAXED);
+    return t;
+}
+
+/**
+ * @brief Takes the oldest task of another deque, trying all of them once.
+ * @return the task, NULL if all deques are empty.
+ */
+static struct task *steal(struct pool *p)
+{
+    for (int i = 1; i < p->threads; i++)
+    {
+        struct deque *d = &p->deques[(self + i) % p->threads];
+        struct task *t = NULL;
+        pthread_mutex_lock(&d->lock);
+        if (d->bottom != d->top)
+            t = d->tasks[d->top++ % POOL_DEQUE];
+        pthread_mutex_unlock(&d->lock);
+        if (t != NULL)
+        {
+            __atomic_sub_fetch(&p->queued, 1, __ATOMIC_RELAXED);
+            return t;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs a task and marks it done.
+ * @details The task belongs to the frame of its spawner, it must not be touched after the counter drops.
+ */
+static void runTask(struct task *t)
+{
+    int *pending = t->pending;
+    t->run(t);
+    __atomic_sub_fetch(pending, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Body of the started threads.
+ */
+static void *worker(void *arg)
+{
+    struct pool *p = arg;
+    pthread_mutex_lock(&p->lock);
+    self = ++p->started;
+    pthread_mutex_unlock(&p->lock);
+    for (;;)
+    {
+        struct task *t = popBottom(p);
+        if (t == NULL)
+            t = steal(p);
+        if (t != NULL)
+        {
+            runTask(t);
+            continue;
+        }
+        pthread_mutex_lock(&p->lock);
+        while (__atomic_load_n(&p->queued, __ATOMIC_RELAXED) == 0 && p->stop == 0)
+            pthread_cond_wait(&p->wake, &p->lock);
+        int stop = p->stop;
+        pthread_mutex_unlock(&p->lock);
+        if (stop)
+            return NULL;
+    }
+}
+
+/**
+ * @brief Starts a pool, the calling thread becomes its first thread.
+ * @param p the pool.
+ * @param threads threads including the calling one, 1 to POOL_MAX_THREADS.
+ * @return 0 on success, -1 on error.
+ */
+int poolStart(struct pool *p, int threads)
+{
+    memset(p, 0, sizeof(*p));
+    if (threads < 1 || threads > POOL_MAX_THREADS)
+        return -1;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    for (int i = 0; i < POOL_MAX_THREADS; i++)
+        pthread_mutex_init(&p->deques[i].lock, NULL);
+    self = 0;
+    p->threads = threads; // deques of threads that did not start yet are empty, stealing from them is harmless
+    for (; p->created < threads - 1; p->created++)
+    {
+        if (pthread_create(&p->ids[p->created + 1], NULL, worker, p) != 0)
+        {
+            poolStop(p);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a task for any thread of the pool.
+ * @details The counter is incremented now and decremented once the task has run. If the deque of the
+ * calling thread is full the task runs right away.
+ * @param p the pool.
+ * @param t the task, it has to stay valid until poolWait() on the counter returned.
+ * @param pending counter of the spawner.
+ */
+void poolSpawn(struct pool *p, struct task *t, int *pending)
+{
+    struct deque *d = &p->deques[self];
+    t->pending = pending;
+    __atomic_add_fetch(pending, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&d->lock);
+    int full = (d->bottom - d->top == POOL_DEQUE);
+    if (!full)
+        d->tasks[d->bottom++ % POOL_DEQUE] = t;
+    pthread_mutex_unlock(&d->lock);
+    if (full)
+    {
+        runTask(t);
+        return;
+    }
+    __atomic_add_fetch(&p->queued, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&p->lock);
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * @brief Runs tasks until all tasks spawned on a counter are done.
+ * @param p the pool.
+ * @param pending counter passed to poolSpawn().
+ */
+void poolWait(struct pool *p, int *pending)
+{
+    while (__atomic_load_n(pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        struct task *t = popBottom(p);
+        if (t == NULL)
+            t = steal(p);
+        if (t != NULL)
+            runTask(t);
+        else
+            sched_yield();
+    }
+}
+
+/**
+ * @brief Stops and joins the threads of a pool.
+ * @param p the pool, no tasks may be left.
+ */
+void poolStop(struct pool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 1; i <= p->created; i++)
+        pthread_join(p->ids[i], NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    for (int i = 0; i < POOL_MAX_THREADS; i++)
+        pthread_mutex_destroy(&p->deques[i].lock);
+}
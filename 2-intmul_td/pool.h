@@ -0,0 +1,63 @@
+/**
+ * @file pool.h
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Work-stealing thread pool for fork-join recursion.
+ *
+ * Every thread of the pool, the one that started it included, owns a deque of tasks. A spawned task
+ * is pushed onto the bottom of the deque of the spawning thread, which later takes it back from the
+ * bottom unless an idle thread stole it from the top first. A thread waiting for its tasks keeps
+ * running tasks instead of blocking, so recursion never ties up a thread. Tasks live in the stack
+ * frame of their spawner, which waits for them before returning, so spawning never allocates.
+ **/
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+#define POOL_MAX_THREADS 256                    /*!< most threads a pool can have */
+#define POOL_DEQUE 1024                         /*!< tasks per deque, a spawn into a full deque runs at once */
+
+struct task;
+typedef void (*taskFunc)(struct task *t);       /*!< runs a task */
+
+/**
+ * @brief A unit of work, usually the first member of a struct holding its arguments.
+ */
+struct task {
+    taskFunc run;                               /*!< the work */
+    int *pending;                               /*!< counter of the spawner, decremented when done */
+};
+
+/**
+ * @brief Tasks of one thread, the owner works at the bottom, thieves take from the top.
+ */
+struct deque {
+    pthread_mutex_t lock;                       /*!< guards top, bottom and tasks */
+    struct task *tasks[POOL_DEQUE];             /*!< ring of queued tasks */
+    unsigned top;                               /*!< oldest task */
+    unsigned bottom;                            /*!< one after the newest task */
+};
+
+/**
+ * @brief The threads and their deques.
+ */
+struct pool {
+    int threads;                                /*!< threads including the starting one */
+    int created;                                /*!< threads created so far, they are ids[1] to ids[created] */
+    int started;                                /*!< threads that took their index */
+    pthread_t ids[POOL_MAX_THREADS];            /*!< the created threads, index 0 is unused */
+    struct deque deques[POOL_MAX_THREADS];      /*!< one deque per thread */
+    pthread_mutex_t lock;                       /*!< guards sleeping threads, started and stop */
+    pthread_cond_t wake;                        /*!< signaled when a task was queued or the pool stops */
+    int queued;                                 /*!< tasks in all deques, accessed atomically */
+    int stop;                                   /*!< threads shall exit */
+};
+
+int poolStart(struct pool *p, int threads);
+void poolSpawn(struct pool *p, struct task *t, int *pending);
+void poolWait(struct pool *p, int *pending);
+void poolStop(struct pool *p);
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file tune.c
+ * @author Harrys Kavan <e1529309@student.tuwien.ac.at>
+ * @date 19.10.2026
+ *
+ * @brief Times mulEqual() for the thresholds it was built with.
+ *
+ * Used by "make bench-tiers" and "make bench-threads": for every length given as argument two random
+ * numbers are multiplied repeatedly for at least TUNE_NS nanoseconds and the time of one product is
+ * printed. Only the multiplication is timed, not starting the program, the threads or reading operands.
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "bignum.h"
+#include "pool.h"
+
+#define TUNE_NS 200000000LL                     /*!< minimum time spent per length */
+
+/**
+ * @brief Reads the monotonic clock.
+ * @return nanoseconds.
+ */
+static long long now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Program entry point.
+ * @brief Prints the time of one product for every length in limbs given as argument.
+ * @details With -t the products run on a pool of that many threads.
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return Returns EXIT_SUCCESS, EXIT_FAILURE on memory error or invalid arguments.
+ */
+int main(int argc, char **argv)
+{
+    static struct pool pool;
+    int threads = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1)
+    {
+        if (opt != 't' || (threads = atoi(optarg)) < 1 || threads > POOL_MAX_THREADS)
+        {
+            fprintf(stderr, "Usage: %s [-t threads] limbs...\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind == argc)
+    {
+        fprintf(stderr, "Usage: %s [-t threads] limbs...\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (threads > 1 && poolStart(&pool, threads) < 0)
+    {
+        fprintf(stderr, "%s, ERROR: could not start %d threads\n", argv[0], threads);
+        exit(EXIT_FAILURE);
+    }
+    struct pool *p = (threads > 1) ? &pool : NULL;
+
+    for (int i = optind; i < argc; i++)
+    {
+        size_t n = strtoul(argv[i], NULL, 10);
+        limb_t *a = malloc(n * sizeof(limb_t));
+        limb_t *b = malloc(n * sizeof(limb_t));
+        limb_t *r = malloc(2 * n * sizeof(limb_t));
+        limb_t *scratch = malloc((mulScratch(n, p != NULL) + 1) * sizeof(limb_t));
+        if (n == 0 || a == NULL || b == NULL || r == NULL || scratch == NULL)
+        {
+            fprintf(stderr, "%s, ERROR: invalid length or out of memory: %s\n", argv[0], argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        for (size_t j = 0; j < n; j++)
+        {
+            a[j] = ((limb_t)rand() << 40) ^ ((limb_t)rand() << 20) ^ rand();
+            b[j] = ((limb_t)rand() << 40) ^ ((limb_t)rand() << 20) ^ rand();
+        }
+
+        long long start = now(), elapsed;
+        long runs = 0;
+        do
+        {
+            mulEqual(a, b, n, r, scratch, p);
+            runs++;
+            elapsed = now() - start;
+        } while (elapsed < TUNE_NS);
+        printf("limbs %zu: %lld ns\n", n, elapsed / runs);
+
+        free(a);
+        free(b);
+        free(r);
+        free(scratch);
+    }
+    if (p != NULL)
+        poolStop(p);
+    exit(EXIT_SUCCESS);
+}